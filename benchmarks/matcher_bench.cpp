@@ -0,0 +1,131 @@
+/**
+ * Brute-force matcher benchmark
+ *
+ * Times 2-NN matching (the ratio-test shape) of random SIFT-like (128
+ * float) and ORB-like (32 byte) descriptor sets with cv::BFMatcher and
+ * with BruteForceMatcher at each SIMD level, and checks that both find
+ * the same nearest neighbours.
+ *
+ * Usage: matcher_bench [--threads=N] [--repeat=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+
+#include "Options.hpp"
+#include "BruteForceMatcher.hpp"
+
+namespace {
+
+struct Shape {
+	int queries;
+	int train;
+};
+
+cv::Mat random_descriptors(int rows, bool binary, cv::RNG& rng) {
+	cv::Mat descriptors(rows, binary ? 32 : 128, binary ? CV_8U : CV_32F);
+	if (binary) {
+		rng.fill(descriptors, cv::RNG::UNIFORM, 0, 256);
+	} else {
+		rng.fill(descriptors, cv::RNG::UNIFORM, 0.0f, 255.0f);
+	}
+	return descriptors;
+}
+
+// Best time of `repeat` runs, in milliseconds
+template <typename Run>
+double best_ms(int repeat, Run run) {
+	double best = 1e300;
+	for (int i = 0; i < repeat; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+	}
+	return best;
+}
+
+// Query rows whose nearest train row differs (ties at equal distance allowed)
+size_t disagreements(const std::vector<std::vector<cv::DMatch>>& a,
+					 const std::vector<std::vector<cv::DMatch>>& b) {
+	size_t differ = 0;
+	for (size_t q = 0; q < a.size(); ++q) {
+		if (a[q].empty() || b[q].empty()) {
+			differ += a[q].size() != b[q].size();
+			continue;
+		}
+		if (a[q][0].trainIdx != b[q][0].trainIdx
+			&& std::abs(a[q][0].distance - b[q][0].distance) > 1e-3f * std::max(1.0f, a[q][0].distance)) {
+			++differ;
+		}
+	}
+	return differ;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	Options options(argc, argv);
+	size_t threads = static_cast<size_t>(options.get_int("threads", 0));
+	int repeat = static_cast<int>(options.get_int("repeat", 5));
+
+	const Shape shapes[] = {{500, 500}, {1000, 1000}, {2000, 2000}, {1000, 10000}};
+	cv::RNG rng(12345);
+
+	std::cout << std::left << std::setw(10) << "norm"
+			  << std::setw(14) << "queries"
+			  << std::setw(10) << "train"
+			  << std::setw(18) << "matcher"
+			  << std::setw(12) << "ms"
+			  << "mismatches" << std::endl;
+
+	for (bool binary : {false, true}) {
+		for (const Shape& shape : shapes) {
+			cv::Mat queries = random_descriptors(shape.queries, binary, rng);
+			cv::Mat train = random_descriptors(shape.train, binary, rng);
+			const char* norm_name = binary ? "hamming" : "l2";
+
+			cv::BFMatcher reference(binary ? cv::NORM_HAMMING : cv::NORM_L2);
+			std::vector<std::vector<cv::DMatch>> expected;
+			double reference_ms = best_ms(repeat, [&] {
+				reference.knnMatch(queries, train, expected, 2);
+			});
+			std::cout << std::left << std::setw(10) << norm_name
+					  << std::setw(14) << shape.queries
+					  << std::setw(10) << shape.train
+					  << std::setw(18) << "cv::BFMatcher"
+					  << std::setw(12) << std::fixed << std::setprecision(2) << reference_ms
+					  << "-" << std::endl;
+
+			for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512}) {
+				BruteForceMatcher::Params params;
+				params.norm = binary ? BruteForceMatcher::Norm::Hamming : BruteForceMatcher::Norm::L2;
+				params.threads = threads;
+				params.simd = level;
+				BruteForceMatcher matcher(params);
+				if (matcher.simd_level() != level) {
+					continue; // not supported by this CPU
+				}
+
+				std::vector<std::vector<cv::DMatch>> matches;
+				double ms = best_ms(repeat, [&] {
+					matcher.knn_match(queries, train, 2, matches);
+				});
+				std::cout << std::left << std::setw(10) << norm_name
+						  << std::setw(14) << shape.queries
+						  << std::setw(10) << shape.train
+						  << std::setw(18) << (std::string("bf/") + simd_level_name(level))
+						  << std::setw(12) << std::fixed << std::setprecision(2) << ms
+						  << disagreements(expected, matches) << std::endl;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * Incremental JPEG decode check and benchmark
+ *
+ * Feeds JPEGs to StreamingJpegDecoder in growing prefixes of several step
+ * sizes (from a few bytes to the whole file at once, as chunks would
+ * arrive) and checks that every pyramid level is identical to what the
+ * extractor computes on a whole-file decode: cv::imdecode, cvtColor to
+ * gray, then cv::pyrDown level by level. Then times both.
+ *
+ * Without --image it checks synthetic baseline and progressive, color and
+ * gray JPEGs with odd sizes, so the band borders land everywhere.
+ *
+ * Exits with 1 on any difference (or when built without libjpeg).
+ *
+ * Usage: streaming_decode_bench [--image=PATH[,PATH...]] [--levels=N] [--repeat=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "opencv2/opencv.hpp"
+
+#include "Options.hpp"
+#include "StreamingDecode.hpp"
+
+namespace {
+
+struct Sample {
+	std::string name;
+	std::vector<uchar> jpeg;
+};
+
+// Smooth gradients plus blurred noise: detail at every scale, like a photo
+Sample synthetic(int width, int height, bool color, bool progressive) {
+	cv::Mat image(height, width, CV_8UC3);
+	for (int y = 0; y < height; ++y) {
+		cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+		for (int x = 0; x < width; ++x) {
+			row[x] = cv::Vec3b(static_cast<uchar>(x * 255 / width),
+							   static_cast<uchar>(y * 255 / height),
+							   static_cast<uchar>((x + y) % 256));
+		}
+	}
+	cv::Mat noise(height, width, CV_8UC3);
+	cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(64));
+	cv::GaussianBlur(noise, noise, cv::Size(3, 3), 0);
+	image += noise;
+	if (!color) {
+		cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
+	}
+
+	Sample sample;
+	sample.name = std::to_string(width) + "x" + std::to_string(height)
+				+ (color ? " color" : " gray") + (progressive ? " progressive" : "");
+	cv::imencode(".jpg", image, sample.jpeg,
+				 {cv::IMWRITE_JPEG_QUALITY, 90, cv::IMWRITE_JPEG_PROGRESSIVE, progressive ? 1 : 0});
+	return sample;
+}
+
+// What FrameProcessor builds from a whole received image
+std::vector<cv::Mat> reference_pyramid(const std::vector<uchar>& jpeg, int max_level) {
+	std::vector<cv::Mat> pyramid(static_cast<size_t>(max_level) + 1);
+	cv::Mat image = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+	cv::cvtColor(image, pyramid[0], cv::COLOR_BGR2GRAY);
+	for (int level = 1; level <= max_level; ++level) {
+		cv::pyrDown(pyramid[level - 1], pyramid[level]);
+	}
+	return pyramid;
+}
+
+// Feeds the file in prefixes growing by `step` bytes (0: all at once)
+bool streaming_pyramid(const std::vector<uchar>& jpeg, int max_level, size_t step,
+					   std::vector<cv::Mat>& pyramid) {
+	StreamingJpegDecoder decoder(max_level);
+	const char* data = reinterpret_cast<const char*>(jpeg.data());
+	if (step > 0) {
+		for (size_t size = std::min(step, jpeg.size()); size < jpeg.size(); size += step) {
+			if (!decoder.feed(data, size, false)) {
+				return false;
+			}
+		}
+	}
+	if (!decoder.feed(data, jpeg.size(), true) || !decoder.done()) {
+		return false;
+	}
+	pyramid = decoder.take_pyramid();
+	return true;
+}
+
+// Levels that differ from the reference, as "level N (max diff D)"
+std::string differences(const std::vector<cv::Mat>& expected, const std::vector<cv::Mat>& actual) {
+	if (actual.size() != expected.size()) {
+		return std::to_string(actual.size()) + " levels instead of " + std::to_string(expected.size());
+	}
+	std::string report;
+	for (size_t level = 0; level < expected.size(); ++level) {
+		const cv::Mat& a = expected[level];
+		const cv::Mat& b = actual[level];
+		if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) {
+			report += " level " + std::to_string(level) + " (size)";
+		} else if (cv::norm(a, b, cv::NORM_INF) != 0) {
+			report += " level " + std::to_string(level) + " (max diff "
+					+ std::to_string(static_cast<int>(cv::norm(a, b, cv::NORM_INF))) + ")";
+		}
+	}
+	return report;
+}
+
+// Best time of `repeat` runs, in milliseconds
+template <typename Run>
+double best_ms(int repeat, Run run) {
+	double best = 1e300;
+	for (int i = 0; i < repeat; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+	}
+	return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	if (!StreamingJpegDecoder::available()) {
+		std::cerr << "Built without libjpeg (EXTRACTOR_LIBJPEG); nothing to check." << std::endl;
+		return 1;
+	}
+
+	Options options(argc, argv);
+	int max_level = static_cast<int>(options.get_int("levels", 4));
+	int repeat = static_cast<int>(options.get_int("repeat", 5));
+
+	std::vector<Sample> samples;
+	for (const std::string& path : options.get_list("image", {})) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			std::cerr << "Cannot read " << path << std::endl;
+			return 1;
+		}
+		samples.push_back({path, std::vector<uchar>(std::istreambuf_iterator<char>(file),
+													std::istreambuf_iterator<char>())});
+	}
+	if (samples.empty()) {
+		for (bool progressive : {false, true}) {
+			for (bool color : {true, false}) {
+				samples.push_back(synthetic(1001, 757, color, progressive));
+				samples.push_back(synthetic(640, 480, color, progressive));
+				samples.push_back(synthetic(97, 35, color, progressive));
+			}
+		}
+	}
+
+	const size_t steps[] = {1, 7, 997, 4096, 65536, 0};
+	int failures = 0;
+
+	std::cout << std::left << std::setw(30) << "image"
+			  << std::setw(12) << "whole ms"
+			  << std::setw(14) << "streaming ms"
+			  << "result" << std::endl;
+
+	for (const Sample& sample : samples) {
+		std::vector<cv::Mat> expected = reference_pyramid(sample.jpeg, max_level);
+
+		std::string result = "identical";
+		for (size_t step : steps) {
+			if (step == 1 && sample.jpeg.size() > (1 << 18)) {
+				continue; // a feed per byte takes minutes on big files
+			}
+			std::vector<cv::Mat> actual;
+			std::string diff;
+			if (!streaming_pyramid(sample.jpeg, max_level, step, actual)) {
+				diff = " decode failed";
+			} else {
+				diff = differences(expected, actual);
+			}
+			if (!diff.empty()) {
+				result = "step " + std::to_string(step) + ":" + diff;
+				++failures;
+				break;
+			}
+		}
+
+		std::vector<cv::Mat> pyramid;
+		double whole_ms = best_ms(repeat, [&] { pyramid = reference_pyramid(sample.jpeg, max_level); });
+		double streaming_ms = best_ms(repeat, [&] { streaming_pyramid(sample.jpeg, max_level, 65536, pyramid); });
+		std::cout << std::left << std::setw(30) << sample.name
+				  << std::setw(12) << std::fixed << std::setprecision(2) << whole_ms
+				  << std::setw(14) << streaming_ms
+				  << result << std::endl;
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " image(s) differ from cv::pyrDown on the whole frame." << std::endl;
+		return 1;
+	}
+	return 0;
+}
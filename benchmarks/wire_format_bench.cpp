@@ -0,0 +1,141 @@
+/**
+ * Wire format benchmark
+ *
+ * Compares the original 2-part (generator) and 3-part (extractor) multipart
+ * messages against the single contiguous frame format (Frame.hpp) over an
+ * inproc PAIR socket, so the numbers reflect ZMQ per-part overhead and the
+ * receiver's parsing, not the network.
+ *
+ * Usage: wire_format_bench [--messages=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "zmq.hpp"
+
+#include "Options.hpp"
+#include "Frame.hpp"
+
+namespace {
+
+const char* ENDPOINT = "inproc://wire_format_bench";
+
+// Sends `count` copies of `parts`, either as multipart or as one frame
+void send_all(zmq::socket_t& socket, const RecordView& parts, size_t count, WireFormat wire) {
+	for (size_t i = 0; i < count; ++i) {
+		if (wire == WireFormat::Frame) {
+			zmq::message_t frame_msg(framed_size(parts));
+			encode_frame_into(parts, frame_msg.data());
+			socket.send(frame_msg, zmq::send_flags::none);
+			continue;
+		}
+
+		for (size_t p = 0; p < parts.size(); ++p) {
+			zmq::message_t part_msg(parts[p].data, parts[p].size);
+			socket.send(part_msg, p + 1 < parts.size() ? zmq::send_flags::sndmore
+													   : zmq::send_flags::none);
+		}
+	}
+}
+
+// Receives `count` messages the way the apps do; returns total payload bytes seen
+size_t recv_all(zmq::socket_t& socket, size_t part_count, size_t count, WireFormat wire) {
+	size_t seen = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (wire == WireFormat::Frame) {
+			zmq::message_t frame_msg;
+			(void)socket.recv(frame_msg);
+			RecordView parts = decode_frame(frame_msg.data(), frame_msg.size());
+			for (const auto& part : parts) {
+				seen += part.size;
+			}
+			continue;
+		}
+
+		for (size_t p = 0; p < part_count; ++p) {
+			zmq::message_t part_msg;
+			(void)socket.recv(part_msg);
+			seen += part_msg.size();
+			bool more = socket.get(zmq::sockopt::rcvmore);
+			if (more != (p + 1 < part_count)) {
+				throw std::runtime_error("Unexpected part count.");
+			}
+		}
+	}
+	return seen;
+}
+
+double run(zmq::context_t& context, const RecordView& parts, size_t count, WireFormat wire) {
+	zmq::socket_t receiver(context, zmq::socket_type::pair);
+	receiver.bind(ENDPOINT);
+
+	zmq::socket_t sender(context, zmq::socket_type::pair);
+	sender.connect(ENDPOINT);
+
+	auto start = std::chrono::steady_clock::now();
+	std::thread producer([&] { send_all(sender, parts, count, wire); });
+	recv_all(receiver, parts.size(), count, wire);
+	producer.join();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	sender.close();
+	receiver.close();
+	return std::chrono::duration<double>(elapsed).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	Options options(argc, argv);
+	size_t count = static_cast<size_t>(options.get_int("messages", 200000));
+
+	zmq::context_t context(1);
+
+	const std::string filename = "frame_000123.jpg";
+	const size_t image_sizes[] = {256, 4 * 1024, 64 * 1024, 1024 * 1024};
+
+	std::cout << std::left << std::setw(12) << "image bytes"
+			  << std::setw(10) << "parts"
+			  << std::setw(12) << "format"
+			  << std::setw(14) << "msgs/s"
+			  << "MB/s" << std::endl;
+
+	for (size_t image_size : image_sizes) {
+		std::vector<char> image(image_size, 'x');
+		std::vector<char> keypoints(image_size / 8, 'k');
+		// Keep large runs short
+		size_t n = std::max<size_t>(1000, count * 1024 / std::max<size_t>(1024, image_size));
+
+		RecordView two_parts = {
+			PartView{filename.data(), filename.size()},
+			PartView{image.data(), image.size()}
+		};
+		RecordView three_parts = two_parts;
+		three_parts.push_back(PartView{keypoints.data(), keypoints.size()});
+
+		for (const RecordView* parts : {&two_parts, &three_parts}) {
+			for (WireFormat wire : {WireFormat::Multipart, WireFormat::Frame}) {
+				double seconds = run(context, *parts, n, wire);
+				size_t bytes = 0;
+				for (const auto& part : *parts) {
+					bytes += part.size;
+				}
+
+				std::cout << std::left << std::setw(12) << image_size
+						  << std::setw(10) << parts->size()
+						  << std::setw(12) << (wire == WireFormat::Frame ? "frame" : "multipart")
+						  << std::setw(14) << std::fixed << std::setprecision(0) << (n / seconds)
+						  << std::setprecision(1) << (n * bytes / seconds / 1e6)
+						  << std::endl;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef ALLOC_PROFILE_HPP
+#define ALLOC_PROFILE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Metrics.hpp"
+
+/**
+ * Opt-in allocation profiling: the common library replaces the global
+ * operator new / delete (every variant) with ones that, while profiling
+ * is on, count each thread's allocations, bytes and frees and bucket the
+ * sizes. Counting goes to plain thread_local counters, so allocating
+ * threads never contend; while off, each call costs one relaxed load.
+ *
+ * Stages read their thread's totals before and after and hand the
+ * difference to a Stage, which adds it to the process-wide metrics:
+ *
+ *   static alloc_profile::Stage decode("extractor.alloc.decode");
+ *   alloc_profile::Stats before = alloc_profile::thread_stats();
+ *   ...
+ *   decode.add(alloc_profile::thread_stats() - before);
+ *
+ * Only operator new is seen: buffers from malloc directly, such as
+ * cv::Mat data (cv::fastMalloc) or ZMQ messages, are not counted.
+ */
+namespace alloc_profile {
+
+// Size buckets: <= 16 bytes, <= 32, ... doubling up to <= 16 MiB, then larger
+const int SIZE_BUCKETS = 22;
+
+/**
+ * @brief Allocation totals, of one thread or of a stretch of its work.
+ */
+struct Stats {
+	uint64_t allocations = 0;
+	uint64_t bytes = 0; // requested
+	uint64_t frees = 0;
+	uint64_t sizes[SIZE_BUCKETS] = {};
+
+	Stats operator-(const Stats& earlier) const;
+};
+
+// Starts or stops counting, in every thread
+void set_enabled(bool enabled);
+bool enabled();
+
+// Flips set_enabled(); async-signal-safe, e.g. for a SIGUSR1 handler
+void toggle();
+
+// What the calling thread allocated while profiling was on
+Stats thread_stats();
+
+// Upper bound of size bucket `i` in bytes, 0 for the last (unbounded) one
+size_t bucket_limit(int i);
+
+/**
+ * @brief Size histogram of everything added to any Stage so far, e.g.
+ * "<=16:1200 <=32:310 ... >16M:2" (empty buckets left out).
+ */
+std::string size_histogram();
+
+/**
+ * @brief Allocation counters of one pipeline stage on the metrics line:
+ * `<prefix>.allocations`, `<prefix>.bytes` and `<prefix>.frees`.
+ */
+class Stage {
+public:
+	explicit Stage(const std::string& prefix);
+
+	void add(const Stats& stats);
+
+private:
+	Counter& allocations_;
+	Counter& bytes_;
+	Counter& frees_;
+};
+
+} // namespace alloc_profile
+
+#endif // ALLOC_PROFILE_HPP
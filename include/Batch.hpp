@@ -0,0 +1,74 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Non-owning view of one message part.
+ */
+struct PartView {
+	const char* data;
+	size_t size;
+};
+
+/**
+ * @brief One logical multipart record (e.g. filename, image, keypoints).
+ */
+using RecordView = std::vector<PartView>;
+
+/**
+ * @brief Packs several multipart records into a single contiguous buffer so
+ * they can be published with one ZMQ send.
+ *
+ * Wire layout (native byte order, like the keypoint serialization):
+ * - magic (uint32, BATCH_MAGIC)
+ * - record_count (uint32)
+ * - for each record:
+ *   - part_count (uint32)
+ *   - part_count x part_size (uint32)
+ *   - the part payloads, back to back
+ */
+class BatchWriter {
+public:
+	BatchWriter();
+
+	/**
+	 * @brief Appends one record; its parts are copied into the batch buffer.
+	 * @throws std::length_error if a part does not fit in 32 bits.
+	 */
+	void add(const RecordView& parts);
+
+	size_t record_count() const { return record_count_; }
+	size_t byte_size() const { return buffer_.size(); }
+	bool empty() const { return record_count_ == 0; }
+
+	/**
+	 * @brief Returns the finished batch and resets the writer.
+	 */
+	std::vector<char> finish();
+
+private:
+	std::vector<char> buffer_;
+	uint32_t record_count_;
+};
+
+// "DISB" read as a little-endian uint32
+constexpr uint32_t BATCH_MAGIC = 0x42534944;
+
+/**
+ * @brief Cheap check for the batch magic at the start of a buffer.
+ */
+bool is_batch(const void* data, size_t size);
+
+/**
+ * @brief Splits a batch into its records without copying any payload.
+ *
+ * The returned views point into `data`, which must outlive them.
+ *
+ * @throws std::runtime_error if the buffer is truncated or malformed.
+ */
+std::vector<RecordView> unpack_batch(const void* data, size_t size);
+
+#endif // BATCH_HPP
@@ -0,0 +1,60 @@
+#ifndef BRUTE_FORCE_MATCHER_HPP
+#define BRUTE_FORCE_MATCHER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "DescriptorDistance.hpp"
+
+/**
+ * @brief Exact brute-force kNN matcher for descriptor sets, a drop-in for
+ * cv::BFMatcher::knnMatch tuned for frame-sized batches.
+ *
+ * - L2 on CV_32F rows (e.g. SIFT) or Hamming on CV_8U rows (e.g. ORB),
+ *   using the SIMD kernels from DescriptorDistance.hpp.
+ * - Blocked: a block of query rows is compared against a block of train
+ *   rows at a time, so both stay in cache while every pair is visited.
+ * - Query blocks are spread over `threads` threads.
+ *
+ * Distances are reported like cv::BFMatcher: plain (not squared) L2, or
+ * the number of differing bits.
+ */
+class BruteForceMatcher {
+public:
+	enum class Norm { L2, Hamming };
+
+	struct Params {
+		Norm norm = Norm::L2;
+		size_t threads = 0;          // 0 = std::thread::hardware_concurrency()
+		int query_block = 32;        // query rows per block (kept in L1)
+		int train_block = 512;       // train rows per block (kept in L2)
+		SimdLevel simd = detect_simd_level();
+	};
+
+	explicit BruteForceMatcher(const Params& params);
+
+	/**
+	 * @brief The k nearest train rows of every query row, closest first
+	 * (fewer when train has fewer than k rows).
+	 * @throws std::invalid_argument if the types or lengths do not fit the norm.
+	 */
+	void knn_match(const cv::Mat& queries, const cv::Mat& train, int k,
+				   std::vector<std::vector<cv::DMatch>>& matches) const;
+
+	/**
+	 * @brief Nearest train row of every query row that passes Lowe's ratio
+	 * test (best < ratio * second best), in query order.
+	 */
+	std::vector<cv::DMatch> ratio_match(const cv::Mat& queries, const cv::Mat& train,
+										float ratio) const;
+
+	SimdLevel simd_level() const { return kernels_.level; }
+
+private:
+	Params params_;
+	DistanceKernels kernels_;
+};
+
+#endif // BRUTE_FORCE_MATCHER_HPP
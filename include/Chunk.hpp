@@ -0,0 +1,137 @@
+#ifndef CHUNK_HPP
+#define CHUNK_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "zmq.hpp"
+#include "Batch.hpp" // PartView
+
+/**
+ * @brief One piece of an image too large to send as a single message
+ * (generator --chunk-bytes), as its own single-part ZMQ message.
+ *
+ * The generator sends a few chunks per event loop turn, round-robin over
+ * the images being chunked, so frames due meanwhile go out between the
+ * chunks of a large image instead of waiting behind one giant message,
+ * and no stage needs the whole image in one ZMQ frame.
+ *
+ * Wire layout (native byte order):
+ * - magic (uint32, CHUNK_MAGIC)
+ * - version (uint16, CHUNK_VERSION)
+ * - filename_size (uint16)
+ * - transfer_id (uint64), unique per image on the publishing socket
+ *   (the generator starts from a random value, so IDs of a restarted
+ *   generator do not collide with transfers still in assembly)
+ * - total_size (uint64), size of the whole image
+ * - offset (uint64), where this chunk's payload goes in the image
+ * - filename bytes, then the payload
+ */
+
+// "DISC" read as a little-endian uint32
+constexpr uint32_t CHUNK_MAGIC = 0x43534944;
+constexpr uint16_t CHUNK_VERSION = 1;
+
+struct ChunkView {
+	uint64_t transfer_id = 0;
+	uint64_t total_size = 0;
+	uint64_t offset = 0;
+	PartView filename;
+	PartView payload;
+};
+
+/**
+ * @brief Number of bytes encode_chunk_into() will write.
+ */
+size_t chunked_size(const std::string& filename, size_t payload_size);
+
+/**
+ * @brief Encodes one chunk into `out`, which must hold
+ * chunked_size(filename, payload_size) bytes.
+ * @throws std::length_error if the filename is longer than 65535 bytes.
+ */
+void encode_chunk_into(uint64_t transfer_id, uint64_t total_size, uint64_t offset,
+					   const std::string& filename, const char* payload, size_t payload_size,
+					   void* out);
+
+/**
+ * @brief Cheap check for the chunk magic at the start of a buffer.
+ */
+bool is_chunk(const void* data, size_t size);
+
+/**
+ * @brief Views of a chunk's fields; they point into `data`.
+ * @throws std::runtime_error if the chunk is truncated or inconsistent.
+ */
+ChunkView decode_chunk(const void* data, size_t size);
+
+/**
+ * @brief Reassembles chunked images from one publisher.
+ *
+ * Each image is copied into one buffer of its final size as its chunks
+ * arrive, in any order. PUB sockets drop messages under load, so images
+ * still incomplete after `timeout`, or beyond `max_transfers` in flight,
+ * are given up (oldest first).
+ *
+ * Not thread-safe; use one per receiving socket.
+ */
+class ChunkAssembler {
+	using Clock = std::chrono::steady_clock;
+
+public:
+	ChunkAssembler(size_t max_transfers, uint64_t max_image_bytes,
+				   std::chrono::milliseconds timeout);
+
+	/**
+	 * @brief Adds a chunk. When it completes an image, moves the image into
+	 * `filename` and `image` and returns true.
+	 * @throws std::runtime_error if the chunk contradicts or overlaps earlier
+	 * chunks of its transfer, or exceeds the size limit (the transfer is
+	 * dropped).
+	 */
+	bool add(const ChunkView& chunk, std::string& filename, zmq::message_t& image);
+
+	/**
+	 * @brief The image bytes of an incomplete transfer received so far
+	 * without gaps, i.e. `contiguous` bytes at `data`, for decoding while
+	 * the rest arrives.
+	 * @return false if no such transfer is in flight.
+	 */
+	bool prefix(uint64_t transfer_id, const char*& data, uint64_t& contiguous) const;
+
+	// Gives up the transfers that have timed out
+	void expire() { expire(Clock::now()); }
+
+	bool has(uint64_t transfer_id) const { return transfers_.count(transfer_id) != 0; }
+
+	size_t in_flight() const { return transfers_.size(); }
+
+	// Transfers given up so far
+	uint64_t dropped() const { return dropped_; }
+
+private:
+	struct Transfer {
+		std::string filename;
+		zmq::message_t buffer;
+		uint64_t contiguous = 0;             // bytes received from offset 0 on
+		std::map<uint64_t, uint64_t> ahead;  // offset -> size of chunks past a gap
+		Clock::time_point started;
+	};
+
+	void expire(Clock::time_point now);
+
+	// The chunk at `offset` covers bytes the transfer already has
+	static bool overlaps(const Transfer& transfer, uint64_t offset, uint64_t size);
+
+	size_t max_transfers_;
+	uint64_t max_image_bytes_;
+	std::chrono::milliseconds timeout_;
+	std::unordered_map<uint64_t, Transfer> transfers_;
+	uint64_t dropped_ = 0;
+};
+
+#endif // CHUNK_HPP
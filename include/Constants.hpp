@@ -2,8 +2,10 @@
 #define CONSTANTS_HPP
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
-// This file defines the IPC endpoints for the system.
+// This file defines the IPC endpoints and tuning defaults for the system.
 
 namespace constants {
 
@@ -19,6 +21,61 @@ const std::string EXTRACTOR_ENDPOINT = "tcp://*:5556";
 // App 3 (Logger) connects to App 2 on this endpoint
 const std::string EXTRACTOR_CONNECT_TO = "tcp://localhost:5556";
 
+// App 4 (Matcher) answers retrieval queries (REQ/REP) on this endpoint
+const std::string MATCHER_ENDPOINT = "tcp://*:5557";
+
+// Clients connect to App 4 on this endpoint
+const std::string MATCHER_CONNECT_TO = "tcp://localhost:5557";
+
+// Flat descriptor store the logger writes next to processed_data.db
+// (see DescriptorStore.hpp)
+const std::string DESCRIPTOR_STORE_PATH = "processed_data.desc";
+
+// Store of product-quantized descriptor codes (data_logger --pq-codebook)
+const std::string PQ_STORE_PATH = "processed_data.pq";
+
+// Logger --dedup: frames whose perceptual hashes differ in at most this
+// many of 64 bits count as near-duplicates
+const int DEDUP_MAX_DISTANCE = 6;
+
+// Deepest extractor pyramid level (--levels), i.e. 1/256 scale
+const int MAX_PYRAMID_LEVEL = 8;
+
+// Extractor quality gate (--quality) defaults, measured on a copy of the
+// gray frame downsampled to at most QUALITY_SAMPLE_WIDTH pixels wide
+const int QUALITY_SAMPLE_WIDTH = 320;
+const double QUALITY_MIN_SHARPNESS = 100.0;  // variance of the Laplacian
+const double QUALITY_MIN_BRIGHTNESS = 30.0;  // mean gray level
+const double QUALITY_MAX_BRIGHTNESS = 225.0;
+const double QUALITY_MAX_CLIPPED = 0.5;      // share of nearly black or white pixels
+
+// Extractor -> Logger batching defaults (overridable on the command line).
+// Batching only kicks in when the result queue has a backlog.
+const size_t BATCH_MAX_RECORDS = 64;
+const size_t BATCH_MAX_BYTES = 1 << 20; // 1 MiB
+const long BATCH_FLUSH_US = 500;
+
+// Chunked transfer of large images (generator --chunk-bytes, see Chunk.hpp):
+// the extractor keeps at most CHUNK_MAX_TRANSFERS images per receiver in
+// assembly, refuses images over CHUNK_MAX_IMAGE_BYTES and gives up on
+// images still incomplete after CHUNK_TIMEOUT_MS
+const size_t CHUNK_MAX_TRANSFERS = 16;
+const uint64_t CHUNK_MAX_IMAGE_BYTES = 1ull << 30; // 1 GiB
+const long CHUNK_TIMEOUT_MS = 5000;
+// Chunk messages the generator sends per event loop turn before letting
+// other frames (and other chunked images) go out
+const size_t CHUNKS_PER_TURN = 4;
+
+// Extractor huge-page buffers (--huge-pages, see HugePages.hpp): image
+// buffers of at least HUGE_PAGE_MIN_BYTES are mapped in whole huge pages,
+// and up to HUGE_PAGE_POOL_BYTES of freed ones are kept for reuse
+const size_t HUGE_PAGE_SIZE = 2 << 20; // 2 MiB, the x86-64 / arm64 default
+const size_t HUGE_PAGE_MIN_BYTES = 1 << 20;
+const size_t HUGE_PAGE_POOL_BYTES = 256 << 20;
+
+// Period of the "[Metrics]" line each app prints (0 disables it)
+const long METRICS_INTERVAL_MS = 5000;
+
 } // namespace constants
 
 #endif // CONSTANTS_HPP
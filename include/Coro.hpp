@@ -0,0 +1,176 @@
+#ifndef CORO_HPP
+#define CORO_HPP
+
+// C++20 coroutine building blocks: a fixed thread pool that resumes
+// coroutines, a fire-and-forget task type and an awaitable queue.
+// Header-only; only translation units built as C++20 include it.
+
+#include <coroutine>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed pool of threads resuming coroutine handles in FIFO order.
+ */
+class Executor {
+public:
+	explicit Executor(size_t num_threads) {
+		threads_.reserve(num_threads);
+		for (size_t i = 0; i < num_threads; ++i) {
+			threads_.emplace_back([this] { run(); });
+		}
+	}
+
+	// Coroutines still suspended elsewhere (e.g. in an AsyncQueue) are
+	// simply abandoned
+	~Executor() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		cond_.notify_all();
+		for (auto& t : threads_) {
+			t.join();
+		}
+	}
+
+	Executor(const Executor&) = delete;
+	Executor& operator=(const Executor&) = delete;
+
+	void post(std::coroutine_handle<> handle) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ready_.push_back(handle);
+		}
+		cond_.notify_one();
+	}
+
+	/**
+	 * @brief `co_await executor.schedule()` continues on a pool thread.
+	 */
+	auto schedule() {
+		struct Awaiter {
+			Executor& executor;
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+			void await_resume() const noexcept {}
+		};
+		return Awaiter{*this};
+	}
+
+private:
+	void run() {
+		while (true) {
+			std::coroutine_handle<> handle;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cond_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+				if (stopping_) {
+					return;
+				}
+				handle = ready_.front();
+				ready_.pop_front();
+			}
+			handle.resume();
+		}
+	}
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<std::coroutine_handle<>> ready_;
+	std::vector<std::thread> threads_;
+	bool stopping_ = false;
+};
+
+/**
+ * @brief Eagerly started coroutine that nobody awaits; its frame frees
+ * itself on completion. Exceptions must not escape the body.
+ */
+struct DetachedTask {
+	struct promise_type {
+		DetachedTask get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+/**
+ * @brief Unbounded MPMC queue whose pop() suspends the awaiting coroutine
+ * instead of blocking its thread.
+ *
+ * push() may be called from any thread; a parked consumer is resumed on the
+ * executor, not on the pushing thread.
+ */
+template <typename T>
+class AsyncQueue {
+public:
+	explicit AsyncQueue(Executor& executor) : executor_(executor) {}
+
+	void push(T value) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (waiters_.empty()) {
+			items_.push_back(std::move(value));
+			return;
+		}
+
+		PopAwaiter* waiter = waiters_.front();
+		waiters_.pop_front();
+		waiter->slot_.emplace(std::move(value));
+		lock.unlock();
+		executor_.post(waiter->handle_);
+	}
+
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return items_.size();
+	}
+
+	class PopAwaiter {
+	public:
+		explicit PopAwaiter(AsyncQueue& queue) : queue_(queue) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		// Returning false resumes immediately when an item is already queued
+		bool await_suspend(std::coroutine_handle<> handle) {
+			std::lock_guard<std::mutex> lock(queue_.mutex_);
+			if (!queue_.items_.empty()) {
+				slot_.emplace(std::move(queue_.items_.front()));
+				queue_.items_.pop_front();
+				return false;
+			}
+			handle_ = handle;
+			queue_.waiters_.push_back(this);
+			return true;
+		}
+
+		T await_resume() { return std::move(*slot_); }
+
+	private:
+		friend class AsyncQueue;
+		AsyncQueue& queue_;
+		std::coroutine_handle<> handle_;
+		std::optional<T> slot_;
+	};
+
+	/**
+	 * @brief `T item = co_await queue.pop();`
+	 */
+	PopAwaiter pop() { return PopAwaiter(*this); }
+
+private:
+	Executor& executor_;
+	mutable std::mutex mutex_;
+	std::deque<T> items_;
+	std::deque<PopAwaiter*> waiters_;
+};
+
+#endif // CORO_HPP
@@ -0,0 +1,49 @@
+#ifndef DESCRIPTOR_DISTANCE_HPP
+#define DESCRIPTOR_DISTANCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Distance kernels for descriptor matching, in scalar, AVX2 and AVX-512
+ * variants. The vector variants are compiled with per-function target
+ * attributes and selected at runtime from what the CPU supports, so the
+ * binary stays portable without global -mavx2 / -mavx512f flags.
+ */
+
+enum class SimdLevel {
+	Scalar,
+	Avx2,     // AVX2 + FMA
+	Avx512    // AVX-512 F/BW, plus VPOPCNTDQ for Hamming when available
+};
+
+/**
+ * @brief Highest level the running CPU supports.
+ */
+SimdLevel detect_simd_level();
+
+const char* simd_level_name(SimdLevel level);
+
+// Squared L2 distance between two float vectors of length n
+using L2Kernel = float (*)(const float* a, const float* b, size_t n);
+
+// Number of differing bits between two byte strings of length n
+using HammingKernel = uint32_t (*)(const uint8_t* a, const uint8_t* b, size_t n);
+
+struct DistanceKernels {
+	SimdLevel level;
+	L2Kernel l2_squared;
+	HammingKernel hamming;
+};
+
+/**
+ * @brief Kernels for `level`, lowered to what the CPU supports.
+ */
+DistanceKernels distance_kernels(SimdLevel level);
+
+/**
+ * @brief Kernels for detect_simd_level(), resolved once.
+ */
+const DistanceKernels& best_distance_kernels();
+
+#endif // DESCRIPTOR_DISTANCE_HPP
@@ -0,0 +1,120 @@
+#ifndef DESCRIPTOR_STORE_HPP
+#define DESCRIPTOR_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "opencv2/core.hpp"
+
+/**
+ * Flat on-disk descriptor store, written by the logger next to its SQLite
+ * database so that consumers (matcher, vocabulary trainer) can mmap it
+ * instead of decoding BLOBs row by row.
+ *
+ * <path>         data file: a 64-byte header, then per image the filename
+ *                and the descriptor rows, each starting 64-byte aligned
+ * <path>.idx     offset table: one fixed-size StoreEntry per image
+ *
+ * Both files are append-only. An image's data is written before its table
+ * entry, so a reader that sees an entry also sees complete data, and a
+ * crash mid-append at worst leaves unreferenced bytes in the data file.
+ * All integers are little-endian; rows are dense (cols * elemSize bytes).
+ */
+
+constexpr uint32_t STORE_MAGIC = 0x44534944; // "DISD" read little-endian
+constexpr uint32_t STORE_VERSION = 1;
+constexpr size_t STORE_ALIGNMENT = 64;
+
+struct StoreHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t cols;      // descriptor length
+	uint32_t type;      // OpenCV element type, e.g. CV_32F
+	uint8_t reserved[48];
+};
+static_assert(sizeof(StoreHeader) == STORE_ALIGNMENT, "header fills one aligned block");
+
+struct StoreEntry {
+	int64_t image_id;       // logger's processed_images.id
+	uint64_t name_offset;   // filename bytes in the data file
+	uint64_t data_offset;   // first descriptor row, STORE_ALIGNMENT aligned
+	uint32_t name_size;
+	uint32_t rows;
+};
+static_assert(sizeof(StoreEntry) == 32, "fixed-size offset table entries");
+
+/**
+ * @brief Appends images to a descriptor store, creating it if needed.
+ */
+class DescriptorStoreWriter {
+public:
+	/**
+	 * @throws std::system_error if the files cannot be opened,
+	 *         std::runtime_error if <path> is not a descriptor store.
+	 */
+	explicit DescriptorStoreWriter(const std::string& path);
+	~DescriptorStoreWriter();
+
+	DescriptorStoreWriter(const DescriptorStoreWriter&) = delete;
+	DescriptorStoreWriter& operator=(const DescriptorStoreWriter&) = delete;
+
+	/**
+	 * @brief Appends one image's descriptors. The first append fixes the
+	 * store's descriptor length and type; later mismatches throw
+	 * std::invalid_argument.
+	 * @throws std::system_error on write errors.
+	 */
+	void append(int64_t image_id, const std::string& filename, const cv::Mat& descriptors);
+
+private:
+	int data_fd_;
+	int index_fd_;
+	uint64_t data_size_;
+	uint64_t index_size_;
+	StoreHeader header_;
+};
+
+/**
+ * @brief Read-only memory-mapped view of a descriptor store.
+ *
+ * Opening only maps the files and checks the table, so it is O(1) in the
+ * data size; descriptor pages are faulted in (and shared with other
+ * readers through the page cache) as they are used. Entries appended after
+ * opening are not visible.
+ */
+class DescriptorStore {
+public:
+	struct Image {
+		int64_t image_id;
+		std::string filename;
+		cv::Mat descriptors; // header over the mapping, valid while the store is open
+	};
+
+	/**
+	 * @throws std::system_error if the files cannot be mapped,
+	 *         std::runtime_error if they are not a valid store.
+	 */
+	explicit DescriptorStore(const std::string& path);
+	~DescriptorStore();
+
+	DescriptorStore(const DescriptorStore&) = delete;
+	DescriptorStore& operator=(const DescriptorStore&) = delete;
+
+	size_t size() const { return entry_count_; }
+
+	Image image(size_t i) const;
+
+	int cols() const { return static_cast<int>(header_.cols); }
+	int type() const { return static_cast<int>(header_.type); }
+
+private:
+	const char* data_ = nullptr;
+	size_t data_size_ = 0;
+	const StoreEntry* entries_ = nullptr;
+	size_t index_size_ = 0;
+	size_t entry_count_ = 0;
+	StoreHeader header_{};
+};
+
+#endif // DESCRIPTOR_STORE_HPP
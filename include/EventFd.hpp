@@ -0,0 +1,31 @@
+#ifndef EVENT_FD_HPP
+#define EVENT_FD_HPP
+
+/**
+ * @brief Linux eventfd used to wake an EventLoop from another thread.
+ *
+ * notify() may be called from any thread; the owner polls fd() and calls
+ * drain() once woken, before consuming whatever it was told about.
+ */
+class EventFd {
+public:
+	/**
+	 * @throws std::system_error if the eventfd cannot be created.
+	 */
+	EventFd();
+	~EventFd();
+
+	EventFd(const EventFd&) = delete;
+	EventFd& operator=(const EventFd&) = delete;
+
+	int fd() const { return fd_; }
+
+	void notify();
+
+	void drain();
+
+private:
+	int fd_;
+};
+
+#endif // EVENT_FD_HPP
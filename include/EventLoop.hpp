@@ -0,0 +1,105 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "zmq.hpp"
+#include "EventFd.hpp"
+
+/**
+ * @brief Single-threaded reactor over ZMQ sockets, plain file descriptors
+ * (e.g. an EventFd) and timers, built on zmq_poll.
+ *
+ * Timers are backed by one timerfd, so they have microsecond resolution
+ * even though zmq_poll itself only takes millisecond timeouts, and the
+ * loop never busy-waits.
+ *
+ * Everything except stop() must be called from the thread running run(),
+ * or before run() starts. Callbacks may add or remove handlers and timers.
+ */
+class EventLoop {
+public:
+	using Callback = std::function<void()>;
+	using TimerId = uint64_t;
+
+	/**
+	 * @throws std::system_error if the timerfd cannot be created.
+	 */
+	EventLoop();
+	~EventLoop();
+
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	/**
+	 * @brief Calls `on_readable` whenever `socket` has a message waiting.
+	 *
+	 * Polling is level-triggered: the callback should receive at least one
+	 * message, and may drain more with zmq::recv_flags::dontwait.
+	 */
+	void add_socket(zmq::socket_t& socket, Callback on_readable);
+	void remove_socket(zmq::socket_t& socket);
+
+	/**
+	 * @brief Calls `on_readable` whenever `fd` is readable.
+	 */
+	void add_fd(int fd, Callback on_readable);
+	void remove_fd(int fd);
+
+	/**
+	 * @brief Runs `callback` once, `delay` from now.
+	 */
+	TimerId add_timer(std::chrono::microseconds delay, Callback callback);
+
+	/**
+	 * @brief Runs `callback` every `interval` until cancelled.
+	 */
+	TimerId add_periodic(std::chrono::microseconds interval, Callback callback);
+
+	void cancel_timer(TimerId id);
+
+	/**
+	 * @brief Dispatches events until stop() is called.
+	 * @throws zmq::error_t if polling fails.
+	 */
+	void run();
+
+	/**
+	 * @brief Makes run() return after the current dispatch; thread-safe.
+	 */
+	void stop();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Handler {
+		uint64_t id;
+		void* socket; // nullptr for plain fds
+		int fd;
+		Callback callback;
+	};
+
+	struct Timer {
+		Clock::time_point due;
+		std::chrono::microseconds interval; // zero for one-shot timers
+		Callback callback;
+	};
+
+	void arm_timerfd();
+	void fire_due_timers();
+
+	std::vector<Handler> handlers_;
+	uint64_t next_handler_id_;
+	std::map<TimerId, Timer> timers_;
+	TimerId next_timer_id_;
+	int timer_fd_;
+	EventFd wakeup_;
+	std::atomic<bool> stopped_;
+};
+
+#endif // EVENT_LOOP_HPP
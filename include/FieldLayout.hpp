@@ -0,0 +1,234 @@
+#ifndef FIELD_LAYOUT_HPP
+#define FIELD_LAYOUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <tuple>
+#include <type_traits>
+#include <utility> // index_sequence
+
+/**
+ * Compile-time description of a packed binary record format.
+ *
+ * A format is a list of field descriptors; layout::Format generates the
+ * pack / unpack loops for it, with every field's offset and the record
+ * size known at compile time (the per-record field writes unroll into
+ * fixed-offset memcpys). Formats are checked with static_assert where
+ * they are defined, e.g. against the size the wire format documents.
+ *
+ *   using KeyPointFormat = layout::Format<layout::Order::Interleaved,
+ *       layout::Nested<float, &cv::KeyPoint::pt, &cv::Point2f::x>,
+ *       layout::Member<float, &cv::KeyPoint::size>, ...>;
+ *   static_assert(KeyPointFormat::record_size == 28, "...");
+ *   KeyPointFormat::pack(keypoints, keypoints.size(), buffer.data());
+ *
+ * Records are anything indexable: a std::vector, or a pointer to a single
+ * struct (count 1). Each field's first template argument is its type on
+ * the wire, which sets the precision (values are static_cast to and from
+ * it); multi-byte values are in native byte order and not aligned.
+ *
+ * Order::Interleaved stores record after record (array of structures);
+ * Order::Planar stores each field for all records, then the next field
+ * (structure of arrays).
+ */
+namespace layout {
+
+enum class Order { Interleaved, Planar };
+
+namespace detail {
+
+template <typename Wire>
+void put(char* out, Wire value) {
+	std::memcpy(out, &value, sizeof(Wire));
+}
+
+template <typename Wire>
+Wire take(const char* in) {
+	Wire value;
+	std::memcpy(&value, in, sizeof(Wire));
+	return value;
+}
+
+template <typename T, typename Wire>
+void assign(T& target, Wire value) {
+	target = static_cast<T>(value);
+}
+
+// Sum of the sizes of the first I fields
+template <size_t I, typename... Fields>
+constexpr size_t offset_of() {
+	constexpr size_t sizes[] = {Fields::size...};
+	size_t offset = 0;
+	for (size_t k = 0; k < I; ++k) {
+		offset += sizes[k];
+	}
+	return offset;
+}
+
+} // namespace detail
+
+// Data member of the record, e.g. &cv::KeyPoint::size
+template <typename Wire, auto MemberPtr>
+struct Member {
+	static_assert(std::is_arithmetic<Wire>::value, "Wire types must be arithmetic.");
+	using wire_type = Wire;
+	static constexpr size_t size = sizeof(Wire);
+
+	template <typename Records>
+	static void write(char* out, const Records& records, size_t i) {
+		detail::put(out, static_cast<Wire>(records[i].*MemberPtr));
+	}
+	template <typename Records>
+	static void read(const char* in, Records& records, size_t i) {
+		detail::assign(records[i].*MemberPtr, detail::take<Wire>(in));
+	}
+};
+
+// Member of a member, e.g. &cv::KeyPoint::pt then &cv::Point2f::x
+template <typename Wire, auto OuterPtr, auto InnerPtr>
+struct Nested {
+	static_assert(std::is_arithmetic<Wire>::value, "Wire types must be arithmetic.");
+	using wire_type = Wire;
+	static constexpr size_t size = sizeof(Wire);
+
+	template <typename Records>
+	static void write(char* out, const Records& records, size_t i) {
+		detail::put(out, static_cast<Wire>((records[i].*OuterPtr).*InnerPtr));
+	}
+	template <typename Records>
+	static void read(const char* in, Records& records, size_t i) {
+		detail::assign((records[i].*OuterPtr).*InnerPtr, detail::take<Wire>(in));
+	}
+};
+
+// All N elements of an array member, e.g. a 3x3 matrix as double[9]
+template <typename Wire, auto ArrayPtr, size_t N>
+struct Array {
+	static_assert(std::is_arithmetic<Wire>::value, "Wire types must be arithmetic.");
+	using wire_type = Wire;
+	static constexpr size_t size = N * sizeof(Wire);
+
+	template <typename Records>
+	static void write(char* out, const Records& records, size_t i) {
+		const auto& values = records[i].*ArrayPtr;
+		static_assert(std::extent<std::remove_reference_t<decltype(values)>>::value == N,
+					  "Array field size does not match the member.");
+		for (size_t k = 0; k < N; ++k) {
+			detail::put(out + k * sizeof(Wire), static_cast<Wire>(values[k]));
+		}
+	}
+	template <typename Records>
+	static void read(const char* in, Records& records, size_t i) {
+		auto& values = records[i].*ArrayPtr;
+		for (size_t k = 0; k < N; ++k) {
+			detail::assign(values[k], detail::take<Wire>(in + k * sizeof(Wire)));
+		}
+	}
+};
+
+// Element i of a column accessor of a structure-of-arrays container,
+// e.g. &KeypointSet::x (pack only)
+template <typename Wire, auto ColumnFn>
+struct Column {
+	static_assert(std::is_arithmetic<Wire>::value, "Wire types must be arithmetic.");
+	using wire_type = Wire;
+	static constexpr size_t size = sizeof(Wire);
+
+	template <typename Records>
+	static void write(char* out, const Records& records, size_t i) {
+		detail::put(out, static_cast<Wire>((records.*ColumnFn)()[i]));
+	}
+};
+
+// A value the records do not carry: written as `Value`, skipped on read
+template <typename Wire, Wire Value>
+struct Constant {
+	using wire_type = Wire;
+	static constexpr size_t size = sizeof(Wire);
+
+	template <typename Records>
+	static void write(char* out, const Records&, size_t) {
+		detail::put(out, Value);
+	}
+	template <typename Records>
+	static void read(const char*, Records&, size_t) {}
+};
+
+template <Order order, typename... Fields>
+struct Format {
+	static_assert(sizeof...(Fields) > 0, "A format needs at least one field.");
+
+	// Bytes per record
+	static constexpr size_t record_size = (Fields::size + ...);
+
+	// Wire types in order, to compare two formats for compatibility
+	using wire_types = std::tuple<typename Fields::wire_type...>;
+
+	static constexpr size_t packed_size(size_t count) { return count * record_size; }
+
+	/**
+	 * @brief Writes `count` records to `out`, which must hold
+	 * packed_size(count) bytes.
+	 */
+	template <typename Records>
+	static void pack(const Records& records, size_t count, char* out) {
+		if constexpr (order == Order::Interleaved) {
+			for (size_t i = 0; i < count; ++i, out += record_size) {
+				pack_record(records, i, out, std::index_sequence_for<Fields...>());
+			}
+		} else {
+			size_t column = 0;
+			((pack_column<Fields>(records, count, out + column * count), column += Fields::size), ...);
+		}
+	}
+
+	/**
+	 * @brief Reads `count` records from `in` (packed_size(count) bytes) into
+	 * `records`, which must already hold `count` records.
+	 */
+	template <typename Records>
+	static void unpack(const char* in, size_t count, Records& records) {
+		if constexpr (order == Order::Interleaved) {
+			for (size_t i = 0; i < count; ++i, in += record_size) {
+				unpack_record(in, records, i, std::index_sequence_for<Fields...>());
+			}
+		} else {
+			size_t column = 0;
+			((unpack_column<Fields>(in + column * count, count, records), column += Fields::size), ...);
+		}
+	}
+
+	// Byte offset of field I within an interleaved record
+	template <size_t I>
+	static constexpr size_t offset = detail::offset_of<I, Fields...>();
+
+private:
+	template <typename Records, size_t... I>
+	static void pack_record(const Records& records, size_t i, char* out, std::index_sequence<I...>) {
+		(Fields::write(out + offset<I>, records, i), ...);
+	}
+
+	template <typename Records, size_t... I>
+	static void unpack_record(const char* in, Records& records, size_t i, std::index_sequence<I...>) {
+		(Fields::read(in + offset<I>, records, i), ...);
+	}
+
+	template <typename Field, typename Records>
+	static void pack_column(const Records& records, size_t count, char* out) {
+		for (size_t i = 0; i < count; ++i) {
+			Field::write(out + i * Field::size, records, i);
+		}
+	}
+
+	template <typename Field, typename Records>
+	static void unpack_column(const char* in, size_t count, Records& records) {
+		for (size_t i = 0; i < count; ++i) {
+			Field::read(in + i * Field::size, records, i);
+		}
+	}
+};
+
+} // namespace layout
+
+#endif // FIELD_LAYOUT_HPP
@@ -0,0 +1,77 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Batch.hpp" // PartView, RecordView
+
+/**
+ * @brief Single contiguous ZMQ frame carrying what would otherwise be a
+ * multipart message (one send, one receive, no rcvmore round-trips).
+ *
+ * Wire layout (native byte order):
+ * - magic (uint32, FRAME_MAGIC)
+ * - version (uint16, FRAME_VERSION)
+ * - part_count (uint16)
+ * - part_count x (offset, size) pairs (uint64 each); offsets are measured
+ *   from the start of the frame
+ * - payloads, each starting on a FRAME_ALIGNMENT boundary so that float
+ *   arrays (e.g. keypoints) can be read in place
+ */
+
+// "DISF" read as a little-endian uint32
+constexpr uint32_t FRAME_MAGIC = 0x46534944;
+constexpr uint16_t FRAME_VERSION = 1;
+constexpr size_t FRAME_ALIGNMENT = 8;
+
+/**
+ * @brief How an application publishes its records.
+ */
+enum class WireFormat {
+	Multipart, // one ZMQ part per field (the original format)
+	Frame      // one contiguous frame per record (this file)
+};
+
+/**
+ * @brief Parses "multipart" or "frame".
+ * @throws std::invalid_argument for anything else.
+ */
+WireFormat parse_wire_format(const std::string& name);
+
+/**
+ * @brief Number of bytes encode_frame_into() will write for these parts.
+ */
+size_t framed_size(const RecordView& parts);
+
+/**
+ * @brief Encodes parts into `out`, which must hold framed_size(parts) bytes.
+ *
+ * Lets callers encode straight into a zmq::message_t without an extra copy.
+ *
+ * @throws std::length_error if there are more parts than fit in the header.
+ */
+void encode_frame_into(const RecordView& parts, void* out);
+
+/**
+ * @brief Convenience wrapper returning a freshly allocated frame.
+ */
+std::vector<char> encode_frame(const RecordView& parts);
+
+/**
+ * @brief Cheap check for the frame magic at the start of a buffer.
+ */
+bool is_frame(const void* data, size_t size);
+
+/**
+ * @brief Returns views of the parts of a frame without copying payloads.
+ *
+ * The returned views point into `data`, which must outlive them.
+ *
+ * @throws std::runtime_error if the frame is truncated or malformed.
+ */
+RecordView decode_frame(const void* data, size_t size);
+
+#endif // FRAME_HPP
@@ -0,0 +1,71 @@
+#ifndef IMAGE_CODEC_HPP
+#define IMAGE_CODEC_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+/**
+ * Image codecs for the generator -> extractor stream.
+ *
+ * - Jpeg, Png, Webp, Jxl go through OpenCV's imgcodecs; WebP and JPEG XL
+ *   are only there when OpenCV was built with libwebp / libjxl (see
+ *   image_codec_available()).
+ * - Qoi ("Quite OK Image", qoiformat.org) is built in: lossless like PNG
+ *   but decodes several times faster, at somewhat larger sizes.
+ *
+ * Every consumer of image bytes decodes through decode_image(), which
+ * recognizes QOI by its magic and hands everything else to cv::imdecode.
+ */
+enum class ImageCodec { Keep, Jpeg, Png, Webp, Jxl, Qoi };
+
+/**
+ * @brief Parses keep, jpeg, png, webp, jxl, qoi, or "fastest" (the codec
+ * with the cheapest decode, QOI).
+ * @throws std::invalid_argument for anything else.
+ */
+ImageCodec parse_image_codec(const std::string& name);
+
+const char* image_codec_name(ImageCodec codec);
+
+// File extension, e.g. ".qoi"; empty for Keep
+std::string image_codec_extension(ImageCodec codec);
+
+// Codec for a file extension such as ".JPG" (any case); Keep if unknown
+ImageCodec image_codec_for_extension(std::string extension);
+
+/**
+ * @brief True if this build can both encode and decode `codec`.
+ */
+bool image_codec_available(ImageCodec codec);
+
+/**
+ * @brief Encodes an 8-bit BGR, BGRA or gray image.
+ * @param quality 0-100 for lossy codecs (JPEG, WebP, JPEG XL), ignored otherwise.
+ * @return false if the codec is unavailable or the image unsupported.
+ */
+bool encode_image(ImageCodec codec, const cv::Mat& image, std::vector<uchar>& buffer,
+				  int quality = 95);
+
+/**
+ * @brief Decodes compressed image bytes, like cv::imdecode with `flags`
+ * (IMREAD_COLOR, IMREAD_GRAYSCALE, IMREAD_REDUCED_*, IMREAD_UNCHANGED).
+ *
+ * Decodes into `image`, reusing its buffer when the size matches.
+ * @return false if the bytes could not be decoded.
+ */
+bool decode_image(const char* data, size_t size, int flags, cv::Mat& image);
+
+/**
+ * @brief QOI encoder / decoder used by encode_image() and decode_image().
+ *
+ * qoi_encode takes CV_8UC3 (BGR) or CV_8UC4 (BGRA) images; qoi_decode
+ * returns CV_8UC3 or CV_8UC4 depending on the file's channel count.
+ */
+bool is_qoi(const char* data, size_t size);
+std::vector<uchar> qoi_encode(const cv::Mat& image);
+bool qoi_decode(const char* data, size_t size, cv::Mat& image);
+
+#endif // IMAGE_CODEC_HPP
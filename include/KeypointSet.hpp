@@ -0,0 +1,64 @@
+#ifndef KEYPOINT_SET_HPP
+#define KEYPOINT_SET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+/**
+ * @brief Keypoints stored as one array per field (structure of arrays).
+ *
+ * cv::KeyPoint is 28 bytes including class_id, which the pipeline never
+ * sets, and passes that only look at one field (capping by response,
+ * collecting positions for motion) drag all of them through the cache.
+ * Here each field is contiguous, and class_id is not kept: it is written
+ * as -1 (OpenCV's default) where a cv::KeyPoint or the wire format
+ * wants one.
+ */
+class KeypointSet {
+public:
+	KeypointSet() = default;
+	explicit KeypointSet(const std::vector<cv::KeyPoint>& keypoints) { assign(keypoints); }
+
+	size_t size() const { return x_.size(); }
+	bool empty() const { return x_.empty(); }
+
+	void clear();
+	void reserve(size_t n);
+	void push_back(const cv::KeyPoint& keypoint);
+
+	// Replaces the contents, reusing the arrays' capacity
+	void assign(const std::vector<cv::KeyPoint>& keypoints);
+
+	cv::KeyPoint keypoint(size_t i) const;
+	std::vector<cv::KeyPoint> to_keypoints() const;
+
+	/**
+	 * @brief Keeps the `n` keypoints with the highest response, in their
+	 * current order (on equal responses, the earlier ones).
+	 * @param kept If not null, receives the kept keypoints' former indices,
+	 * ascending, e.g. to select the matching descriptor rows.
+	 * @return false if there were at most `n` (nothing removed; `kept` is
+	 * left untouched).
+	 */
+	bool retain_strongest(size_t n, std::vector<int>* kept = nullptr);
+
+	const std::vector<float>& x() const { return x_; }
+	const std::vector<float>& y() const { return y_; }
+	const std::vector<float>& sizes() const { return size_; }
+	const std::vector<float>& angles() const { return angle_; }
+	const std::vector<float>& responses() const { return response_; }
+	const std::vector<int32_t>& octaves() const { return octave_; }
+
+private:
+	std::vector<float> x_;
+	std::vector<float> y_;
+	std::vector<float> size_;
+	std::vector<float> angle_;
+	std::vector<float> response_;
+	std::vector<int32_t> octave_;
+};
+
+#endif // KEYPOINT_SET_HPP
@@ -0,0 +1,104 @@
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "Metrics.hpp"
+
+/**
+ * @brief Bytes held by frames in flight, against an optional limit.
+ *
+ * Frames are admitted where they enter a process (acquire() /
+ * try_acquire()); once admitted they may grow as later stages decode or
+ * serialize them (charge()), even past the limit, so no stage ever waits
+ * on memory only a later stage could free. Admission is what pushes back:
+ * new frames wait for, or are dropped until, enough to be released.
+ *
+ * Thread-safe.
+ */
+class MemoryBudget {
+public:
+	// `limit` in bytes, 0 for none; `used` mirrors the bytes in use
+	MemoryBudget(size_t limit, Gauge& used);
+
+	size_t limit() const { return limit_; }
+	size_t used() const;
+
+	/**
+	 * @brief Admits a frame of `bytes` if it fits, or if no other frame is
+	 * in flight (so a frame bigger than the whole budget, or than what the
+	 * workers' buffers leave of it, still gets through, alone).
+	 */
+	bool try_acquire(size_t bytes);
+
+	/**
+	 * @brief Waits until try_acquire() would succeed, then admits.
+	 * @return false if it had to wait.
+	 */
+	bool acquire(size_t bytes);
+
+	// Takes `bytes` regardless of the limit
+	void charge(size_t bytes);
+
+	// Gives back `bytes`; `frame_done` ends an admitted frame
+	void release(size_t bytes, bool frame_done = false);
+
+private:
+	bool fits(size_t bytes) const;
+
+	size_t limit_;
+	size_t used_ = 0;
+	size_t frames_ = 0; // admitted and not yet released
+	Gauge& gauge_;
+	mutable std::mutex mutex_;
+	std::condition_variable released_;
+};
+
+/**
+ * @brief Bytes one frame (or buffer) holds of a MemoryBudget, attributed
+ * to a stage gauge (e.g. "extractor.work_queue_bytes").
+ *
+ * Travels with the frame from stage to stage and gives the bytes back
+ * when destroyed, so frames dropped anywhere are accounted for. Move-only;
+ * a default-constructed charge is empty and does nothing.
+ */
+class MemoryCharge {
+public:
+	MemoryCharge() = default;
+
+	// Takes over a frame of `bytes` admitted by `budget`
+	MemoryCharge(MemoryBudget& budget, Gauge& stage, size_t bytes);
+
+	// Starts empty, for a long-lived buffer that grows with resize()
+	MemoryCharge(MemoryBudget& budget, Gauge& stage);
+
+	~MemoryCharge() { reset(); }
+
+	MemoryCharge(MemoryCharge&& other) noexcept;
+	MemoryCharge& operator=(MemoryCharge&& other) noexcept;
+	MemoryCharge(const MemoryCharge&) = delete;
+	MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+	bool empty() const { return budget_ == nullptr; }
+	size_t bytes() const { return bytes_; }
+
+	// Attributes the bytes to another stage
+	void move_to(Gauge& stage);
+
+	// Grows (charging the budget) or shrinks (releasing) to `bytes`
+	void resize(size_t bytes);
+
+	// Gives everything back
+	void reset();
+
+private:
+	MemoryBudget* budget_ = nullptr;
+	Gauge* stage_ = nullptr;
+	size_t bytes_ = 0;
+	bool frame_ = false;
+};
+
+#endif // MEMORY_BUDGET_HPP
@@ -0,0 +1,68 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Monotonic event counter; reported with its rate since the last report.
+ */
+class Counter {
+public:
+	void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @brief Point-in-time value (queue depth, bytes in flight, ...).
+ */
+class Gauge {
+public:
+	void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+	void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+	void sub(int64_t n) { value_.fetch_sub(n, std::memory_order_relaxed); }
+	int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> value_{0};
+};
+
+/**
+ * @brief Process-wide registry of named counters and gauges.
+ *
+ * Lookups take a lock, so hot paths should look a metric up once and keep
+ * the reference, which stays valid for the life of the process:
+ *
+ *   static Counter& frames = Metrics::global().counter("extractor.frames");
+ *   frames.add();
+ */
+class Metrics {
+public:
+	static Metrics& global();
+
+	Counter& counter(const std::string& name);
+	Gauge& gauge(const std::string& name);
+
+	/**
+	 * @brief One line of "name=value" pairs sorted by name; counters also
+	 * show their per-second rate since the previous call.
+	 */
+	std::string report();
+
+private:
+	std::mutex mutex_;
+	std::map<std::string, std::unique_ptr<Counter>> counters_;
+	std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+	std::map<std::string, uint64_t> last_counts_;
+	std::chrono::steady_clock::time_point last_report_ = std::chrono::steady_clock::now();
+};
+
+#endif // METRICS_HPP
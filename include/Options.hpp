@@ -0,0 +1,66 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Minimal command-line parser shared by the applications.
+ *
+ * Accepts "--key=value" and bare "--flag" arguments (a bare flag is stored
+ * as "true"). Anything not starting with "--" is kept as a positional
+ * argument, in order, so existing positional usage keeps working.
+ */
+class Options {
+public:
+	Options(int argc, char* argv[]);
+
+	bool has(const std::string& key) const;
+
+	/**
+	 * @brief Names of all "--key" options given, in sorted order.
+	 */
+	std::vector<std::string> keys() const;
+
+	std::string get(const std::string& key, const std::string& fallback) const;
+
+	/**
+	 * @brief Integer option.
+	 * @throws std::invalid_argument if the value is not a valid integer.
+	 */
+	long long get_int(const std::string& key, long long fallback) const;
+
+	/**
+	 * @brief Floating point option.
+	 * @throws std::invalid_argument if the value is not a valid number.
+	 */
+	double get_double(const std::string& key, double fallback) const;
+
+	/**
+	 * @brief Boolean option; accepts true/false, 1/0, yes/no, on/off.
+	 * @throws std::invalid_argument for any other value.
+	 */
+	bool get_bool(const std::string& key, bool fallback) const;
+
+	/**
+	 * @brief Comma-separated list option. Empty items are dropped.
+	 */
+	std::vector<std::string> get_list(const std::string& key,
+									  const std::vector<std::string>& fallback) const;
+
+	/**
+	 * @brief Comma-separated list of integers.
+	 * @throws std::invalid_argument if an item is not an integer.
+	 */
+	std::vector<long long> get_int_list(const std::string& key,
+										const std::vector<long long>& fallback) const;
+
+	const std::vector<std::string>& positional() const { return positional_; }
+
+private:
+	std::map<std::string, std::string> values_;
+	std::vector<std::string> positional_;
+};
+
+#endif // OPTIONS_HPP
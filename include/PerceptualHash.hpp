@@ -0,0 +1,96 @@
+#ifndef PERCEPTUAL_HASH_HPP
+#define PERCEPTUAL_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+/**
+ * 64-bit perceptual image hashes: visually similar images get hashes a
+ * small Hamming distance apart, so re-encoded, slightly rescaled or
+ * otherwise near-identical frames can be found without comparing pixels.
+ *
+ * - DHash: signs of horizontal gradients on a 9x8 thumbnail. Cheap; robust
+ *   to scaling and re-encoding.
+ * - PHash: low-frequency 8x8 DCT coefficients of a 32x32 thumbnail against
+ *   their median. Costs a small DCT; also robust to contrast and gamma.
+ */
+enum class HashKind { DHash, PHash };
+
+/**
+ * @brief Parses "dhash" or "phash".
+ * @throws std::invalid_argument for anything else.
+ */
+HashKind parse_hash_kind(const std::string& name);
+
+const char* hash_kind_name(HashKind kind);
+
+/**
+ * @brief Hash of an 8-bit grayscale image of any size (at least 1x1).
+ * @throws std::invalid_argument if `gray` is empty or not CV_8UC1.
+ */
+uint64_t perceptual_hash(const cv::Mat& gray, HashKind kind);
+
+inline int hash_distance(uint64_t a, uint64_t b) {
+	return __builtin_popcountll(a ^ b);
+}
+
+/**
+ * @brief Finds stored hashes within a Hamming radius of a query, by
+ * multi-index hashing.
+ *
+ * The 64 bits are split into max_distance + 1 disjoint chunks, each with
+ * its own hash table. Two hashes at most max_distance bits apart cannot
+ * differ in every chunk (pigeonhole), so looking up the query's chunks
+ * exactly yields every candidate; candidates are then checked on the full
+ * 64 bits. A lookup touches max_distance + 1 buckets instead of every
+ * stored hash.
+ */
+class HashIndex {
+public:
+	struct Match {
+		int64_t id = -1;
+		int distance = 0;
+	};
+
+	/**
+	 * @throws std::invalid_argument unless 0 <= max_distance < 32.
+	 */
+	explicit HashIndex(int max_distance);
+
+	void add(uint64_t hash, int64_t id);
+
+	/**
+	 * @brief Drops the hashes added after the index had `size` entries, e.g.
+	 * those of a batch whose transaction was rolled back.
+	 */
+	void truncate(size_t size);
+
+	/**
+	 * @brief Closest stored hash within max_distance (the earliest added on
+	 * ties).
+	 * @return false if there is none.
+	 */
+	bool find(uint64_t hash, Match& match) const;
+
+	size_t size() const { return hashes_.size(); }
+	int max_distance() const { return max_distance_; }
+
+private:
+	struct Chunk {
+		int shift;
+		uint64_t mask;
+	};
+
+	int max_distance_;
+	std::vector<Chunk> chunks_;
+	std::vector<std::unordered_map<uint64_t, std::vector<uint32_t>>> tables_; // one per chunk
+	std::vector<uint64_t> hashes_;
+	std::vector<int64_t> ids_;
+};
+
+#endif // PERCEPTUAL_HASH_HPP
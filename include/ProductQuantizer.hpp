@@ -0,0 +1,83 @@
+#ifndef PRODUCT_QUANTIZER_HPP
+#define PRODUCT_QUANTIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+/**
+ * @brief Product-quantization codec for float descriptors.
+ *
+ * A descriptor of `dims` floats is split into `subspaces` equal slices and
+ * each slice is replaced by the index of its nearest centroid in that
+ * slice's 256-entry codebook, so a 128-float (512 byte) SIFT descriptor
+ * becomes an 8 or 16 byte code.
+ *
+ * Distances are computed asymmetrically (ADC): the query stays in floats,
+ * distance_table() precomputes its squared distance to every centroid,
+ * and the distance to a code is then `subspaces` table lookups.
+ */
+class ProductQuantizer {
+public:
+	static constexpr int CENTROIDS = 256; // one byte per subspace
+
+	struct Params {
+		int subspaces = 16;            // code bytes; must divide the descriptor length
+		size_t max_samples = 100000;   // training rows fed to k-means
+		int kmeans_iterations = 20;
+	};
+
+	/**
+	 * @brief Trains the codebooks on descriptors (CV_32F, one row each).
+	 * @throws std::invalid_argument on unusable input or parameters.
+	 */
+	static ProductQuantizer train(const cv::Mat& samples, const Params& params);
+
+	/**
+	 * @brief Loads codebooks written by save(); throws std::runtime_error.
+	 */
+	static ProductQuantizer load(const std::string& path);
+
+	void save(const std::string& path) const;
+
+	int dims() const { return dims_; }
+	int subspaces() const { return subspaces_; }
+	size_t code_size() const { return static_cast<size_t>(subspaces_); }
+
+	/**
+	 * @brief Codes (CV_8U, one row of code_size() bytes) of each descriptor.
+	 */
+	cv::Mat encode(const cv::Mat& descriptors) const;
+
+	/**
+	 * @brief Approximate descriptors (CV_32F) reconstructed from codes.
+	 */
+	cv::Mat decode(const cv::Mat& codes) const;
+
+	/**
+	 * @brief Fills `table` (subspaces() * CENTROIDS floats) with the squared
+	 * distances from each slice of `query` to that slice's centroids.
+	 */
+	void distance_table(const float* query, float* table) const;
+
+	/**
+	 * @brief ADC kernel: squared distance estimates from the query behind
+	 * `table` to `count` consecutive codes.
+	 */
+	void scan(const float* table, const uint8_t* codes, size_t count, float* distances) const;
+
+private:
+	const float* centroid(int subspace, int index) const {
+		return centroids_.data() + (static_cast<size_t>(subspace) * CENTROIDS + index) * sub_dims_;
+	}
+
+	int dims_ = 0;
+	int subspaces_ = 0;
+	int sub_dims_ = 0;
+	std::vector<float> centroids_; // [subspace][centroid][sub_dims]
+};
+
+#endif // PRODUCT_QUANTIZER_HPP
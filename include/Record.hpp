@@ -0,0 +1,87 @@
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <string>
+#include <vector>
+
+#include "zmq.hpp"
+#include "Batch.hpp" // PartView, RecordView
+
+/**
+ * Layout of one extractor output record, shared by everything that
+ * consumes the extractor's stream (logger, matcher, ...):
+ *
+ *   [0] filename
+ *   [1] image_buffer
+ *   [2] keypoints_buffer
+ *   [3..] optional (tag, payload) pairs, e.g. ("descriptors", ...)
+ *
+ * Consumers look optional parts up by tag and ignore tags they do not
+ * know, so new parts can be added without breaking older consumers.
+ */
+namespace record {
+
+const size_t FILENAME = 0;
+const size_t IMAGE = 1;
+const size_t KEYPOINTS = 2;
+const size_t CORE_PARTS = 3;
+
+// serialize_descriptors() of the frame's descriptors (Serialization.hpp)
+const std::string TAG_DESCRIPTORS = "descriptors";
+
+// serialize_motion() of the motion since the previous frame of the same
+// source (extractor --motion)
+const std::string TAG_MOTION = "motion";
+
+// serialize_quality() of the frame's quality measures (extractor --quality)
+const std::string TAG_QUALITY = "quality";
+
+// Detectors after the first (extractor --detectors=sift,orb): the first
+// one fills the core keypoints part and TAG_DESCRIPTORS, each further one
+// adds "keypoints:<name>" (serialize_keypoints) and, with descriptors
+// enabled, "descriptors:<name>". Further pyramid levels (--levels=0,2)
+// add "keypoints:<name>@<level>" for every detector, in that level's
+// pixel coordinates
+const std::string TAG_KEYPOINTS_PREFIX = "keypoints:";
+const std::string TAG_DESCRIPTORS_PREFIX = "descriptors:";
+
+/**
+ * @brief True if the record has the three core parts plus whole tag pairs.
+ */
+bool is_valid(const RecordView& parts);
+
+/**
+ * @brief Payload of the optional part tagged `tag`, or nullptr if absent.
+ */
+const PartView* find_part(const RecordView& parts, const std::string& tag);
+
+std::string filename(const RecordView& parts);
+
+} // namespace record
+
+/**
+ * @brief Everything received for one ZMQ message: the owned parts and the
+ * records they contain.
+ *
+ * A message is either a multipart record, one contiguous frame (Frame.hpp)
+ * or a batch of records (Batch.hpp). The views in `records` point into
+ * `messages` and stay valid as long as this object is not modified.
+ */
+struct ReceivedRecords {
+	std::vector<zmq::message_t> messages;
+	std::vector<RecordView> records;
+	bool batched = false;
+};
+
+/**
+ * @brief Reads the rest of a message whose first part is `first` and
+ * splits it into records.
+ *
+ * The remaining parts of a multipart message are always available once
+ * its first part has arrived, so this never blocks for long.
+ *
+ * @throws std::runtime_error if a frame or batch is malformed.
+ */
+ReceivedRecords read_records(zmq::socket_t& socket, zmq::message_t&& first);
+
+#endif // RECORD_HPP
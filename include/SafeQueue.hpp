@@ -3,22 +3,34 @@
 
 #include <queue>
 #include <mutex>
+#include <chrono>
+#include <functional>
 #include <condition_variable>
 
 template <typename T>
 class SafeQueue {
 private:
 	std::queue<T> queue_;
-	std::mutex mutex_;
+	mutable std::mutex mutex_;
 	std::condition_variable cond_;
+	std::function<void()> on_push_;
 
 public:
+	// Optional hook run after every push, e.g. to wake an EventLoop through
+	// an EventFd. Set it before any producer starts.
+	void set_on_push(std::function<void()> hook) {
+		on_push_ = std::move(hook);
+	}
+
 	void push(T value) {
 		{
 			std::lock_guard<std::mutex> lock(mutex_);
 			queue_.push(std::move(value));
 		}
 		cond_.notify_one(); // wake a waiting thread
+		if (on_push_) {
+			on_push_();
+		}
 	}
 
 	// Blocks until an item is available
@@ -30,7 +42,37 @@ public:
 		queue_.pop();
 		return true;
 	}
+
+	// Returns false immediately if the queue is empty
+	bool try_pop(T& value) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (queue_.empty()) {
+			return false;
+		}
+
+		value = std::move(queue_.front());
+		queue_.pop();
+		return true;
+	}
+
+	// Blocks for at most `timeout`; returns false if nothing arrived
+	template <typename Rep, typename Period>
+	bool pop_for(T& value, std::chrono::duration<Rep, Period> timeout) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!cond_.wait_for(lock, timeout, [this]{ return !queue_.empty(); })) {
+			return false;
+		}
+
+		value = std::move(queue_.front());
+		queue_.pop();
+		return true;
+	}
+
+	// Snapshot of the current backlog (may be stale by the time it is used)
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return queue_.size();
+	}
 };
 
 #endif // SAFE_QUEUE_HPP
-
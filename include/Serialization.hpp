@@ -1,8 +1,10 @@
 #ifndef SERIALIZATION_HPP
 #define SERIALIZATION_HPP
 
+#include <cstdint>
 #include <vector>
 #include <opencv2/core.hpp> // For cv::KeyPoint
+#include "KeypointSet.hpp"
 
 /**
  * @brief Serializes a vector of cv::KeyPoint into a flat binary buffer.
@@ -24,6 +26,11 @@
  */
 std::vector<char> serialize_keypoints(const std::vector<cv::KeyPoint>& keypoints);
 
+/**
+ * @brief Serializes a KeypointSet in the same format (class_id -1).
+ */
+std::vector<char> serialize_keypoints(const KeypointSet& keypoints);
+
 /**
  * @brief Deserializes a flat binary buffer back into a vector of cv::KeyPoint.
  *
@@ -33,4 +40,89 @@ std::vector<char> serialize_keypoints(const std::vector<cv::KeyPoint>& keypoints
  */
 std::vector<cv::KeyPoint> deserialize_keypoints(const std::vector<char>& data);
 
+/**
+ * @brief Serializes a descriptor matrix (one row per keypoint).
+ *
+ * Format:
+ * - rows (int)
+ * - cols (int)
+ * - type (int, OpenCV type such as CV_32F for SIFT or CV_8U for ORB)
+ * - rows * cols elements, row-major
+ *
+ * @param descriptors The descriptors to serialize; may be empty.
+ * @return A std::vector<char> containing the serialized data.
+ */
+std::vector<char> serialize_descriptors(const cv::Mat& descriptors);
+
+/**
+ * @brief Deserializes a buffer produced by serialize_descriptors().
+ *
+ * @param data Start of the serialized buffer (need not be aligned).
+ * @param size Size of the buffer in bytes.
+ * @return A newly allocated cv::Mat with the descriptors.
+ * @throws std::runtime_error if the buffer size does not match its header.
+ */
+cv::Mat deserialize_descriptors(const char* data, size_t size);
+
+/**
+ * @brief Camera motion between two frames of the same source, estimated by
+ * the extractor's motion stage (--motion).
+ */
+struct MotionEstimate {
+	enum Model : uint8_t {
+		None = 0,        // first frame of the source, or too few inliers
+		Affine = 1,
+		Homography = 2
+	};
+
+	uint32_t source = 0;              // extractor receiver the frames came from
+	uint64_t sequence = 0;            // this frame's sequence number within the source
+	uint64_t reference_sequence = 0;  // earlier frame the motion is relative to
+	uint8_t model = None;
+	uint32_t matches = 0;             // ratio-test matches fed to RANSAC
+	uint32_t inliers = 0;             // matches consistent with `matrix`
+	double matrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1}; // row-major 3x3, reference -> this frame
+};
+
+/**
+ * @brief Serializes a MotionEstimate.
+ *
+ * Format: source (uint32), sequence (uint64), reference_sequence (uint64),
+ * model (uint8), matches (uint32), inliers (uint32), matrix (9 doubles),
+ * packed without padding.
+ */
+std::vector<char> serialize_motion(const MotionEstimate& motion);
+
+/**
+ * @brief Deserializes a buffer produced by serialize_motion().
+ * @throws std::runtime_error if the buffer size is invalid.
+ */
+MotionEstimate deserialize_motion(const char* data, size_t size);
+
+/**
+ * @brief Cheap image quality measures taken by the extractor's quality gate
+ * (--quality) before detection.
+ */
+struct FrameQuality {
+	float sharpness = 0;       // variance of the Laplacian of the downsampled gray frame
+	float brightness = 0;      // mean gray level, 0-255
+	float dark_fraction = 0;   // share of nearly black pixels
+	float bright_fraction = 0; // share of nearly white pixels
+	uint8_t passed = 1;        // 0 if a threshold was missed (detection skipped with --quality=skip)
+};
+
+/**
+ * @brief Serializes a FrameQuality.
+ *
+ * Format: sharpness, brightness, dark_fraction, bright_fraction (float
+ * each), passed (uint8), packed without padding.
+ */
+std::vector<char> serialize_quality(const FrameQuality& quality);
+
+/**
+ * @brief Deserializes a buffer produced by serialize_quality().
+ * @throws std::runtime_error if the buffer size is invalid.
+ */
+FrameQuality deserialize_quality(const char* data, size_t size);
+
 #endif // SERIALIZATION_HPP
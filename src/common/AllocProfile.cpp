@@ -0,0 +1,233 @@
+#include "AllocProfile.hpp"
+#include <cstdlib> // malloc, aligned_alloc, free
+#include <new>
+#include <sstream>
+
+namespace alloc_profile {
+
+namespace {
+
+// Plain ints, lock-free, so toggle() may run in a signal handler
+std::atomic<int> g_enabled{0};
+
+// Trivially constructible and destructible: safe to touch from operator
+// new on any thread, at any time, without running constructors
+thread_local Stats t_stats;
+
+// Bucket totals of the stages, for size_histogram()
+std::atomic<uint64_t> g_sizes[SIZE_BUCKETS];
+
+int bucket_of(size_t size) {
+	int bucket = 0;
+	size_t limit = 16;
+	while (size > limit && bucket < SIZE_BUCKETS - 1) {
+		limit <<= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void record_allocation(size_t size) {
+	if (g_enabled.load(std::memory_order_relaxed)) {
+		++t_stats.allocations;
+		t_stats.bytes += size;
+		++t_stats.sizes[bucket_of(size)];
+	}
+}
+
+void record_free(void* pointer) {
+	if (pointer && g_enabled.load(std::memory_order_relaxed)) {
+		++t_stats.frees;
+	}
+}
+
+void* allocate(size_t size, size_t alignment) {
+	record_allocation(size);
+	if (size == 0) {
+		size = 1;
+	}
+	while (true) {
+		void* pointer = alignment > alignof(std::max_align_t)
+			? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+			: std::malloc(size);
+		if (pointer) {
+			return pointer;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void* allocate_nothrow(size_t size, size_t alignment) noexcept {
+	try {
+		return allocate(size, alignment);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void release(void* pointer) noexcept {
+	record_free(pointer);
+	std::free(pointer);
+}
+
+} // namespace
+
+Stats Stats::operator-(const Stats& earlier) const {
+	Stats difference;
+	difference.allocations = allocations - earlier.allocations;
+	difference.bytes = bytes - earlier.bytes;
+	difference.frees = frees - earlier.frees;
+	for (int i = 0; i < SIZE_BUCKETS; ++i) {
+		difference.sizes[i] = sizes[i] - earlier.sizes[i];
+	}
+	return difference;
+}
+
+void set_enabled(bool enabled) {
+	g_enabled.store(enabled ? 1 : 0, std::memory_order_relaxed);
+}
+
+bool enabled() {
+	return g_enabled.load(std::memory_order_relaxed) != 0;
+}
+
+void toggle() {
+	g_enabled.fetch_xor(1, std::memory_order_relaxed);
+}
+
+Stats thread_stats() {
+	return t_stats;
+}
+
+size_t bucket_limit(int i) {
+	return i < SIZE_BUCKETS - 1 ? size_t(16) << i : 0;
+}
+
+std::string size_histogram() {
+	std::ostringstream out;
+	for (int i = 0; i < SIZE_BUCKETS; ++i) {
+		uint64_t count = g_sizes[i].load(std::memory_order_relaxed);
+		if (count == 0) {
+			continue;
+		}
+		if (out.tellp() > 0) {
+			out << ' ';
+		}
+		size_t limit = i < SIZE_BUCKETS - 1 ? bucket_limit(i) : bucket_limit(i - 1);
+		const char* unit = "";
+		if (limit >= (1 << 20)) {
+			limit >>= 20;
+			unit = "M";
+		} else if (limit >= (1 << 10)) {
+			limit >>= 10;
+			unit = "K";
+		}
+		out << (i < SIZE_BUCKETS - 1 ? "<=" : ">") << limit << unit << ':' << count;
+	}
+	return out.str();
+}
+
+Stage::Stage(const std::string& prefix)
+	: allocations_(Metrics::global().counter(prefix + ".allocations")),
+	  bytes_(Metrics::global().counter(prefix + ".bytes")),
+	  frees_(Metrics::global().counter(prefix + ".frees")) {}
+
+void Stage::add(const Stats& stats) {
+	allocations_.add(stats.allocations);
+	bytes_.add(stats.bytes);
+	frees_.add(stats.frees);
+	for (int i = 0; i < SIZE_BUCKETS; ++i) {
+		if (stats.sizes[i] > 0) {
+			g_sizes[i].fetch_add(stats.sizes[i], std::memory_order_relaxed);
+		}
+	}
+}
+
+} // namespace alloc_profile
+
+// Replacements of the global allocation functions (all of them, so that
+// every new is paired with a matching delete)
+
+void* operator new(std::size_t size) {
+	return alloc_profile::allocate(size, 0);
+}
+
+void* operator new[](std::size_t size) {
+	return alloc_profile::allocate(size, 0);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return alloc_profile::allocate_nothrow(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return alloc_profile::allocate_nothrow(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return alloc_profile::allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return alloc_profile::allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return alloc_profile::allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return alloc_profile::allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+	alloc_profile::release(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+	alloc_profile::release(pointer);
+}
@@ -0,0 +1,115 @@
+#include "Batch.hpp"
+#include <stdexcept>
+#include <limits>
+#include <cstring> // memcpy
+
+namespace {
+
+void append_u32(std::vector<char>& buffer, uint32_t value) {
+	size_t offset = buffer.size();
+	buffer.resize(offset + sizeof(uint32_t));
+	std::memcpy(buffer.data() + offset, &value, sizeof(uint32_t));
+}
+
+uint32_t read_u32(const char*& ptr, const char* end) {
+	if (static_cast<size_t>(end - ptr) < sizeof(uint32_t)) {
+		throw std::runtime_error("Truncated batch header.");
+	}
+	uint32_t value;
+	std::memcpy(&value, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	return value;
+}
+
+} // namespace
+
+BatchWriter::BatchWriter() : record_count_(0) {
+	append_u32(buffer_, BATCH_MAGIC);
+	append_u32(buffer_, 0); // record count, patched in finish()
+}
+
+void BatchWriter::add(const RecordView& parts) {
+	size_t payload = 0;
+	for (const auto& part : parts) {
+		if (part.size > std::numeric_limits<uint32_t>::max()) {
+			throw std::length_error("Message part too large for a batch.");
+		}
+		payload += part.size;
+	}
+	buffer_.reserve(buffer_.size() + (parts.size() + 1) * sizeof(uint32_t) + payload);
+
+	append_u32(buffer_, static_cast<uint32_t>(parts.size()));
+	for (const auto& part : parts) {
+		append_u32(buffer_, static_cast<uint32_t>(part.size));
+	}
+	for (const auto& part : parts) {
+		buffer_.insert(buffer_.end(), part.data, part.data + part.size);
+	}
+	++record_count_;
+}
+
+std::vector<char> BatchWriter::finish() {
+	std::memcpy(buffer_.data() + sizeof(uint32_t), &record_count_, sizeof(uint32_t));
+
+	std::vector<char> out;
+	out.swap(buffer_);
+
+	record_count_ = 0;
+	append_u32(buffer_, BATCH_MAGIC);
+	append_u32(buffer_, 0);
+	return out;
+}
+
+bool is_batch(const void* data, size_t size) {
+	if (size < 2 * sizeof(uint32_t)) {
+		return false;
+	}
+	uint32_t magic;
+	std::memcpy(&magic, data, sizeof(uint32_t));
+	return magic == BATCH_MAGIC;
+}
+
+std::vector<RecordView> unpack_batch(const void* data, size_t size) {
+	if (!is_batch(data, size)) {
+		throw std::runtime_error("Buffer is not a batch.");
+	}
+
+	const char* ptr = static_cast<const char*>(data) + sizeof(uint32_t);
+	const char* end = static_cast<const char*>(data) + size;
+
+	uint32_t record_count = read_u32(ptr, end);
+	if (record_count > static_cast<size_t>(end - ptr) / sizeof(uint32_t)) {
+		throw std::runtime_error("Invalid batch record count.");
+	}
+
+	std::vector<RecordView> records;
+	records.reserve(record_count);
+
+	for (uint32_t r = 0; r < record_count; ++r) {
+		uint32_t part_count = read_u32(ptr, end);
+		if (part_count > static_cast<size_t>(end - ptr) / sizeof(uint32_t)) {
+			throw std::runtime_error("Invalid batch part count.");
+		}
+
+		std::vector<uint32_t> sizes(part_count);
+		for (uint32_t p = 0; p < part_count; ++p) {
+			sizes[p] = read_u32(ptr, end);
+		}
+
+		RecordView record;
+		record.reserve(part_count);
+		for (uint32_t p = 0; p < part_count; ++p) {
+			if (static_cast<size_t>(end - ptr) < sizes[p]) {
+				throw std::runtime_error("Truncated batch payload.");
+			}
+			record.push_back(PartView{ptr, sizes[p]});
+			ptr += sizes[p];
+		}
+		records.push_back(std::move(record));
+	}
+
+	if (ptr != end) {
+		throw std::runtime_error("Trailing bytes after batch.");
+	}
+	return records;
+}
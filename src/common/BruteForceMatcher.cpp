@@ -0,0 +1,151 @@
+#include "BruteForceMatcher.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Below this many distance computations threads cost more than they save
+const size_t MIN_PAIRS_PER_THREAD = 1 << 16;
+
+struct Neighbor {
+	float distance; // squared for L2
+	int train;
+};
+
+// Inserts into a list of the k smallest distances, kept sorted
+inline void offer(Neighbor* best, int k, float distance, int train) {
+	if (distance >= best[k - 1].distance) {
+		return;
+	}
+	int i = k - 1;
+	while (i > 0 && best[i - 1].distance > distance) {
+		best[i] = best[i - 1];
+		--i;
+	}
+	best[i] = Neighbor{distance, train};
+}
+
+// Compares query rows [q0, q1) against every train row, block by block
+template <typename Distance>
+void match_rows(const cv::Mat& queries, const cv::Mat& train, int q0, int q1, int k,
+				int train_block, Distance distance, Neighbor* best) {
+	for (int t0 = 0; t0 < train.rows; t0 += train_block) {
+		int t1 = std::min(t0 + train_block, train.rows);
+		for (int q = q0; q < q1; ++q) {
+			const uchar* query = queries.ptr(q);
+			Neighbor* query_best = best + static_cast<size_t>(q) * k;
+			for (int t = t0; t < t1; ++t) {
+				offer(query_best, k, distance(query, train.ptr(t)), t);
+			}
+		}
+	}
+}
+
+} // namespace
+
+BruteForceMatcher::BruteForceMatcher(const Params& params)
+	: params_(params), kernels_(distance_kernels(params.simd)) {
+	params_.query_block = std::max(1, params_.query_block);
+	params_.train_block = std::max(1, params_.train_block);
+	if (params_.threads == 0) {
+		params_.threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+void BruteForceMatcher::knn_match(const cv::Mat& queries, const cv::Mat& train, int k,
+								  std::vector<std::vector<cv::DMatch>>& matches) const {
+	matches.clear();
+	if (queries.empty()) {
+		return;
+	}
+	matches.resize(static_cast<size_t>(queries.rows));
+	if (train.empty() || k <= 0) {
+		return;
+	}
+
+	int expected_type = params_.norm == Norm::L2 ? CV_32F : CV_8U;
+	if (queries.type() != expected_type || train.type() != expected_type) {
+		throw std::invalid_argument(params_.norm == Norm::L2
+			? "L2 matching needs CV_32F descriptors."
+			: "Hamming matching needs CV_8U descriptors.");
+	}
+	if (queries.cols != train.cols) {
+		throw std::invalid_argument("Query and train descriptors differ in length.");
+	}
+
+	k = std::min(k, train.rows);
+	std::vector<Neighbor> best(static_cast<size_t>(queries.rows) * k, Neighbor{FLT_MAX, -1});
+
+	size_t cols = static_cast<size_t>(queries.cols);
+	L2Kernel l2 = kernels_.l2_squared;
+	HammingKernel hamming = kernels_.hamming;
+
+	int block_count = (queries.rows + params_.query_block - 1) / params_.query_block;
+	std::atomic<int> next_block{0};
+	auto work = [&] {
+		for (int b = next_block++; b < block_count; b = next_block++) {
+			int q0 = b * params_.query_block;
+			int q1 = std::min(q0 + params_.query_block, queries.rows);
+			if (params_.norm == Norm::L2) {
+				match_rows(queries, train, q0, q1, k, params_.train_block,
+					[l2, cols](const uchar* a, const uchar* b) {
+						return l2(reinterpret_cast<const float*>(a),
+								  reinterpret_cast<const float*>(b), cols);
+					}, best.data());
+			} else {
+				match_rows(queries, train, q0, q1, k, params_.train_block,
+					[hamming, cols](const uchar* a, const uchar* b) {
+						return static_cast<float>(hamming(a, b, cols));
+					}, best.data());
+			}
+		}
+	};
+
+	// Split across threads only when each gets a worthwhile share; the
+	// calling thread takes part
+	size_t pairs = static_cast<size_t>(queries.rows) * static_cast<size_t>(train.rows);
+	size_t threads = std::min({params_.threads, static_cast<size_t>(block_count),
+							   std::max<size_t>(1, pairs / MIN_PAIRS_PER_THREAD)});
+	std::vector<std::thread> helpers;
+	for (size_t i = 1; i < threads; ++i) {
+		helpers.emplace_back(work);
+	}
+	work();
+	for (auto& helper : helpers) {
+		helper.join();
+	}
+
+	for (int q = 0; q < queries.rows; ++q) {
+		std::vector<cv::DMatch>& row_matches = matches[q];
+		row_matches.reserve(static_cast<size_t>(k));
+		for (int j = 0; j < k; ++j) {
+			const Neighbor& neighbor = best[static_cast<size_t>(q) * k + j];
+			if (neighbor.train < 0) {
+				break;
+			}
+			float distance = params_.norm == Norm::L2 ? std::sqrt(neighbor.distance)
+													  : neighbor.distance;
+			row_matches.emplace_back(q, neighbor.train, distance);
+		}
+	}
+}
+
+std::vector<cv::DMatch> BruteForceMatcher::ratio_match(const cv::Mat& queries,
+													   const cv::Mat& train,
+													   float ratio) const {
+	std::vector<std::vector<cv::DMatch>> knn;
+	knn_match(queries, train, 2, knn);
+
+	std::vector<cv::DMatch> good;
+	for (const auto& row_matches : knn) {
+		if (row_matches.size() == 1
+			|| (row_matches.size() == 2 && row_matches[0].distance < ratio * row_matches[1].distance)) {
+			good.push_back(row_matches[0]);
+		}
+	}
+	return good;
+}
@@ -0,0 +1,199 @@
+#include "Chunk.hpp"
+#include <cstring> // memcpy
+#include <iterator> // prev
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// magic + version + filename_size + transfer_id + total_size + offset
+const size_t CHUNK_HEADER_SIZE = sizeof(uint32_t) + 2 * sizeof(uint16_t) + 3 * sizeof(uint64_t);
+
+} // namespace
+
+size_t chunked_size(const std::string& filename, size_t payload_size) {
+	return CHUNK_HEADER_SIZE + filename.size() + payload_size;
+}
+
+void encode_chunk_into(uint64_t transfer_id, uint64_t total_size, uint64_t offset,
+					   const std::string& filename, const char* payload, size_t payload_size,
+					   void* out) {
+	if (filename.size() > std::numeric_limits<uint16_t>::max()) {
+		throw std::length_error("Filename too long for a chunk header.");
+	}
+	char* p = static_cast<char*>(out);
+	uint16_t filename_size = static_cast<uint16_t>(filename.size());
+
+	std::memcpy(p, &CHUNK_MAGIC, sizeof(uint32_t));
+	p += sizeof(uint32_t);
+	std::memcpy(p, &CHUNK_VERSION, sizeof(uint16_t));
+	p += sizeof(uint16_t);
+	std::memcpy(p, &filename_size, sizeof(uint16_t));
+	p += sizeof(uint16_t);
+	std::memcpy(p, &transfer_id, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+	std::memcpy(p, &total_size, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+	std::memcpy(p, &offset, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+
+	std::memcpy(p, filename.data(), filename.size());
+	p += filename.size();
+	if (payload_size > 0) {
+		std::memcpy(p, payload, payload_size);
+	}
+}
+
+bool is_chunk(const void* data, size_t size) {
+	if (size < CHUNK_HEADER_SIZE) {
+		return false;
+	}
+	uint32_t magic;
+	std::memcpy(&magic, data, sizeof(uint32_t));
+	return magic == CHUNK_MAGIC;
+}
+
+ChunkView decode_chunk(const void* data, size_t size) {
+	if (!is_chunk(data, size)) {
+		throw std::runtime_error("Buffer is not a chunk.");
+	}
+
+	const char* p = static_cast<const char*>(data) + sizeof(uint32_t);
+	uint16_t version;
+	uint16_t filename_size;
+	ChunkView chunk;
+	std::memcpy(&version, p, sizeof(uint16_t));
+	p += sizeof(uint16_t);
+	std::memcpy(&filename_size, p, sizeof(uint16_t));
+	p += sizeof(uint16_t);
+	std::memcpy(&chunk.transfer_id, p, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+	std::memcpy(&chunk.total_size, p, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+	std::memcpy(&chunk.offset, p, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+
+	if (version != CHUNK_VERSION) {
+		throw std::runtime_error("Unsupported chunk version " + std::to_string(version) + ".");
+	}
+	if (filename_size > size - CHUNK_HEADER_SIZE) {
+		throw std::runtime_error("Truncated chunk header.");
+	}
+	chunk.filename = PartView{p, filename_size};
+	chunk.payload = PartView{p + filename_size, size - CHUNK_HEADER_SIZE - filename_size};
+
+	if (chunk.offset > chunk.total_size || chunk.payload.size > chunk.total_size - chunk.offset) {
+		throw std::runtime_error("Chunk out of bounds of its image.");
+	}
+	return chunk;
+}
+
+ChunkAssembler::ChunkAssembler(size_t max_transfers, uint64_t max_image_bytes,
+							   std::chrono::milliseconds timeout)
+	: max_transfers_(max_transfers == 0 ? 1 : max_transfers),
+	  max_image_bytes_(max_image_bytes), timeout_(timeout) {}
+
+void ChunkAssembler::expire(Clock::time_point now) {
+	for (auto it = transfers_.begin(); it != transfers_.end();) {
+		if (now - it->second.started > timeout_) {
+			it = transfers_.erase(it);
+			++dropped_;
+		} else {
+			++it;
+		}
+	}
+}
+
+bool ChunkAssembler::overlaps(const Transfer& transfer, uint64_t offset, uint64_t size) {
+	if (size == 0) {
+		return false;
+	}
+	if (offset < transfer.contiguous) {
+		return true;
+	}
+	// The chunk past the gap starting at or after `offset`, and the one before it
+	auto next = transfer.ahead.lower_bound(offset);
+	if (next != transfer.ahead.end() && next->first < offset + size) {
+		return true;
+	}
+	if (next != transfer.ahead.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second > offset) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ChunkAssembler::add(const ChunkView& chunk, std::string& filename, zmq::message_t& image) {
+	Clock::time_point now = Clock::now();
+	expire(now);
+
+	auto it = transfers_.find(chunk.transfer_id);
+	if (it == transfers_.end()) {
+		if (chunk.total_size > max_image_bytes_) {
+			++dropped_;
+			throw std::runtime_error("Chunked image of " + std::to_string(chunk.total_size)
+									 + " bytes exceeds the limit.");
+		}
+		// Make room by giving up the oldest transfer
+		while (transfers_.size() >= max_transfers_) {
+			auto oldest = transfers_.begin();
+			for (auto t = transfers_.begin(); t != transfers_.end(); ++t) {
+				if (t->second.started < oldest->second.started) {
+					oldest = t;
+				}
+			}
+			transfers_.erase(oldest);
+			++dropped_;
+		}
+		Transfer transfer;
+		transfer.filename.assign(chunk.filename.data, chunk.filename.size);
+		transfer.buffer.rebuild(static_cast<size_t>(chunk.total_size));
+		transfer.started = now;
+		it = transfers_.emplace(chunk.transfer_id, std::move(transfer)).first;
+	}
+
+	Transfer& transfer = it->second;
+	if (transfer.buffer.size() != chunk.total_size
+		|| transfer.filename.compare(0, std::string::npos, chunk.filename.data, chunk.filename.size) != 0
+		|| overlaps(transfer, chunk.offset, chunk.payload.size)) {
+		transfers_.erase(it);
+		++dropped_;
+		throw std::runtime_error("Chunk does not match its transfer.");
+	}
+
+	if (chunk.payload.size > 0) {
+		std::memcpy(static_cast<char*>(transfer.buffer.data()) + chunk.offset,
+					chunk.payload.data, chunk.payload.size);
+		if (chunk.offset == transfer.contiguous) {
+			transfer.contiguous += chunk.payload.size;
+			for (auto next = transfer.ahead.begin();
+				 next != transfer.ahead.end() && next->first == transfer.contiguous;
+				 next = transfer.ahead.erase(next)) {
+				transfer.contiguous += next->second;
+			}
+		} else {
+			transfer.ahead[chunk.offset] = chunk.payload.size;
+		}
+	}
+	// Complete once every byte is covered, not when enough bytes came in
+	if (transfer.contiguous < chunk.total_size) {
+		return false;
+	}
+
+	filename = std::move(transfer.filename);
+	image = std::move(transfer.buffer);
+	transfers_.erase(it);
+	return true;
+}
+
+bool ChunkAssembler::prefix(uint64_t transfer_id, const char*& data, uint64_t& contiguous) const {
+	auto it = transfers_.find(transfer_id);
+	if (it == transfers_.end()) {
+		return false;
+	}
+	data = static_cast<const char*>(it->second.buffer.data());
+	contiguous = it->second.contiguous;
+	return true;
+}
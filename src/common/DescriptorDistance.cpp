@@ -0,0 +1,186 @@
+#include "DescriptorDistance.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DIS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+float l2_squared_scalar(const float* a, const float* b, size_t n) {
+	float sum = 0.0f;
+	for (size_t i = 0; i < n; ++i) {
+		float d = a[i] - b[i];
+		sum += d * d;
+	}
+	return sum;
+}
+
+uint32_t hamming_scalar(const uint8_t* a, const uint8_t* b, size_t n) {
+	uint32_t bits = 0;
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t x;
+		uint64_t y;
+		std::memcpy(&x, a + i, 8);
+		std::memcpy(&y, b + i, 8);
+		bits += static_cast<uint32_t>(__builtin_popcountll(x ^ y));
+	}
+	for (; i < n; ++i) {
+		bits += static_cast<uint32_t>(__builtin_popcount(a[i] ^ b[i]));
+	}
+	return bits;
+}
+
+#ifdef DIS_X86_SIMD
+
+__attribute__((target("avx2,fma")))
+float l2_squared_avx2(const float* a, const float* b, size_t n) {
+	// Two accumulators hide the FMA latency
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+		sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+		sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+	}
+	for (; i + 8 <= n; i += 8) {
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		sum0 = _mm256_fmadd_ps(d, d, sum0);
+	}
+
+	__m256 sum = _mm256_add_ps(sum0, sum1);
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_movehdup_ps(half));
+	return _mm_cvtss_f32(half) + l2_squared_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+uint32_t hamming_avx2(const uint8_t* a, const uint8_t* b, size_t n) {
+	// Per-nibble popcount through a shuffle lookup, summed with SAD
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i total = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_xor_si256(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+		__m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+		__m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(low, high),
+														_mm256_setzero_si256()));
+	}
+
+	uint64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+	uint32_t bits = static_cast<uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+	return bits + hamming_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+float l2_squared_avx512(const float* a, const float* b, size_t n) {
+	__m512 sum0 = _mm512_setzero_ps();
+	__m512 sum1 = _mm512_setzero_ps();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+		__m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+		sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+		sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+	}
+	for (; i < n; i += 16) {
+		// Masked loads cover the tail without reading past the end
+		__mmask16 mask = n - i >= 16 ? static_cast<__mmask16>(0xffff)
+									 : static_cast<__mmask16>((1u << (n - i)) - 1);
+		__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+		sum0 = _mm512_fmadd_ps(d, d, sum0);
+	}
+	// Spilled rather than _mm512_reduce_add_ps, which trips GCC 12's
+	// -Wuninitialized
+	alignas(64) float lanes[16];
+	_mm512_store_ps(lanes, _mm512_add_ps(sum0, sum1));
+	float sum = 0.0f;
+	for (float lane : lanes) {
+		sum += lane;
+	}
+	return sum;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq")))
+uint32_t hamming_avx512(const uint8_t* a, const uint8_t* b, size_t n) {
+	__m512i total = _mm512_setzero_si512();
+	for (size_t i = 0; i < n; i += 64) {
+		__mmask64 mask = n - i >= 64 ? ~static_cast<__mmask64>(0)
+									 : (static_cast<__mmask64>(1) << (n - i)) - 1;
+		__m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, a + i),
+									 _mm512_maskz_loadu_epi8(mask, b + i));
+		total = _mm512_add_epi64(total, _mm512_popcnt_epi64(x));
+	}
+	alignas(64) uint64_t lanes[8];
+	_mm512_store_si512(lanes, total);
+	uint64_t bits = 0;
+	for (uint64_t lane : lanes) {
+		bits += lane;
+	}
+	return static_cast<uint32_t>(bits);
+}
+
+#endif // DIS_X86_SIMD
+
+} // namespace
+
+SimdLevel detect_simd_level() {
+#ifdef DIS_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+		return SimdLevel::Avx512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return SimdLevel::Avx2;
+	}
+#endif
+	return SimdLevel::Scalar;
+}
+
+const char* simd_level_name(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::Avx512:
+		return "avx512";
+	case SimdLevel::Avx2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+DistanceKernels distance_kernels(SimdLevel level) {
+	SimdLevel supported = detect_simd_level();
+	if (static_cast<int>(level) > static_cast<int>(supported)) {
+		level = supported;
+	}
+
+#ifdef DIS_X86_SIMD
+	if (level == SimdLevel::Avx512) {
+		// VPOPCNTDQ came later than AVX-512 F/BW (Ice Lake, Zen 4)
+		HammingKernel hamming = __builtin_cpu_supports("avx512vpopcntdq") ? hamming_avx512
+																		  : hamming_avx2;
+		return DistanceKernels{level, l2_squared_avx512, hamming};
+	}
+	if (level == SimdLevel::Avx2) {
+		return DistanceKernels{level, l2_squared_avx2, hamming_avx2};
+	}
+#endif
+	return DistanceKernels{SimdLevel::Scalar, l2_squared_scalar, hamming_scalar};
+}
+
+const DistanceKernels& best_distance_kernels() {
+	static const DistanceKernels kernels = distance_kernels(detect_simd_level());
+	return kernels;
+}
@@ -0,0 +1,216 @@
+#include "DescriptorStore.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t align_up(uint64_t offset) {
+	return (offset + STORE_ALIGNMENT - 1) & ~static_cast<uint64_t>(STORE_ALIGNMENT - 1);
+}
+
+int open_file(const std::string& path, int flags) {
+	int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "open " + path);
+	}
+	return fd;
+}
+
+uint64_t file_size(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		throw std::system_error(errno, std::generic_category(), "fstat");
+	}
+	return static_cast<uint64_t>(st.st_size);
+}
+
+void write_at(int fd, const void* data, size_t size, uint64_t offset) {
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0) {
+		ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "pwrite");
+		}
+		bytes += written;
+		size -= static_cast<size_t>(written);
+		offset += static_cast<uint64_t>(written);
+	}
+}
+
+// Maps a whole file read-only; returns nullptr for an empty file
+const char* map_file(const std::string& path, size_t& size) {
+	int fd = open_file(path, O_RDONLY);
+	size = static_cast<size_t>(file_size(fd));
+	void* mapping = nullptr;
+	if (size > 0) {
+		mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	int map_errno = errno;
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throw std::system_error(map_errno, std::generic_category(), "mmap " + path);
+	}
+	return static_cast<const char*>(mapping);
+}
+
+void check_header(const StoreHeader& header) {
+	if (header.magic != STORE_MAGIC || header.version != STORE_VERSION) {
+		throw std::runtime_error("Not a descriptor store (bad magic or version).");
+	}
+	if ((header.type != CV_8UC1 && header.type != CV_32FC1) || header.cols == 0
+		|| header.cols > INT_MAX) {
+		throw std::runtime_error("Descriptor store header has an invalid type or length.");
+	}
+}
+
+} // namespace
+
+// ------------------ Writer ------------------
+
+DescriptorStoreWriter::DescriptorStoreWriter(const std::string& path)
+	: data_fd_(open_file(path, O_RDWR | O_CREAT)),
+	  index_fd_(-1),
+	  header_{} {
+	try {
+		index_fd_ = open_file(path + ".idx", O_RDWR | O_CREAT);
+		data_size_ = file_size(data_fd_);
+		index_size_ = file_size(index_fd_);
+
+		if (data_size_ >= sizeof(StoreHeader)) {
+			if (pread(data_fd_, &header_, sizeof(header_), 0) != sizeof(header_)) {
+				throw std::system_error(errno, std::generic_category(), "pread");
+			}
+			check_header(header_);
+		} else if (data_size_ != 0 || index_size_ != 0) {
+			throw std::runtime_error("Descriptor store " + path + " is truncated.");
+		}
+
+		// Drop a table entry cut short by a crash
+		uint64_t whole = index_size_ - index_size_ % sizeof(StoreEntry);
+		if (whole != index_size_) {
+			if (ftruncate(index_fd_, static_cast<off_t>(whole)) != 0) {
+				throw std::system_error(errno, std::generic_category(), "ftruncate");
+			}
+			index_size_ = whole;
+		}
+	} catch (...) {
+		close(data_fd_);
+		if (index_fd_ >= 0) {
+			close(index_fd_);
+		}
+		throw;
+	}
+}
+
+DescriptorStoreWriter::~DescriptorStoreWriter() {
+	close(data_fd_);
+	close(index_fd_);
+}
+
+void DescriptorStoreWriter::append(int64_t image_id, const std::string& filename,
+								   const cv::Mat& descriptors) {
+	if (descriptors.empty()) {
+		return;
+	}
+
+	if (descriptors.type() != CV_8UC1 && descriptors.type() != CV_32FC1) {
+		throw std::invalid_argument("Descriptor stores hold CV_8UC1 or CV_32FC1 descriptors.");
+	}
+
+	if (header_.magic == 0) {
+		header_.magic = STORE_MAGIC;
+		header_.version = STORE_VERSION;
+		header_.cols = static_cast<uint32_t>(descriptors.cols);
+		header_.type = static_cast<uint32_t>(descriptors.type());
+		write_at(data_fd_, &header_, sizeof(header_), 0);
+		data_size_ = sizeof(header_);
+	} else if (descriptors.cols != static_cast<int>(header_.cols)
+			   || descriptors.type() != static_cast<int>(header_.type)) {
+		throw std::invalid_argument("Descriptors do not match the store's length or type.");
+	}
+
+	cv::Mat rows = descriptors.isContinuous() ? descriptors : descriptors.clone();
+	size_t row_bytes = static_cast<size_t>(rows.cols) * rows.elemSize();
+
+	StoreEntry entry{};
+	entry.image_id = image_id;
+	entry.name_offset = data_size_;
+	entry.name_size = static_cast<uint32_t>(filename.size());
+	entry.data_offset = align_up(data_size_ + filename.size());
+	entry.rows = static_cast<uint32_t>(rows.rows);
+
+	// Data first, then the entry that makes it visible
+	write_at(data_fd_, filename.data(), filename.size(), entry.name_offset);
+	write_at(data_fd_, rows.ptr(), row_bytes * rows.rows, entry.data_offset);
+	data_size_ = entry.data_offset + row_bytes * rows.rows;
+
+	write_at(index_fd_, &entry, sizeof(entry), index_size_);
+	index_size_ += sizeof(entry);
+}
+
+// ------------------ Reader ------------------
+
+DescriptorStore::DescriptorStore(const std::string& path) {
+	data_ = map_file(path, data_size_);
+	try {
+		entries_ = reinterpret_cast<const StoreEntry*>(map_file(path + ".idx", index_size_));
+		entry_count_ = index_size_ / sizeof(StoreEntry);
+
+		if (data_size_ >= sizeof(StoreHeader)) {
+			std::memcpy(&header_, data_, sizeof(header_));
+			check_header(header_);
+		} else if (entry_count_ != 0) {
+			throw std::runtime_error("Descriptor store " + path + " is truncated.");
+		}
+
+		// Validate the table once so image() can trust it
+		uint64_t row_bytes = static_cast<uint64_t>(header_.cols) * CV_ELEM_SIZE(header_.type);
+		for (size_t i = 0; i < entry_count_; ++i) {
+			const StoreEntry& entry = entries_[i];
+			if (entry.name_offset > data_size_
+				|| entry.name_size > data_size_ - entry.name_offset
+				|| entry.data_offset % STORE_ALIGNMENT != 0
+				|| entry.data_offset > data_size_
+				|| static_cast<uint64_t>(entry.rows) * row_bytes > data_size_ - entry.data_offset) {
+				throw std::runtime_error("Descriptor store " + path + " has an out-of-range entry.");
+			}
+		}
+	} catch (...) {
+		if (data_) {
+			munmap(const_cast<char*>(data_), data_size_);
+		}
+		if (entries_) {
+			munmap(const_cast<StoreEntry*>(entries_), index_size_);
+		}
+		throw;
+	}
+}
+
+DescriptorStore::~DescriptorStore() {
+	if (data_) {
+		munmap(const_cast<char*>(data_), data_size_);
+	}
+	if (entries_) {
+		munmap(const_cast<StoreEntry*>(entries_), index_size_);
+	}
+}
+
+DescriptorStore::Image DescriptorStore::image(size_t i) const {
+	const StoreEntry& entry = entries_[i];
+	// cv::Mat has no const view; the mapping is read-only, so callers must
+	// not write through it
+	char* rows = const_cast<char*>(data_ + entry.data_offset);
+	return Image{entry.image_id,
+				 std::string(data_ + entry.name_offset, entry.name_size),
+				 cv::Mat(static_cast<int>(entry.rows), cols(), type(), rows)};
+}
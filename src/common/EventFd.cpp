@@ -0,0 +1,30 @@
+#include "EventFd.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventFd::EventFd() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+	if (fd_ < 0) {
+		throw std::system_error(errno, std::generic_category(), "eventfd");
+	}
+}
+
+EventFd::~EventFd() {
+	close(fd_);
+}
+
+void EventFd::notify() {
+	uint64_t one = 1;
+	// Only fails if the counter would overflow, in which case the fd is
+	// already readable and the wakeup is not lost
+	ssize_t written = write(fd_, &one, sizeof(one));
+	(void)written;
+}
+
+void EventFd::drain() {
+	uint64_t count;
+	ssize_t got = read(fd_, &count, sizeof(count));
+	(void)got; // EAGAIN just means nothing was pending
+}
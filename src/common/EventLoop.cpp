@@ -0,0 +1,163 @@
+#include "EventLoop.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+EventLoop::EventLoop()
+	: next_handler_id_(1),
+	  next_timer_id_(1),
+	  timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+	  stopped_(false)
+{
+	if (timer_fd_ < 0) {
+		throw std::system_error(errno, std::generic_category(), "timerfd_create");
+	}
+}
+
+EventLoop::~EventLoop() {
+	close(timer_fd_);
+}
+
+void EventLoop::add_socket(zmq::socket_t& socket, Callback on_readable) {
+	handlers_.push_back(Handler{next_handler_id_++, socket.handle(), -1, std::move(on_readable)});
+}
+
+void EventLoop::remove_socket(zmq::socket_t& socket) {
+	void* handle = socket.handle();
+	handlers_.erase(std::remove_if(handlers_.begin(), handlers_.end(),
+								   [handle](const Handler& h) { return h.socket == handle; }),
+					handlers_.end());
+}
+
+void EventLoop::add_fd(int fd, Callback on_readable) {
+	handlers_.push_back(Handler{next_handler_id_++, nullptr, fd, std::move(on_readable)});
+}
+
+void EventLoop::remove_fd(int fd) {
+	handlers_.erase(std::remove_if(handlers_.begin(), handlers_.end(),
+								   [fd](const Handler& h) { return !h.socket && h.fd == fd; }),
+					handlers_.end());
+}
+
+EventLoop::TimerId EventLoop::add_timer(std::chrono::microseconds delay, Callback callback) {
+	TimerId id = next_timer_id_++;
+	timers_[id] = Timer{Clock::now() + delay, std::chrono::microseconds::zero(), std::move(callback)};
+	arm_timerfd();
+	return id;
+}
+
+EventLoop::TimerId EventLoop::add_periodic(std::chrono::microseconds interval, Callback callback) {
+	TimerId id = next_timer_id_++;
+	timers_[id] = Timer{Clock::now() + interval, interval, std::move(callback)};
+	arm_timerfd();
+	return id;
+}
+
+void EventLoop::cancel_timer(TimerId id) {
+	timers_.erase(id);
+	arm_timerfd();
+}
+
+void EventLoop::stop() {
+	stopped_ = true;
+	wakeup_.notify();
+}
+
+void EventLoop::arm_timerfd() {
+	itimerspec spec{};
+	if (!timers_.empty()) {
+		auto next = std::min_element(timers_.begin(), timers_.end(),
+			[](const auto& a, const auto& b) { return a.second.due < b.second.due; });
+
+		auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			next->second.due - Clock::now()).count();
+		// A zero it_value would disarm the timer, so fire "immediately" instead
+		if (delay < 1) {
+			delay = 1;
+		}
+		spec.it_value.tv_sec = delay / 1000000000;
+		spec.it_value.tv_nsec = delay % 1000000000;
+	}
+	timerfd_settime(timer_fd_, 0, &spec, nullptr);
+}
+
+void EventLoop::fire_due_timers() {
+	uint64_t expirations;
+	ssize_t got = read(timer_fd_, &expirations, sizeof(expirations));
+	(void)got;
+
+	auto now = Clock::now();
+	std::vector<TimerId> due;
+	for (const auto& entry : timers_) {
+		if (entry.second.due <= now) {
+			due.push_back(entry.first);
+		}
+	}
+
+	for (TimerId id : due) {
+		auto it = timers_.find(id);
+		if (it == timers_.end()) {
+			continue; // cancelled by an earlier callback
+		}
+
+		// Copy: the callback may cancel its own timer
+		Callback callback = it->second.callback;
+		if (it->second.interval.count() > 0) {
+			it->second.due += it->second.interval;
+			if (it->second.due <= now) {
+				// Fell behind; skip missed ticks rather than firing in a burst
+				it->second.due = now + it->second.interval;
+			}
+		} else {
+			timers_.erase(it);
+		}
+		callback();
+	}
+	arm_timerfd();
+}
+
+void EventLoop::run() {
+	std::vector<zmq_pollitem_t> items;
+	std::vector<uint64_t> ids;
+
+	while (!stopped_) {
+		items.clear();
+		ids.clear();
+		items.push_back(zmq_pollitem_t{nullptr, timer_fd_, ZMQ_POLLIN, 0});
+		items.push_back(zmq_pollitem_t{nullptr, wakeup_.fd(), ZMQ_POLLIN, 0});
+		for (const auto& handler : handlers_) {
+			items.push_back(zmq_pollitem_t{handler.socket, handler.fd, ZMQ_POLLIN, 0});
+			ids.push_back(handler.id);
+		}
+
+		if (zmq_poll(items.data(), static_cast<int>(items.size()), -1) < 0) {
+			if (zmq_errno() == EINTR) {
+				continue;
+			}
+			throw zmq::error_t();
+		}
+
+		if (items[1].revents & ZMQ_POLLIN) {
+			wakeup_.drain();
+		}
+		if (items[0].revents & ZMQ_POLLIN) {
+			fire_due_timers();
+		}
+
+		for (size_t i = 0; i < ids.size() && !stopped_; ++i) {
+			if (!(items[i + 2].revents & ZMQ_POLLIN)) {
+				continue;
+			}
+			auto it = std::find_if(handlers_.begin(), handlers_.end(),
+								   [&](const Handler& h) { return h.id == ids[i]; });
+			if (it == handlers_.end()) {
+				continue; // removed by an earlier callback
+			}
+			// Copy: the callback may add handlers and reallocate handlers_
+			Callback callback = it->callback;
+			callback();
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#include "Frame.hpp"
+#include <stdexcept>
+#include <limits>
+#include <string>
+#include <cstring> // memcpy
+
+namespace {
+
+// magic + version + part_count
+const size_t FRAME_PREFIX_SIZE = sizeof(uint32_t) + 2 * sizeof(uint16_t);
+
+size_t align_up(size_t value) {
+	return (value + FRAME_ALIGNMENT - 1) & ~(FRAME_ALIGNMENT - 1);
+}
+
+size_t header_size(size_t part_count) {
+	return FRAME_PREFIX_SIZE + part_count * 2 * sizeof(uint64_t);
+}
+
+} // namespace
+
+WireFormat parse_wire_format(const std::string& name) {
+	if (name == "multipart") {
+		return WireFormat::Multipart;
+	}
+	if (name == "frame") {
+		return WireFormat::Frame;
+	}
+	throw std::invalid_argument("Unknown wire format '" + name + "' (expected multipart or frame)");
+}
+
+size_t framed_size(const RecordView& parts) {
+	size_t offset = align_up(header_size(parts.size()));
+	for (const auto& part : parts) {
+		offset = align_up(offset + part.size);
+	}
+	return offset;
+}
+
+void encode_frame_into(const RecordView& parts, void* out) {
+	if (parts.size() > std::numeric_limits<uint16_t>::max()) {
+		throw std::length_error("Too many parts for a single frame.");
+	}
+
+	char* base = static_cast<char*>(out);
+	uint16_t part_count = static_cast<uint16_t>(parts.size());
+
+	std::memcpy(base, &FRAME_MAGIC, sizeof(uint32_t));
+	std::memcpy(base + sizeof(uint32_t), &FRAME_VERSION, sizeof(uint16_t));
+	std::memcpy(base + sizeof(uint32_t) + sizeof(uint16_t), &part_count, sizeof(uint16_t));
+
+	char* entry = base + FRAME_PREFIX_SIZE;
+	size_t header_end = header_size(parts.size());
+	size_t offset = align_up(header_end);
+	std::memset(base + header_end, 0, offset - header_end);
+
+	for (const auto& part : parts) {
+		uint64_t part_offset = offset;
+		uint64_t part_size = part.size;
+		std::memcpy(entry, &part_offset, sizeof(uint64_t));
+		std::memcpy(entry + sizeof(uint64_t), &part_size, sizeof(uint64_t));
+		entry += 2 * sizeof(uint64_t);
+
+		if (part.size > 0) {
+			std::memcpy(base + offset, part.data, part.size);
+		}
+		size_t next = align_up(offset + part.size);
+		std::memset(base + offset + part.size, 0, next - offset - part.size);
+		offset = next;
+	}
+}
+
+std::vector<char> encode_frame(const RecordView& parts) {
+	std::vector<char> buffer(framed_size(parts));
+	encode_frame_into(parts, buffer.data());
+	return buffer;
+}
+
+bool is_frame(const void* data, size_t size) {
+	if (size < FRAME_PREFIX_SIZE) {
+		return false;
+	}
+	uint32_t magic;
+	std::memcpy(&magic, data, sizeof(uint32_t));
+	return magic == FRAME_MAGIC;
+}
+
+RecordView decode_frame(const void* data, size_t size) {
+	if (!is_frame(data, size)) {
+		throw std::runtime_error("Buffer is not a frame.");
+	}
+
+	const char* base = static_cast<const char*>(data);
+	uint16_t version;
+	uint16_t part_count;
+	std::memcpy(&version, base + sizeof(uint32_t), sizeof(uint16_t));
+	std::memcpy(&part_count, base + sizeof(uint32_t) + sizeof(uint16_t), sizeof(uint16_t));
+
+	if (version != FRAME_VERSION) {
+		throw std::runtime_error("Unsupported frame version " + std::to_string(version) + ".");
+	}
+	if (header_size(part_count) > size) {
+		throw std::runtime_error("Truncated frame header.");
+	}
+
+	RecordView parts;
+	parts.reserve(part_count);
+
+	const char* entry = base + FRAME_PREFIX_SIZE;
+	for (uint16_t i = 0; i < part_count; ++i) {
+		uint64_t part_offset;
+		uint64_t part_size;
+		std::memcpy(&part_offset, entry, sizeof(uint64_t));
+		std::memcpy(&part_size, entry + sizeof(uint64_t), sizeof(uint64_t));
+		entry += 2 * sizeof(uint64_t);
+
+		if (part_offset > size || part_size > size - part_offset) {
+			throw std::runtime_error("Frame part out of bounds.");
+		}
+		parts.push_back(PartView{base + part_offset, static_cast<size_t>(part_size)});
+	}
+	return parts;
+}
@@ -0,0 +1,340 @@
+#include "ImageCodec.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+namespace {
+
+const char QOI_MAGIC[4] = {'q', 'o', 'i', 'f'};
+const size_t QOI_HEADER_SIZE = 14;
+const uint8_t QOI_PADDING[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+const uint64_t QOI_PIXELS_MAX = 400000000; // guards against hostile headers
+
+const uint8_t QOI_OP_INDEX = 0x00; // 00xxxxxx
+const uint8_t QOI_OP_DIFF = 0x40;  // 01xxxxxx
+const uint8_t QOI_OP_LUMA = 0x80;  // 10xxxxxx
+const uint8_t QOI_OP_RUN = 0xc0;   // 11xxxxxx
+const uint8_t QOI_OP_RGB = 0xfe;
+const uint8_t QOI_OP_RGBA = 0xff;
+const uint8_t QOI_MASK_2 = 0xc0;
+
+struct Rgba {
+	uint8_t r, g, b, a;
+
+	bool operator==(const Rgba& other) const {
+		return r == other.r && g == other.g && b == other.b && a == other.a;
+	}
+};
+
+inline int qoi_hash(const Rgba& px) {
+	return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+}
+
+inline void write_u32_be(uint8_t* out, uint32_t value) {
+	out[0] = static_cast<uint8_t>(value >> 24);
+	out[1] = static_cast<uint8_t>(value >> 16);
+	out[2] = static_cast<uint8_t>(value >> 8);
+	out[3] = static_cast<uint8_t>(value);
+}
+
+inline uint32_t read_u32_be(const uint8_t* in) {
+	return (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | in[3];
+}
+
+} // namespace
+
+ImageCodec parse_image_codec(const std::string& name) {
+	if (name == "keep") return ImageCodec::Keep;
+	if (name == "jpeg" || name == "jpg") return ImageCodec::Jpeg;
+	if (name == "png") return ImageCodec::Png;
+	if (name == "webp") return ImageCodec::Webp;
+	if (name == "jxl") return ImageCodec::Jxl;
+	if (name == "qoi" || name == "fastest") return ImageCodec::Qoi;
+	throw std::invalid_argument("Unknown codec '" + name
+								+ "' (expected keep, jpeg, png, webp, jxl, qoi or fastest)");
+}
+
+const char* image_codec_name(ImageCodec codec) {
+	switch (codec) {
+	case ImageCodec::Keep: return "keep";
+	case ImageCodec::Jpeg: return "jpeg";
+	case ImageCodec::Png: return "png";
+	case ImageCodec::Webp: return "webp";
+	case ImageCodec::Jxl: return "jxl";
+	case ImageCodec::Qoi: return "qoi";
+	}
+	return "unknown";
+}
+
+std::string image_codec_extension(ImageCodec codec) {
+	switch (codec) {
+	case ImageCodec::Keep: return "";
+	case ImageCodec::Jpeg: return ".jpg";
+	case ImageCodec::Png: return ".png";
+	case ImageCodec::Webp: return ".webp";
+	case ImageCodec::Jxl: return ".jxl";
+	case ImageCodec::Qoi: return ".qoi";
+	}
+	return "";
+}
+
+ImageCodec image_codec_for_extension(std::string extension) {
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+				   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension == ".jpg" || extension == ".jpeg") return ImageCodec::Jpeg;
+	if (extension == ".png") return ImageCodec::Png;
+	if (extension == ".webp") return ImageCodec::Webp;
+	if (extension == ".jxl") return ImageCodec::Jxl;
+	if (extension == ".qoi") return ImageCodec::Qoi;
+	return ImageCodec::Keep;
+}
+
+bool image_codec_available(ImageCodec codec) {
+	if (codec == ImageCodec::Keep || codec == ImageCodec::Qoi) {
+		return true;
+	}
+	std::string probe = "probe" + image_codec_extension(codec);
+	return cv::haveImageWriter(probe) && cv::haveImageReader(probe);
+}
+
+bool encode_image(ImageCodec codec, const cv::Mat& image, std::vector<uchar>& buffer, int quality) {
+	if (image.empty() || image.depth() != CV_8U) {
+		return false;
+	}
+	switch (codec) {
+	case ImageCodec::Keep:
+		return false;
+	case ImageCodec::Qoi:
+		if (image.channels() == 1) {
+			cv::Mat bgr;
+			cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+			buffer = qoi_encode(bgr);
+		} else {
+			buffer = qoi_encode(image);
+		}
+		return true;
+	case ImageCodec::Jpeg:
+		return cv::imencode(".jpg", image, buffer, {cv::IMWRITE_JPEG_QUALITY, quality});
+	case ImageCodec::Webp:
+		return image_codec_available(codec)
+			&& cv::imencode(".webp", image, buffer, {cv::IMWRITE_WEBP_QUALITY, quality});
+	case ImageCodec::Jxl:
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 11)
+		return image_codec_available(codec)
+			&& cv::imencode(".jxl", image, buffer, {cv::IMWRITE_JPEGXL_QUALITY, quality});
+#else
+		return false; // JPEG XL arrived in OpenCV 4.11
+#endif
+	case ImageCodec::Png:
+		return cv::imencode(".png", image, buffer);
+	}
+	return false;
+}
+
+bool decode_image(const char* data, size_t size, int flags, cv::Mat& image) {
+	if (!is_qoi(data, size)) {
+		cv::Mat raw(1, static_cast<int>(size), CV_8UC1, const_cast<char*>(data));
+		cv::imdecode(raw, flags, &image);
+		return !image.empty();
+	}
+
+	// Same channel and IMREAD_REDUCED_* scale handling as cv::imdecode
+	int channels = static_cast<uint8_t>(data[12]);
+	bool color = (flags & cv::IMREAD_COLOR) != 0;
+	int reduce = (flags & cv::IMREAD_REDUCED_GRAYSCALE_8) == cv::IMREAD_REDUCED_GRAYSCALE_8 ? 8
+			   : (flags & cv::IMREAD_REDUCED_GRAYSCALE_4) == cv::IMREAD_REDUCED_GRAYSCALE_4 ? 4
+			   : (flags & cv::IMREAD_REDUCED_GRAYSCALE_2) == cv::IMREAD_REDUCED_GRAYSCALE_2 ? 2 : 1;
+
+	// Straight into `image` when no conversion is needed
+	if (flags == cv::IMREAD_UNCHANGED || (color && channels == 3 && reduce == 1)) {
+		if (!qoi_decode(data, size, image)) {
+			image.release();
+			return false;
+		}
+		return true;
+	}
+
+	cv::Mat decoded;
+	if (!qoi_decode(data, size, decoded)) {
+		image.release();
+		return false;
+	}
+	cv::Mat converted = decoded;
+	if (!color) {
+		cv::cvtColor(decoded, converted, channels == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+	} else if (channels == 4) {
+		cv::cvtColor(decoded, converted, cv::COLOR_BGRA2BGR);
+	}
+	if (reduce > 1) {
+		cv::Size reduced((converted.cols + reduce - 1) / reduce, (converted.rows + reduce - 1) / reduce);
+		cv::resize(converted, image, reduced, 0, 0, cv::INTER_AREA);
+	} else {
+		image = converted;
+	}
+	return true;
+}
+
+bool is_qoi(const char* data, size_t size) {
+	return size >= QOI_HEADER_SIZE + sizeof(QOI_PADDING)
+		&& std::memcmp(data, QOI_MAGIC, sizeof(QOI_MAGIC)) == 0;
+}
+
+std::vector<uchar> qoi_encode(const cv::Mat& image) {
+	if (image.depth() != CV_8U || (image.channels() != 3 && image.channels() != 4)) {
+		throw std::invalid_argument("QOI encoding needs an 8-bit BGR or BGRA image.");
+	}
+	const int channels = image.channels();
+	const size_t pixels = image.total();
+
+	// Worst case: every pixel as QOI_OP_RGBA
+	std::vector<uchar> out(QOI_HEADER_SIZE + pixels * (channels + 1) + sizeof(QOI_PADDING));
+	uint8_t* p = out.data();
+	std::memcpy(p, QOI_MAGIC, sizeof(QOI_MAGIC));
+	write_u32_be(p + 4, static_cast<uint32_t>(image.cols));
+	write_u32_be(p + 8, static_cast<uint32_t>(image.rows));
+	p[12] = static_cast<uint8_t>(channels);
+	p[13] = 0; // sRGB with linear alpha
+	p += QOI_HEADER_SIZE;
+
+	Rgba index[64] = {};
+	Rgba prev{0, 0, 0, 255};
+	int run = 0;
+	size_t position = 0;
+
+	for (int y = 0; y < image.rows; ++y) {
+		const uint8_t* row = image.ptr<uint8_t>(y);
+		for (int x = 0; x < image.cols; ++x, ++position, row += channels) {
+			Rgba px{row[2], row[1], row[0], channels == 4 ? row[3] : uint8_t(255)};
+
+			if (px == prev) {
+				++run;
+				if (run == 62 || position + 1 == pixels) {
+					*p++ = static_cast<uint8_t>(QOI_OP_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				*p++ = static_cast<uint8_t>(QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+
+			int hash = qoi_hash(px);
+			if (index[hash] == px) {
+				*p++ = static_cast<uint8_t>(QOI_OP_INDEX | hash);
+			} else {
+				index[hash] = px;
+				if (px.a == prev.a) {
+					int8_t vr = static_cast<int8_t>(px.r - prev.r);
+					int8_t vg = static_cast<int8_t>(px.g - prev.g);
+					int8_t vb = static_cast<int8_t>(px.b - prev.b);
+					int8_t vg_r = static_cast<int8_t>(vr - vg);
+					int8_t vg_b = static_cast<int8_t>(vb - vg);
+
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+						*p++ = static_cast<uint8_t>(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+					} else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+						*p++ = static_cast<uint8_t>(QOI_OP_LUMA | (vg + 32));
+						*p++ = static_cast<uint8_t>((vg_r + 8) << 4 | (vg_b + 8));
+					} else {
+						*p++ = QOI_OP_RGB;
+						*p++ = px.r;
+						*p++ = px.g;
+						*p++ = px.b;
+					}
+				} else {
+					*p++ = QOI_OP_RGBA;
+					*p++ = px.r;
+					*p++ = px.g;
+					*p++ = px.b;
+					*p++ = px.a;
+				}
+			}
+			prev = px;
+		}
+	}
+
+	std::memcpy(p, QOI_PADDING, sizeof(QOI_PADDING));
+	p += sizeof(QOI_PADDING);
+	out.resize(static_cast<size_t>(p - out.data()));
+	return out;
+}
+
+bool qoi_decode(const char* data, size_t size, cv::Mat& image) {
+	if (!is_qoi(data, size)) {
+		return false;
+	}
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	uint32_t width = read_u32_be(bytes + 4);
+	uint32_t height = read_u32_be(bytes + 8);
+	int channels = bytes[12];
+	if (width == 0 || height == 0 || (channels != 3 && channels != 4)
+		|| static_cast<uint64_t>(width) * height > QOI_PIXELS_MAX) {
+		return false;
+	}
+
+	image.create(static_cast<int>(height), static_cast<int>(width), CV_8UC(channels));
+
+	const uint8_t* p = bytes + QOI_HEADER_SIZE;
+	const uint8_t* chunks_end = bytes + size - sizeof(QOI_PADDING);
+	Rgba index[64] = {};
+	Rgba px{0, 0, 0, 255};
+	int run = 0;
+
+	for (int y = 0; y < image.rows; ++y) {
+		uint8_t* row = image.ptr<uint8_t>(y);
+		for (int x = 0; x < image.cols; ++x, row += channels) {
+			if (run > 0) {
+				--run;
+			} else {
+				if (p >= chunks_end) {
+					return false; // truncated
+				}
+				uint8_t b1 = *p++;
+				if (b1 == QOI_OP_RGB) {
+					if (chunks_end - p < 3) return false;
+					px.r = p[0];
+					px.g = p[1];
+					px.b = p[2];
+					p += 3;
+				} else if (b1 == QOI_OP_RGBA) {
+					if (chunks_end - p < 4) return false;
+					px.r = p[0];
+					px.g = p[1];
+					px.b = p[2];
+					px.a = p[3];
+					p += 4;
+				} else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+					px = index[b1];
+				} else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+					px.r = static_cast<uint8_t>(px.r + ((b1 >> 4) & 0x03) - 2);
+					px.g = static_cast<uint8_t>(px.g + ((b1 >> 2) & 0x03) - 2);
+					px.b = static_cast<uint8_t>(px.b + (b1 & 0x03) - 2);
+				} else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+					if (p >= chunks_end) return false;
+					uint8_t b2 = *p++;
+					int vg = (b1 & 0x3f) - 32;
+					px.r = static_cast<uint8_t>(px.r + vg - 8 + ((b2 >> 4) & 0x0f));
+					px.g = static_cast<uint8_t>(px.g + vg);
+					px.b = static_cast<uint8_t>(px.b + vg - 8 + (b2 & 0x0f));
+				} else { // QOI_OP_RUN
+					run = b1 & 0x3f;
+				}
+				index[qoi_hash(px)] = px;
+			}
+
+			row[0] = px.b;
+			row[1] = px.g;
+			row[2] = px.r;
+			if (channels == 4) {
+				row[3] = px.a;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,104 @@
+#include "KeypointSet.hpp"
+#include <algorithm>
+#include <functional> // greater
+
+namespace {
+
+// Moves the elements at `kept` (ascending) to the front, then truncates
+template <typename T>
+void compact(std::vector<T>& values, const std::vector<int>& kept) {
+	for (size_t i = 0; i < kept.size(); ++i) {
+		values[i] = values[static_cast<size_t>(kept[i])];
+	}
+	values.resize(kept.size());
+}
+
+} // namespace
+
+void KeypointSet::clear() {
+	x_.clear();
+	y_.clear();
+	size_.clear();
+	angle_.clear();
+	response_.clear();
+	octave_.clear();
+}
+
+void KeypointSet::reserve(size_t n) {
+	x_.reserve(n);
+	y_.reserve(n);
+	size_.reserve(n);
+	angle_.reserve(n);
+	response_.reserve(n);
+	octave_.reserve(n);
+}
+
+void KeypointSet::push_back(const cv::KeyPoint& keypoint) {
+	x_.push_back(keypoint.pt.x);
+	y_.push_back(keypoint.pt.y);
+	size_.push_back(keypoint.size);
+	angle_.push_back(keypoint.angle);
+	response_.push_back(keypoint.response);
+	octave_.push_back(keypoint.octave);
+}
+
+void KeypointSet::assign(const std::vector<cv::KeyPoint>& keypoints) {
+	clear();
+	reserve(keypoints.size());
+	for (const auto& keypoint : keypoints) {
+		push_back(keypoint);
+	}
+}
+
+cv::KeyPoint KeypointSet::keypoint(size_t i) const {
+	return cv::KeyPoint(cv::Point2f(x_[i], y_[i]), size_[i], angle_[i], response_[i], octave_[i]);
+}
+
+std::vector<cv::KeyPoint> KeypointSet::to_keypoints() const {
+	std::vector<cv::KeyPoint> keypoints;
+	keypoints.reserve(size());
+	for (size_t i = 0; i < size(); ++i) {
+		keypoints.push_back(keypoint(i));
+	}
+	return keypoints;
+}
+
+bool KeypointSet::retain_strongest(size_t n, std::vector<int>* kept) {
+	if (size() <= n) {
+		return false;
+	}
+
+	std::vector<int> indices;
+	if (n > 0) {
+		// The n-th highest response is the cut-off; all above it stay, and
+		// as many equal to it as fit, first come first kept
+		std::vector<float> sorted(response_);
+		std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(n - 1),
+						 sorted.end(), std::greater<float>());
+		float cutoff = sorted[n - 1];
+		size_t above = static_cast<size_t>(std::count_if(response_.begin(), response_.end(),
+			[cutoff](float response) { return response > cutoff; }));
+		size_t at_cutoff = n - above;
+
+		indices.reserve(n);
+		for (size_t i = 0; i < response_.size(); ++i) {
+			if (response_[i] > cutoff) {
+				indices.push_back(static_cast<int>(i));
+			} else if (response_[i] == cutoff && at_cutoff > 0) {
+				indices.push_back(static_cast<int>(i));
+				--at_cutoff;
+			}
+		}
+	}
+
+	compact(x_, indices);
+	compact(y_, indices);
+	compact(size_, indices);
+	compact(angle_, indices);
+	compact(response_, indices);
+	compact(octave_, indices);
+	if (kept) {
+		*kept = std::move(indices);
+	}
+	return true;
+}
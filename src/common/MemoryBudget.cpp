@@ -0,0 +1,114 @@
+#include "MemoryBudget.hpp"
+#include <algorithm>
+#include <utility> // exchange
+
+MemoryBudget::MemoryBudget(size_t limit, Gauge& used)
+	: limit_(limit), gauge_(used) {}
+
+size_t MemoryBudget::used() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return used_;
+}
+
+bool MemoryBudget::fits(size_t bytes) const {
+	return limit_ == 0 || frames_ == 0 || bytes <= limit_ - std::min(used_, limit_);
+}
+
+bool MemoryBudget::try_acquire(size_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!fits(bytes)) {
+		return false;
+	}
+	++frames_;
+	used_ += bytes;
+	gauge_.add(static_cast<int64_t>(bytes));
+	return true;
+}
+
+bool MemoryBudget::acquire(size_t bytes) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	bool waited = !fits(bytes);
+	released_.wait(lock, [&] { return fits(bytes); });
+	++frames_;
+	used_ += bytes;
+	gauge_.add(static_cast<int64_t>(bytes));
+	return !waited;
+}
+
+void MemoryBudget::charge(size_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	used_ += bytes;
+	gauge_.add(static_cast<int64_t>(bytes));
+}
+
+void MemoryBudget::release(size_t bytes, bool frame_done) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (frame_done && frames_ > 0) {
+			--frames_;
+		}
+		bytes = std::min(bytes, used_);
+		used_ -= bytes;
+		gauge_.sub(static_cast<int64_t>(bytes));
+	}
+	released_.notify_all();
+}
+
+MemoryCharge::MemoryCharge(MemoryBudget& budget, Gauge& stage, size_t bytes)
+	: budget_(&budget), stage_(&stage), bytes_(bytes), frame_(true) {
+	stage_->add(static_cast<int64_t>(bytes_));
+}
+
+MemoryCharge::MemoryCharge(MemoryBudget& budget, Gauge& stage)
+	: budget_(&budget), stage_(&stage) {}
+
+MemoryCharge::MemoryCharge(MemoryCharge&& other) noexcept
+	: budget_(std::exchange(other.budget_, nullptr)),
+	  stage_(std::exchange(other.stage_, nullptr)),
+	  bytes_(std::exchange(other.bytes_, 0)),
+	  frame_(std::exchange(other.frame_, false)) {}
+
+MemoryCharge& MemoryCharge::operator=(MemoryCharge&& other) noexcept {
+	if (this != &other) {
+		reset();
+		budget_ = std::exchange(other.budget_, nullptr);
+		stage_ = std::exchange(other.stage_, nullptr);
+		bytes_ = std::exchange(other.bytes_, 0);
+		frame_ = std::exchange(other.frame_, false);
+	}
+	return *this;
+}
+
+void MemoryCharge::move_to(Gauge& stage) {
+	if (!budget_) {
+		return;
+	}
+	stage_->sub(static_cast<int64_t>(bytes_));
+	stage_ = &stage;
+	stage_->add(static_cast<int64_t>(bytes_));
+}
+
+void MemoryCharge::resize(size_t bytes) {
+	if (!budget_) {
+		return;
+	}
+	if (bytes > bytes_) {
+		budget_->charge(bytes - bytes_);
+	} else if (bytes < bytes_) {
+		budget_->release(bytes_ - bytes);
+	}
+	stage_->add(static_cast<int64_t>(bytes) - static_cast<int64_t>(bytes_));
+	bytes_ = bytes;
+}
+
+void MemoryCharge::reset() {
+	if (!budget_) {
+		return;
+	}
+	stage_->sub(static_cast<int64_t>(bytes_));
+	budget_->release(bytes_, frame_);
+	budget_ = nullptr;
+	stage_ = nullptr;
+	bytes_ = 0;
+	frame_ = false;
+}
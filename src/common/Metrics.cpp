@@ -0,0 +1,62 @@
+#include "Metrics.hpp"
+#include <iomanip>
+#include <sstream>
+
+Metrics& Metrics::global() {
+	static Metrics instance;
+	return instance;
+}
+
+Counter& Metrics::counter(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto& slot = counters_[name];
+	if (!slot) {
+		slot = std::make_unique<Counter>();
+	}
+	return *slot;
+}
+
+Gauge& Metrics::gauge(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto& slot = gauges_[name];
+	if (!slot) {
+		slot = std::make_unique<Gauge>();
+	}
+	return *slot;
+}
+
+std::string Metrics::report() {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - last_report_).count();
+	last_report_ = now;
+
+	// Merge both maps so the line comes out sorted by name
+	std::map<std::string, std::string> entries;
+	for (const auto& entry : counters_) {
+		uint64_t value = entry.second->value();
+		uint64_t& last = last_counts_[entry.first];
+
+		std::ostringstream out;
+		out << value;
+		if (seconds > 0) {
+			out << " (" << std::fixed << std::setprecision(1)
+				<< (value - last) / seconds << "/s)";
+		}
+		last = value;
+		entries[entry.first] = out.str();
+	}
+	for (const auto& entry : gauges_) {
+		entries[entry.first] = std::to_string(entry.second->value());
+	}
+
+	std::ostringstream line;
+	for (const auto& entry : entries) {
+		if (line.tellp() > 0) {
+			line << ' ';
+		}
+		line << entry.first << '=' << entry.second;
+	}
+	return line.str();
+}
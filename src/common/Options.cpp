@@ -0,0 +1,133 @@
+#include "Options.hpp"
+#include <stdexcept>
+
+Options::Options(int argc, char* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.size() <= 2 || arg.compare(0, 2, "--") != 0) {
+			positional_.push_back(arg);
+			continue;
+		}
+
+		size_t eq = arg.find('=');
+		if (eq == std::string::npos) {
+			values_[arg.substr(2)] = "true";
+		} else {
+			values_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+		}
+	}
+}
+
+bool Options::has(const std::string& key) const {
+	return values_.count(key) != 0;
+}
+
+std::vector<std::string> Options::keys() const {
+	std::vector<std::string> keys;
+	for (const auto& entry : values_) {
+		keys.push_back(entry.first);
+	}
+	return keys;
+}
+
+std::string Options::get(const std::string& key, const std::string& fallback) const {
+	auto it = values_.find(key);
+	return it == values_.end() ? fallback : it->second;
+}
+
+long long Options::get_int(const std::string& key, long long fallback) const {
+	auto it = values_.find(key);
+	if (it == values_.end()) {
+		return fallback;
+	}
+
+	size_t used = 0;
+	long long value = 0;
+	try {
+		value = std::stoll(it->second, &used);
+	} catch (const std::exception&) {
+		used = 0;
+	}
+	if (used == 0 || used != it->second.size()) {
+		throw std::invalid_argument("Option --" + key + " expects an integer, got '" + it->second + "'");
+	}
+	return value;
+}
+
+double Options::get_double(const std::string& key, double fallback) const {
+	auto it = values_.find(key);
+	if (it == values_.end()) {
+		return fallback;
+	}
+
+	size_t used = 0;
+	double value = 0.0;
+	try {
+		value = std::stod(it->second, &used);
+	} catch (const std::exception&) {
+		used = 0;
+	}
+	if (used == 0 || used != it->second.size()) {
+		throw std::invalid_argument("Option --" + key + " expects a number, got '" + it->second + "'");
+	}
+	return value;
+}
+
+bool Options::get_bool(const std::string& key, bool fallback) const {
+	auto it = values_.find(key);
+	if (it == values_.end()) {
+		return fallback;
+	}
+
+	const std::string& v = it->second;
+	if (v == "true" || v == "1" || v == "yes" || v == "on") {
+		return true;
+	}
+	if (v == "false" || v == "0" || v == "no" || v == "off") {
+		return false;
+	}
+	throw std::invalid_argument("Option --" + key + " expects a boolean, got '" + v + "'");
+}
+
+std::vector<std::string> Options::get_list(const std::string& key,
+										   const std::vector<std::string>& fallback) const {
+	auto it = values_.find(key);
+	if (it == values_.end()) {
+		return fallback;
+	}
+
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= it->second.size()) {
+		size_t comma = it->second.find(',', start);
+		if (comma == std::string::npos) {
+			comma = it->second.size();
+		}
+		if (comma > start) {
+			items.push_back(it->second.substr(start, comma - start));
+		}
+		start = comma + 1;
+	}
+	return items;
+}
+
+std::vector<long long> Options::get_int_list(const std::string& key,
+											 const std::vector<long long>& fallback) const {
+	if (values_.find(key) == values_.end()) {
+		return fallback;
+	}
+
+	std::vector<long long> values;
+	for (const auto& item : get_list(key, {})) {
+		size_t used = 0;
+		try {
+			values.push_back(std::stoll(item, &used));
+		} catch (const std::exception&) {
+			used = 0;
+		}
+		if (used == 0 || used != item.size()) {
+			throw std::invalid_argument("Option --" + key + " expects integers, got '" + item + "'");
+		}
+	}
+	return values;
+}
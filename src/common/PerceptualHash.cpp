@@ -0,0 +1,140 @@
+#include "PerceptualHash.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#include "opencv2/imgproc.hpp"
+
+namespace {
+
+uint64_t dhash(const cv::Mat& gray) {
+	cv::Mat thumb;
+	cv::resize(gray, thumb, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+	uint64_t hash = 0;
+	for (int y = 0; y < 8; ++y) {
+		const uchar* row = thumb.ptr<uchar>(y);
+		for (int x = 0; x < 8; ++x) {
+			hash = (hash << 1) | (row[x + 1] > row[x]);
+		}
+	}
+	return hash;
+}
+
+uint64_t phash(const cv::Mat& gray) {
+	cv::Mat thumb, pixels, spectrum;
+	cv::resize(gray, thumb, cv::Size(32, 32), 0, 0, cv::INTER_AREA);
+	thumb.convertTo(pixels, CV_32F);
+	cv::dct(pixels, spectrum);
+
+	float coefficients[64];
+	for (int y = 0; y < 8; ++y) {
+		const float* row = spectrum.ptr<float>(y);
+		std::copy(row, row + 8, coefficients + y * 8);
+	}
+	// Median of the AC terms; the DC term only tracks overall brightness
+	float ac[63];
+	std::copy(coefficients + 1, coefficients + 64, ac);
+	std::nth_element(ac, ac + 31, ac + 63);
+	float median = ac[31];
+
+	uint64_t hash = 0;
+	for (float c : coefficients) {
+		hash = (hash << 1) | (c > median);
+	}
+	return hash;
+}
+
+} // namespace
+
+HashKind parse_hash_kind(const std::string& name) {
+	if (name == "dhash") {
+		return HashKind::DHash;
+	}
+	if (name == "phash") {
+		return HashKind::PHash;
+	}
+	throw std::invalid_argument("Unknown hash '" + name + "' (expected dhash or phash)");
+}
+
+const char* hash_kind_name(HashKind kind) {
+	return kind == HashKind::DHash ? "dhash" : "phash";
+}
+
+uint64_t perceptual_hash(const cv::Mat& gray, HashKind kind) {
+	if (gray.empty() || gray.type() != CV_8UC1) {
+		throw std::invalid_argument("Perceptual hash needs a non-empty CV_8UC1 image.");
+	}
+	return kind == HashKind::DHash ? dhash(gray) : phash(gray);
+}
+
+HashIndex::HashIndex(int max_distance) : max_distance_(max_distance) {
+	if (max_distance < 0 || max_distance >= 32) {
+		throw std::invalid_argument("Hash index distance must be in [0, 32).");
+	}
+	// max_distance + 1 chunks covering all 64 bits, the first ones one bit wider
+	int count = max_distance + 1;
+	int shift = 0;
+	for (int i = 0; i < count; ++i) {
+		int bits = 64 / count + (i < 64 % count ? 1 : 0);
+		uint64_t mask = bits == 64 ? ~0ULL : ((1ULL << bits) - 1);
+		chunks_.push_back(Chunk{shift, mask});
+		shift += bits;
+	}
+	tables_.resize(chunks_.size());
+}
+
+void HashIndex::add(uint64_t hash, int64_t id) {
+	uint32_t position = static_cast<uint32_t>(hashes_.size());
+	hashes_.push_back(hash);
+	ids_.push_back(id);
+	for (size_t c = 0; c < chunks_.size(); ++c) {
+		tables_[c][(hash >> chunks_[c].shift) & chunks_[c].mask].push_back(position);
+	}
+}
+
+void HashIndex::truncate(size_t size) {
+	// Positions are appended in increasing order, so the dropped ones are
+	// at the back of their buckets
+	for (size_t i = size; i < hashes_.size(); ++i) {
+		for (size_t c = 0; c < chunks_.size(); ++c) {
+			auto bucket = tables_[c].find((hashes_[i] >> chunks_[c].shift) & chunks_[c].mask);
+			if (bucket == tables_[c].end()) {
+				continue; // emptied for an earlier dropped hash
+			}
+			while (!bucket->second.empty() && bucket->second.back() >= size) {
+				bucket->second.pop_back();
+			}
+			if (bucket->second.empty()) {
+				tables_[c].erase(bucket);
+			}
+		}
+	}
+	if (size < hashes_.size()) {
+		hashes_.resize(size);
+		ids_.resize(size);
+	}
+}
+
+bool HashIndex::find(uint64_t hash, Match& match) const {
+	uint32_t best = UINT32_MAX;
+	int best_distance = max_distance_ + 1;
+	for (size_t c = 0; c < chunks_.size(); ++c) {
+		auto bucket = tables_[c].find((hash >> chunks_[c].shift) & chunks_[c].mask);
+		if (bucket == tables_[c].end()) {
+			continue;
+		}
+		// A candidate found through several chunks is just checked again
+		for (uint32_t position : bucket->second) {
+			int distance = hash_distance(hash, hashes_[position]);
+			if (distance < best_distance || (distance == best_distance && position < best)) {
+				best = position;
+				best_distance = distance;
+			}
+		}
+	}
+	if (best == UINT32_MAX) {
+		return false;
+	}
+	match.id = ids_[best];
+	match.distance = best_distance;
+	return true;
+}
@@ -0,0 +1,208 @@
+#include "ProductQuantizer.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t PQ_MAGIC = 0x51534944; // "DISQ" read little-endian
+constexpr uint32_t PQ_VERSION = 1;
+
+float squared_distance(const float* a, const float* b, int dims) {
+	float sum = 0.0f;
+	for (int i = 0; i < dims; ++i) {
+		float d = a[i] - b[i];
+		sum += d * d;
+	}
+	return sum;
+}
+
+// Fixed code sizes let the compiler unroll the lookups
+template <int M>
+void scan_fixed(const float* table, const uint8_t* codes, size_t count, float* distances) {
+	for (size_t i = 0; i < count; ++i, codes += M) {
+		float sum = 0.0f;
+		for (int j = 0; j < M; ++j) {
+			sum += table[j * ProductQuantizer::CENTROIDS + codes[j]];
+		}
+		distances[i] = sum;
+	}
+}
+
+} // namespace
+
+ProductQuantizer ProductQuantizer::train(const cv::Mat& samples, const Params& params) {
+	if (samples.type() != CV_32F || samples.empty()) {
+		throw std::invalid_argument("Product quantizer needs CV_32F training descriptors.");
+	}
+	if (params.subspaces <= 0 || samples.cols % params.subspaces != 0) {
+		throw std::invalid_argument("Descriptor length must be a multiple of the subspace count.");
+	}
+	if (samples.rows < CENTROIDS) {
+		throw std::invalid_argument("Product quantizer needs at least 256 training descriptors.");
+	}
+
+	// Random subset when there are more rows than k-means needs; fixed seed
+	// so retraining on the same data gives the same codebooks
+	cv::Mat training = samples;
+	if (static_cast<size_t>(samples.rows) > params.max_samples) {
+		std::vector<int> rows(static_cast<size_t>(samples.rows));
+		std::iota(rows.begin(), rows.end(), 0);
+		std::shuffle(rows.begin(), rows.end(), std::mt19937(12345));
+		training = cv::Mat(static_cast<int>(params.max_samples), samples.cols, CV_32F);
+		for (int r = 0; r < training.rows; ++r) {
+			cv::Mat target = training.row(r);
+			samples.row(rows[r]).copyTo(target);
+		}
+	}
+
+	ProductQuantizer pq;
+	pq.dims_ = samples.cols;
+	pq.subspaces_ = params.subspaces;
+	pq.sub_dims_ = samples.cols / params.subspaces;
+	pq.centroids_.resize(static_cast<size_t>(pq.subspaces_) * CENTROIDS * pq.sub_dims_);
+
+	for (int s = 0; s < pq.subspaces_; ++s) {
+		cv::Mat slice = training.colRange(s * pq.sub_dims_, (s + 1) * pq.sub_dims_).clone();
+		cv::Mat labels;
+		cv::Mat centers;
+		cv::kmeans(slice, CENTROIDS, labels,
+				   cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+									params.kmeans_iterations, 1e-4),
+				   1, cv::KMEANS_PP_CENTERS, centers);
+		for (int c = 0; c < CENTROIDS; ++c) {
+			std::copy_n(centers.ptr<float>(c), pq.sub_dims_,
+						pq.centroids_.begin() + (static_cast<size_t>(s) * CENTROIDS + c) * pq.sub_dims_);
+		}
+	}
+	return pq;
+}
+
+cv::Mat ProductQuantizer::encode(const cv::Mat& descriptors) const {
+	cv::Mat rows;
+	if (descriptors.type() == CV_32F) {
+		rows = descriptors;
+	} else {
+		descriptors.convertTo(rows, CV_32F);
+	}
+	if (!rows.empty() && rows.cols != dims_) {
+		throw std::invalid_argument("Descriptor length does not match the product quantizer.");
+	}
+
+	cv::Mat codes(rows.rows, subspaces_, CV_8U);
+	for (int r = 0; r < rows.rows; ++r) {
+		const float* row = rows.ptr<float>(r);
+		uint8_t* code = codes.ptr<uint8_t>(r);
+		for (int s = 0; s < subspaces_; ++s) {
+			const float* slice = row + s * sub_dims_;
+			int best = 0;
+			float best_distance = FLT_MAX;
+			for (int c = 0; c < CENTROIDS; ++c) {
+				float distance = squared_distance(slice, centroid(s, c), sub_dims_);
+				if (distance < best_distance) {
+					best_distance = distance;
+					best = c;
+				}
+			}
+			code[s] = static_cast<uint8_t>(best);
+		}
+	}
+	return codes;
+}
+
+cv::Mat ProductQuantizer::decode(const cv::Mat& codes) const {
+	if (!codes.empty() && (codes.type() != CV_8U || codes.cols != subspaces_)) {
+		throw std::invalid_argument("Codes do not match the product quantizer.");
+	}
+
+	cv::Mat descriptors(codes.rows, dims_, CV_32F);
+	for (int r = 0; r < codes.rows; ++r) {
+		const uint8_t* code = codes.ptr<uint8_t>(r);
+		float* row = descriptors.ptr<float>(r);
+		for (int s = 0; s < subspaces_; ++s) {
+			std::copy_n(centroid(s, code[s]), sub_dims_, row + s * sub_dims_);
+		}
+	}
+	return descriptors;
+}
+
+void ProductQuantizer::distance_table(const float* query, float* table) const {
+	for (int s = 0; s < subspaces_; ++s) {
+		const float* slice = query + s * sub_dims_;
+		for (int c = 0; c < CENTROIDS; ++c) {
+			table[s * CENTROIDS + c] = squared_distance(slice, centroid(s, c), sub_dims_);
+		}
+	}
+}
+
+void ProductQuantizer::scan(const float* table, const uint8_t* codes, size_t count,
+							float* distances) const {
+	switch (subspaces_) {
+	case 8:
+		scan_fixed<8>(table, codes, count, distances);
+		return;
+	case 16:
+		scan_fixed<16>(table, codes, count, distances);
+		return;
+	default:
+		break;
+	}
+
+	for (size_t i = 0; i < count; ++i, codes += subspaces_) {
+		float sum = 0.0f;
+		for (int j = 0; j < subspaces_; ++j) {
+			sum += table[j * CENTROIDS + codes[j]];
+		}
+		distances[i] = sum;
+	}
+}
+
+void ProductQuantizer::save(const std::string& path) const {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error("Cannot open " + path + " for writing.");
+	}
+
+	uint32_t header[5] = {PQ_MAGIC, PQ_VERSION, static_cast<uint32_t>(dims_),
+						  static_cast<uint32_t>(subspaces_), static_cast<uint32_t>(CENTROIDS)};
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(centroids_.data()),
+			  static_cast<std::streamsize>(centroids_.size() * sizeof(float)));
+	if (!out) {
+		throw std::runtime_error("Error writing " + path + ".");
+	}
+}
+
+ProductQuantizer ProductQuantizer::load(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Cannot open codebook " + path + ".");
+	}
+
+	uint32_t header[5];
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!in || header[0] != PQ_MAGIC || header[1] != PQ_VERSION
+		|| header[4] != static_cast<uint32_t>(CENTROIDS)) {
+		throw std::runtime_error(path + " is not a product quantizer codebook.");
+	}
+	uint32_t dims = header[2];
+	uint32_t subspaces = header[3];
+	if (dims == 0 || dims > 4096 || subspaces == 0 || dims % subspaces != 0) {
+		throw std::runtime_error("Codebook " + path + " has an invalid header.");
+	}
+
+	ProductQuantizer pq;
+	pq.dims_ = static_cast<int>(dims);
+	pq.subspaces_ = static_cast<int>(subspaces);
+	pq.sub_dims_ = static_cast<int>(dims / subspaces);
+	pq.centroids_.resize(static_cast<size_t>(CENTROIDS) * dims);
+	in.read(reinterpret_cast<char*>(pq.centroids_.data()),
+			static_cast<std::streamsize>(pq.centroids_.size() * sizeof(float)));
+	if (!in) {
+		throw std::runtime_error("Codebook " + path + " is truncated.");
+	}
+	return pq;
+}
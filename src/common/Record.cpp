@@ -0,0 +1,58 @@
+#include "Record.hpp"
+#include "Frame.hpp"
+
+namespace record {
+
+bool is_valid(const RecordView& parts) {
+	return parts.size() >= CORE_PARTS && (parts.size() - CORE_PARTS) % 2 == 0;
+}
+
+const PartView* find_part(const RecordView& parts, const std::string& tag) {
+	for (size_t i = CORE_PARTS; i + 1 < parts.size(); i += 2) {
+		if (parts[i].size == tag.size()
+			&& tag.compare(0, tag.size(), parts[i].data, parts[i].size) == 0) {
+			return &parts[i + 1];
+		}
+	}
+	return nullptr;
+}
+
+std::string filename(const RecordView& parts) {
+	return std::string(parts[FILENAME].data, parts[FILENAME].size);
+}
+
+} // namespace record
+
+ReceivedRecords read_records(zmq::socket_t& socket, zmq::message_t&& first) {
+	ReceivedRecords received;
+	received.messages.push_back(std::move(first));
+
+	while (socket.get(zmq::sockopt::rcvmore)) {
+		received.messages.emplace_back();
+		(void)socket.recv(received.messages.back());
+	}
+
+	// Views are taken only once `messages` has stopped growing: small
+	// messages keep their bytes inline and move with the vector
+	if (received.messages.size() > 1) {
+		RecordView parts;
+		parts.reserve(received.messages.size());
+		for (const auto& msg : received.messages) {
+			parts.push_back(PartView{static_cast<const char*>(msg.data()), msg.size()});
+		}
+		received.records.push_back(std::move(parts));
+		return received;
+	}
+
+	const zmq::message_t& msg = received.messages.front();
+	if (is_batch(msg.data(), msg.size())) {
+		received.records = unpack_batch(msg.data(), msg.size());
+		received.batched = true;
+	} else if (is_frame(msg.data(), msg.size())) {
+		received.records.push_back(decode_frame(msg.data(), msg.size()));
+	} else {
+		// A lone plain part; let the caller reject it as too short
+		received.records.push_back(RecordView{PartView{static_cast<const char*>(msg.data()), msg.size()}});
+	}
+	return received;
+}
@@ -1,76 +1,174 @@
 #include "Serialization.hpp"
 #include <stdexcept>
 #include <cstring> // memcpy
+#include <type_traits>
 
-// Define the size of a single serialized KeyPoint
-// 5 floats + 2 ints
-const size_t SIZEOF_SERIALIZED_KEYPOINT = (5 * sizeof(float)) + (2 * sizeof(int));
+#include "FieldLayout.hpp"
+
+namespace {
+
+// One keypoint on the wire: 5 floats + 2 ints, see serialize_keypoints()
+using KeyPointFormat = layout::Format<layout::Order::Interleaved,
+	layout::Nested<float, &cv::KeyPoint::pt, &cv::Point2f::x>,
+	layout::Nested<float, &cv::KeyPoint::pt, &cv::Point2f::y>,
+	layout::Member<float, &cv::KeyPoint::size>,
+	layout::Member<float, &cv::KeyPoint::angle>,
+	layout::Member<float, &cv::KeyPoint::response>,
+	layout::Member<int32_t, &cv::KeyPoint::octave>,
+	layout::Member<int32_t, &cv::KeyPoint::class_id>>;
+
+// The same from a KeypointSet's columns, which have no class_id
+using KeypointSetFormat = layout::Format<layout::Order::Interleaved,
+	layout::Column<float, &KeypointSet::x>,
+	layout::Column<float, &KeypointSet::y>,
+	layout::Column<float, &KeypointSet::sizes>,
+	layout::Column<float, &KeypointSet::angles>,
+	layout::Column<float, &KeypointSet::responses>,
+	layout::Column<int32_t, &KeypointSet::octaves>,
+	layout::Constant<int32_t, -1>>;
+
+static_assert(KeyPointFormat::record_size == 5 * sizeof(float) + 2 * sizeof(int32_t),
+			  "Keypoint wire format changed.");
+static_assert(std::is_same<KeyPointFormat::wire_types, KeypointSetFormat::wire_types>::value,
+			  "KeypointSet and cv::KeyPoint must serialize alike.");
+
+} // namespace
 
 std::vector<char> serialize_keypoints(const std::vector<cv::KeyPoint>& keypoints) {
-	// Pre-allocate the buffer
-	std::vector<char> buffer(keypoints.size() * SIZEOF_SERIALIZED_KEYPOINT);
-	
-	char* ptr = buffer.data();
-	
-	for (const auto& kp : keypoints) {
-		// Copy each field into the buffer
-		std::memcpy(ptr, &kp.pt.x, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(ptr, &kp.pt.y, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(ptr, &kp.size, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(ptr, &kp.angle, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(ptr, &kp.response, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(ptr, &kp.octave, sizeof(int));
-		ptr += sizeof(int);
-		
-		std::memcpy(ptr, &kp.class_id, sizeof(int));
-		ptr += sizeof(int);
-	}
-	
+	std::vector<char> buffer(KeyPointFormat::packed_size(keypoints.size()));
+	KeyPointFormat::pack(keypoints, keypoints.size(), buffer.data());
+	return buffer;
+}
+
+std::vector<char> serialize_keypoints(const KeypointSet& keypoints) {
+	std::vector<char> buffer(KeypointSetFormat::packed_size(keypoints.size()));
+	KeypointSetFormat::pack(keypoints, keypoints.size(), buffer.data());
 	return buffer;
 }
 
 std::vector<cv::KeyPoint> deserialize_keypoints(const std::vector<char>& data) {
-	if (data.size() % SIZEOF_SERIALIZED_KEYPOINT != 0) {
+	if (data.size() % KeyPointFormat::record_size != 0) {
 		throw std::runtime_error("Invalid data size for keypoint deserialization.");
 	}
 
-	size_t num_keypoints = data.size() / SIZEOF_SERIALIZED_KEYPOINT;
+	size_t num_keypoints = data.size() / KeyPointFormat::record_size;
 	std::vector<cv::KeyPoint> keypoints(num_keypoints);
-	
-	const char* ptr = data.data();
-	
-	for (size_t i = 0; i < num_keypoints; ++i) {
-		std::memcpy(&keypoints[i].pt.x, ptr, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(&keypoints[i].pt.y, ptr, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(&keypoints[i].size, ptr, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(&keypoints[i].angle, ptr, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(&keypoints[i].response, ptr, sizeof(float));
-		ptr += sizeof(float);
-		
-		std::memcpy(&keypoints[i].octave, ptr, sizeof(int));
-		ptr += sizeof(int);
-		
-		std::memcpy(&keypoints[i].class_id, ptr, sizeof(int));
-		ptr += sizeof(int);
-	}
-	
+	KeyPointFormat::unpack(data.data(), num_keypoints, keypoints);
 	return keypoints;
 }
+
+// rows, cols, type
+const size_t SIZEOF_DESCRIPTOR_HEADER = 3 * sizeof(int);
+
+std::vector<char> serialize_descriptors(const cv::Mat& descriptors) {
+	cv::Mat contiguous = descriptors.isContinuous() ? descriptors : descriptors.clone();
+
+	int header[3] = {contiguous.rows, contiguous.cols, contiguous.type()};
+	size_t payload = contiguous.total() * contiguous.elemSize();
+
+	std::vector<char> buffer(SIZEOF_DESCRIPTOR_HEADER + payload);
+	std::memcpy(buffer.data(), header, SIZEOF_DESCRIPTOR_HEADER);
+	if (payload > 0) {
+		std::memcpy(buffer.data() + SIZEOF_DESCRIPTOR_HEADER, contiguous.data, payload);
+	}
+	return buffer;
+}
+
+cv::Mat deserialize_descriptors(const char* data, size_t size) {
+	if (size < SIZEOF_DESCRIPTOR_HEADER) {
+		throw std::runtime_error("Invalid data size for descriptor deserialization.");
+	}
+
+	int header[3];
+	std::memcpy(header, data, SIZEOF_DESCRIPTOR_HEADER);
+	int rows = header[0];
+	int cols = header[1];
+	int type = header[2];
+	if (rows < 0 || cols < 0 || type < 0 || type > CV_MAKETYPE(CV_64F, 4)) {
+		throw std::runtime_error("Invalid descriptor header.");
+	}
+
+	// Check before allocating, so a corrupt header cannot request gigabytes;
+	// rows are bounded by the data first, as rows * row_bytes can overflow
+	size_t available = size - SIZEOF_DESCRIPTOR_HEADER;
+	size_t row_bytes = static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+	if (row_bytes != 0 && static_cast<size_t>(rows) > available / row_bytes) {
+		throw std::runtime_error("Invalid data size for descriptor deserialization.");
+	}
+	size_t payload = static_cast<size_t>(rows) * row_bytes;
+	if (available != payload) {
+		throw std::runtime_error("Invalid data size for descriptor deserialization.");
+	}
+
+	cv::Mat descriptors(rows, cols, type);
+	if (payload > 0) {
+		std::memcpy(descriptors.data, data + SIZEOF_DESCRIPTOR_HEADER, payload);
+	}
+	return descriptors;
+}
+
+namespace {
+
+// source, sequence, reference_sequence, model, matches, inliers, matrix
+using MotionFormat = layout::Format<layout::Order::Interleaved,
+	layout::Member<uint32_t, &MotionEstimate::source>,
+	layout::Member<uint64_t, &MotionEstimate::sequence>,
+	layout::Member<uint64_t, &MotionEstimate::reference_sequence>,
+	layout::Member<uint8_t, &MotionEstimate::model>,
+	layout::Member<uint32_t, &MotionEstimate::matches>,
+	layout::Member<uint32_t, &MotionEstimate::inliers>,
+	layout::Array<double, &MotionEstimate::matrix, 9>>;
+
+static_assert(MotionFormat::record_size == sizeof(uint32_t) + 2 * sizeof(uint64_t)
+			  + sizeof(uint8_t) + 2 * sizeof(uint32_t) + 9 * sizeof(double),
+			  "Motion wire format changed.");
+
+using QualityFormat = layout::Format<layout::Order::Interleaved,
+	layout::Member<float, &FrameQuality::sharpness>,
+	layout::Member<float, &FrameQuality::brightness>,
+	layout::Member<float, &FrameQuality::dark_fraction>,
+	layout::Member<float, &FrameQuality::bright_fraction>,
+	layout::Member<uint8_t, &FrameQuality::passed>>;
+
+static_assert(QualityFormat::record_size == 4 * sizeof(float) + sizeof(uint8_t),
+			  "Quality wire format changed.");
+
+} // namespace
+
+std::vector<char> serialize_motion(const MotionEstimate& motion) {
+	std::vector<char> buffer(MotionFormat::record_size);
+	MotionFormat::pack(&motion, 1, buffer.data());
+	return buffer;
+}
+
+MotionEstimate deserialize_motion(const char* data, size_t size) {
+	if (size != MotionFormat::record_size) {
+		throw std::runtime_error("Invalid data size for motion deserialization.");
+	}
+
+	MotionEstimate motion;
+	MotionEstimate* records = &motion;
+	MotionFormat::unpack(data, 1, records);
+
+	if (motion.model > MotionEstimate::Homography) {
+		throw std::runtime_error("Invalid motion model.");
+	}
+	return motion;
+}
+
+std::vector<char> serialize_quality(const FrameQuality& quality) {
+	std::vector<char> buffer(QualityFormat::record_size);
+	QualityFormat::pack(&quality, 1, buffer.data());
+	return buffer;
+}
+
+FrameQuality deserialize_quality(const char* data, size_t size) {
+	if (size != QualityFormat::record_size) {
+		throw std::runtime_error("Invalid data size for quality deserialization.");
+	}
+
+	FrameQuality quality;
+	FrameQuality* records = &quality;
+	QualityFormat::unpack(data, 1, records);
+	return quality;
+}
@@ -0,0 +1,85 @@
+#include "Pipeline.hpp"
+
+#include <iostream>
+
+#include "Coro.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+// The SIFT detector is per thread, and a coroutine may be resumed on a
+// different pool thread after every co_await, so look it up each time
+FrameProcessor& thread_processor(const ProcessingConfig& config) {
+	thread_local FrameProcessor processor(config);
+	return processor;
+}
+
+DetachedTask frame_coroutine(int id,
+							 const ProcessingConfig& config,
+							 Executor& executor,
+							 AsyncQueue<ImageTask>& work_queue,
+							 SafeQueue<ProcessedTask>& result_queue)
+{
+	static Counter& processed = Metrics::global().counter("extractor.frames_processed");
+	static Counter& decode_failures = Metrics::global().counter("extractor.decode_failures");
+
+	co_await executor.schedule();
+
+	while (true) {
+		// Receive stage: suspends until a receiver submits a frame
+		ImageTask task = co_await work_queue.pop();
+
+		// Decode, detect and serialize stages run inline on this pool thread
+		try {
+			ProcessedTask result;
+			size_t keypoint_count = 0;
+			if (!thread_processor(config).process(task, result, keypoint_count)) {
+				std::cerr << "[Coroutine " << id << "] Failed to decode " << task.filename << "\n";
+				decode_failures.add();
+				continue;
+			}
+
+			std::cout << "[Coroutine " << id << "] Processed "
+					  << result.filename << " (" << keypoint_count
+					  << " keypoints)\n";
+
+			// Send stage: the sender threads' event loops pick it up
+			result_queue.push(std::move(result));
+			processed.add();
+		} catch (const std::exception& e) {
+			std::cerr << "[Coroutine " << id << "] Error: " << e.what() << "\n";
+		}
+	}
+}
+
+} // namespace
+
+struct CoroPipeline::Impl {
+	Impl(size_t num_threads, const ProcessingConfig& processing)
+		: config(processing), executor(num_threads), work_queue(executor) {}
+
+	ProcessingConfig config;
+	Executor executor;
+	AsyncQueue<ImageTask> work_queue;
+};
+
+CoroPipeline::CoroPipeline(size_t num_threads, size_t num_coroutines,
+						   const ProcessingConfig& config,
+						   SafeQueue<ProcessedTask>& result_queue)
+	: impl_(std::make_unique<Impl>(num_threads, config))
+{
+	for (size_t i = 0; i < num_coroutines; ++i) {
+		frame_coroutine(static_cast<int>(i), impl_->config, impl_->executor,
+						impl_->work_queue, result_queue);
+	}
+}
+
+CoroPipeline::~CoroPipeline() = default;
+
+void CoroPipeline::submit(ImageTask&& task) {
+	impl_->work_queue.push(std::move(task));
+}
+
+size_t CoroPipeline::backlog() const {
+	return impl_->work_queue.size();
+}
@@ -0,0 +1,196 @@
+#include "HugePages.hpp"
+#include <cstdint>
+#include <new> // bad_alloc
+#include <stdexcept>
+
+#include "Metrics.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+size_t round_up(size_t bytes, size_t multiple) {
+	return (bytes + multiple - 1) / multiple * multiple;
+}
+
+// Bytes of a dims-dimensional array of `type`, filling in `step` the way
+// OpenCV's standard allocator does
+size_t array_bytes(int dims, const int* sizes, int type, size_t* step) {
+	size_t total = CV_ELEM_SIZE(type);
+	for (int i = dims - 1; i >= 0; --i) {
+		if (step) {
+			step[i] = total;
+		}
+		total *= static_cast<size_t>(sizes[i]);
+	}
+	return total;
+}
+
+} // namespace
+
+HugePageAllocator::Mode HugePageAllocator::parse_mode(const std::string& name) {
+	if (name == "off") return Mode::Off;
+	if (name == "transparent") return Mode::Transparent;
+	if (name == "explicit") return Mode::Explicit;
+	throw std::invalid_argument("Unknown huge page mode '" + name + "' (expected off, transparent or explicit)");
+}
+
+void HugePageAllocator::install(Mode mode) {
+	if (mode == Mode::Off) {
+		return;
+	}
+	// Never destroyed: Mats may be freed until the very end of the process
+	static HugePageAllocator* allocator = new HugePageAllocator(mode);
+	cv::Mat::setDefaultAllocator(allocator);
+}
+
+HugePageAllocator::HugePageAllocator(Mode mode, size_t min_bytes, size_t pool_bytes)
+	: mode_(mode), min_bytes_(min_bytes), pool_limit_(pool_bytes),
+	  fallback_(cv::Mat::getStdAllocator()) {
+#ifndef __linux__
+	mode_ = Mode::Off;
+#endif
+}
+
+HugePageAllocator::~HugePageAllocator() {
+	for (const auto& entry : pool_) {
+		unmap(entry.second, entry.first);
+	}
+	Metrics::global().gauge("extractor.huge_page_pool_bytes").sub(static_cast<int64_t>(pooled_));
+}
+
+cv::UMatData* HugePageAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+										  cv::AccessFlag flags, cv::UMatUsageFlags usage) const {
+	static Counter& maps = Metrics::global().counter("extractor.huge_page_maps");
+	static Counter& reuses = Metrics::global().counter("extractor.huge_page_reuses");
+	static Gauge& pool_gauge = Metrics::global().gauge("extractor.huge_page_pool_bytes");
+
+	// User-provided data, and small buffers, stay with OpenCV's allocator
+	// (which then also frees them)
+	size_t bytes = array_bytes(dims, sizes, type, nullptr);
+	if (data || mode_ == Mode::Off || bytes < min_bytes_) {
+		return fallback_->allocate(dims, sizes, type, data, step, flags, usage);
+	}
+	array_bytes(dims, sizes, type, step);
+	size_t mapped = round_up(bytes, constants::HUGE_PAGE_SIZE);
+
+	void* address = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = pool_.find(mapped);
+		if (it != pool_.end()) {
+			address = it->second;
+			pool_.erase(it);
+			pooled_ -= mapped;
+			pool_gauge.sub(static_cast<int64_t>(mapped));
+		}
+	}
+	if (address) {
+		reuses.add();
+	} else {
+		address = map(mapped);
+		maps.add();
+	}
+
+	cv::UMatData* u = new cv::UMatData(this);
+	u->data = u->origdata = static_cast<uchar*>(address);
+	u->size = bytes;
+	return u;
+}
+
+bool HugePageAllocator::allocate(cv::UMatData* data, cv::AccessFlag, cv::UMatUsageFlags) const {
+	return data != nullptr;
+}
+
+void HugePageAllocator::deallocate(cv::UMatData* u) const {
+	static Gauge& pool_gauge = Metrics::global().gauge("extractor.huge_page_pool_bytes");
+
+	if (!u) {
+		return;
+	}
+	CV_Assert(u->urefcount == 0 && u->refcount == 0);
+	size_t mapped = round_up(u->size, constants::HUGE_PAGE_SIZE);
+	void* address = u->origdata;
+	delete u;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (pooled_ + mapped <= pool_limit_) {
+			pool_.emplace(mapped, address);
+			pooled_ += mapped;
+			pool_gauge.add(static_cast<int64_t>(mapped));
+			return;
+		}
+	}
+	unmap(address, mapped);
+}
+
+size_t HugePageAllocator::pooled_bytes() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return pooled_;
+}
+
+#ifdef __linux__
+
+void* HugePageAllocator::map(size_t bytes) const {
+	static Counter& fallbacks = Metrics::global().counter("extractor.huge_page_fallbacks");
+
+	if (mode_ == Mode::Explicit) {
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_2MB
+		flags |= MAP_HUGE_2MB; // not the system default size, which may be 1 GiB
+#endif
+		void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (address != MAP_FAILED) {
+			return address;
+		}
+		fallbacks.add(); // reserved pool exhausted (or none configured)
+	}
+
+	// Over-map by a huge page and trim, so the buffer starts on a huge
+	// page boundary and the kernel can back all of it with huge pages
+	size_t span = bytes + constants::HUGE_PAGE_SIZE;
+	void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+	uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+	uintptr_t aligned = static_cast<uintptr_t>(round_up(static_cast<size_t>(start), constants::HUGE_PAGE_SIZE));
+	if (aligned > start) {
+		munmap(raw, aligned - start);
+	}
+	size_t tail = start + span - (aligned + bytes);
+	if (tail > 0) {
+		munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+	}
+	void* address = reinterpret_cast<void*>(aligned);
+	madvise(address, bytes, MADV_HUGEPAGE); // a hint; fails harmlessly without THP
+	return address;
+}
+
+void HugePageAllocator::unmap(void* address, size_t bytes) const {
+	munmap(address, bytes);
+}
+
+PageFaults page_faults() {
+	struct rusage usage {};
+	getrusage(RUSAGE_SELF, &usage);
+	return {static_cast<uint64_t>(usage.ru_minflt), static_cast<uint64_t>(usage.ru_majflt)};
+}
+
+#else
+
+void* HugePageAllocator::map(size_t) const {
+	throw std::logic_error("Huge pages are not supported on this platform.");
+}
+
+void HugePageAllocator::unmap(void*, size_t) const {}
+
+PageFaults page_faults() {
+	return {};
+}
+
+#endif
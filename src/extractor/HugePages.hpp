@@ -0,0 +1,91 @@
+#ifndef EXTRACTOR_HUGE_PAGES_HPP
+#define EXTRACTOR_HUGE_PAGES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "opencv2/core.hpp"
+
+#include "Constants.hpp"
+
+/**
+ * @brief cv::Mat allocator that backs large buffers with huge pages and
+ * keeps freed ones for reuse (feature_extractor --huge-pages).
+ *
+ * A decoded 12 MP frame spans ~9000 4 KiB pages: every new buffer faults
+ * each of them in on first touch, and the row-by-row passes of decoding,
+ * pyrDown and SIFT's Gaussian / DoG scale space keep missing the TLB.
+ * Installed as OpenCV's default allocator, this maps every buffer of at
+ * least constants::HUGE_PAGE_MIN_BYTES in whole 2 MiB pages, including
+ * the scratch Mats SIFT allocates internally:
+ *
+ * - Transparent: a 2 MiB aligned anonymous mapping with
+ *   madvise(MADV_HUGEPAGE), for the kernel's transparent huge pages (they
+ *   must be enabled as "always" or "madvise").
+ * - Explicit: MAP_HUGETLB pages from the reserved pool
+ *   (/proc/sys/vm/nr_hugepages); when it is exhausted, the buffer falls
+ *   back to Transparent, counted as extractor.huge_page_fallbacks.
+ *
+ * Freed buffers go to a pool keyed by their mapped size (frames of one
+ * resolution need the same sizes over and over), up to
+ * constants::HUGE_PAGE_POOL_BYTES, so steady-state frames neither map nor
+ * fault at all. Smaller buffers go to OpenCV's standard allocator.
+ *
+ * Thread-safe; Linux only (elsewhere every mode behaves as Off).
+ */
+class HugePageAllocator : public cv::MatAllocator {
+public:
+	enum class Mode { Off, Transparent, Explicit };
+
+	// Parses "off", "transparent" or "explicit"
+	static Mode parse_mode(const std::string& name);
+
+	/**
+	 * @brief Makes an allocator in `mode` OpenCV's default, for every Mat
+	 * created afterwards (Mats created before keep their allocator).
+	 * Nothing happens for Mode::Off. Call once, before the workers start.
+	 */
+	static void install(Mode mode);
+
+	explicit HugePageAllocator(Mode mode,
+							   size_t min_bytes = constants::HUGE_PAGE_MIN_BYTES,
+							   size_t pool_bytes = constants::HUGE_PAGE_POOL_BYTES);
+	~HugePageAllocator() override;
+
+	HugePageAllocator(const HugePageAllocator&) = delete;
+	HugePageAllocator& operator=(const HugePageAllocator&) = delete;
+
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+						   cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+	bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override;
+	void deallocate(cv::UMatData* data) const override;
+
+	// Bytes of freed buffers waiting in the pool
+	size_t pooled_bytes() const;
+
+private:
+	void* map(size_t bytes) const;
+	void unmap(void* address, size_t bytes) const;
+
+	Mode mode_;
+	size_t min_bytes_;
+	size_t pool_limit_;
+	cv::MatAllocator* fallback_;
+
+	mutable std::mutex mutex_;
+	mutable std::multimap<size_t, void*> pool_; // mapped size -> free buffer
+	mutable size_t pooled_ = 0;
+};
+
+// Page faults of the whole process so far (getrusage), to compare modes
+struct PageFaults {
+	uint64_t minor = 0; // page mapped in without I/O, e.g. first touch
+	uint64_t major = 0; // needed I/O
+};
+
+PageFaults page_faults();
+
+#endif // EXTRACTOR_HUGE_PAGES_HPP
@@ -0,0 +1,362 @@
+#include "Motion.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+#include "BruteForceMatcher.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+// Earlier frames kept per source to find a reference among out-of-order arrivals
+const size_t HISTORY_FRAMES = 4;
+
+struct Correspondence {
+	double x, y; // reference frame
+	double u, v; // this frame
+};
+
+// Row-major 3x3
+using Matrix3 = std::array<double, 9>;
+
+// Translation and isotropic scale bringing points to centroid 0, mean distance sqrt(2)
+struct Normalization {
+	double cx = 0, cy = 0, scale = 1;
+};
+
+Normalization normalization(const std::vector<cv::Point2f>& points) {
+	Normalization n;
+	if (points.empty()) {
+		return n;
+	}
+	for (const auto& p : points) {
+		n.cx += p.x;
+		n.cy += p.y;
+	}
+	n.cx /= points.size();
+	n.cy /= points.size();
+	double mean_distance = 0;
+	for (const auto& p : points) {
+		mean_distance += std::hypot(p.x - n.cx, p.y - n.cy);
+	}
+	mean_distance /= points.size();
+	n.scale = mean_distance > 1e-12 ? std::sqrt(2.0) / mean_distance : 1.0;
+	return n;
+}
+
+// Solves the n x n system a * x = b in place (Gaussian elimination, partial pivoting)
+template <int N>
+bool solve(double (&a)[N][N], double (&b)[N], double (&x)[N]) {
+	for (int col = 0; col < N; ++col) {
+		int pivot = col;
+		for (int row = col + 1; row < N; ++row) {
+			if (std::abs(a[row][col]) > std::abs(a[pivot][col])) {
+				pivot = row;
+			}
+		}
+		if (std::abs(a[pivot][col]) < 1e-10) {
+			return false; // degenerate (e.g. collinear sample)
+		}
+		if (pivot != col) {
+			std::swap(a[pivot], a[col]);
+			std::swap(b[pivot], b[col]);
+		}
+		for (int row = col + 1; row < N; ++row) {
+			double f = a[row][col] / a[col][col];
+			for (int k = col; k < N; ++k) {
+				a[row][k] -= f * a[col][k];
+			}
+			b[row] -= f * b[col];
+		}
+	}
+	for (int row = N - 1; row >= 0; --row) {
+		double sum = b[row];
+		for (int k = row + 1; k < N; ++k) {
+			sum -= a[row][k] * x[k];
+		}
+		x[row] = sum / a[row][row];
+	}
+	return true;
+}
+
+// Least-squares affine fit through the normal equations; u and v share one 3x3 system
+bool fit_affine(const Correspondence* const* c, size_t count, Matrix3& m) {
+	double ata[3][3] = {};
+	double atu[3] = {}, atv[3] = {};
+	for (size_t i = 0; i < count; ++i) {
+		const double row[3] = {c[i]->x, c[i]->y, 1.0};
+		for (int r = 0; r < 3; ++r) {
+			for (int k = 0; k < 3; ++k) {
+				ata[r][k] += row[r] * row[k];
+			}
+			atu[r] += row[r] * c[i]->u;
+			atv[r] += row[r] * c[i]->v;
+		}
+	}
+	double ata_copy[3][3];
+	std::copy(&ata[0][0], &ata[0][0] + 9, &ata_copy[0][0]);
+	double a[3], b[3];
+	if (!solve(ata, atu, a) || !solve(ata_copy, atv, b)) {
+		return false;
+	}
+	m = {a[0], a[1], a[2], b[0], b[1], b[2], 0, 0, 1};
+	return true;
+}
+
+// Least-squares homography (h33 = 1) through the normal equations
+bool fit_homography(const Correspondence* const* c, size_t count, Matrix3& m) {
+	double ata[8][8] = {};
+	double atb[8] = {};
+	for (size_t i = 0; i < count; ++i) {
+		const Correspondence& p = *c[i];
+		const double rows[2][8] = {
+			{p.x, p.y, 1, 0, 0, 0, -p.u * p.x, -p.u * p.y},
+			{0, 0, 0, p.x, p.y, 1, -p.v * p.x, -p.v * p.y}};
+		const double rhs[2] = {p.u, p.v};
+		for (int e = 0; e < 2; ++e) {
+			for (int r = 0; r < 8; ++r) {
+				for (int k = 0; k < 8; ++k) {
+					ata[r][k] += rows[e][r] * rows[e][k];
+				}
+				atb[r] += rows[e][r] * rhs[e];
+			}
+		}
+	}
+	double h[8];
+	if (!solve(ata, atb, h)) {
+		return false;
+	}
+	m = {h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], 1};
+	return true;
+}
+
+bool fit(MotionEstimate::Model model, const Correspondence* const* c, size_t count, Matrix3& m) {
+	return model == MotionEstimate::Affine ? fit_affine(c, count, m) : fit_homography(c, count, m);
+}
+
+// Squared forward transfer error of `c` under `m`
+inline double transfer_error(const Matrix3& m, const Correspondence& c) {
+	double w = m[6] * c.x + m[7] * c.y + m[8];
+	if (std::abs(w) < 1e-12) {
+		return HUGE_VAL;
+	}
+	double du = (m[0] * c.x + m[1] * c.y + m[2]) / w - c.u;
+	double dv = (m[3] * c.x + m[4] * c.y + m[5]) / w - c.v;
+	return du * du + dv * dv;
+}
+
+size_t count_inliers(const Matrix3& m, const std::vector<Correspondence>& c, double threshold2) {
+	size_t inliers = 0;
+	for (const auto& p : c) {
+		inliers += transfer_error(m, p) <= threshold2;
+	}
+	return inliers;
+}
+
+// Hypotheses still needed so that an all-inlier sample was drawn with `confidence`
+int needed_iterations(double inlier_ratio, int sample_size, double confidence, int max_iterations) {
+	double all_inliers = std::pow(inlier_ratio, sample_size);
+	if (all_inliers >= 1.0) {
+		return 0;
+	}
+	if (all_inliers <= 0.0) {
+		return max_iterations;
+	}
+	double n = std::log(1.0 - confidence) / std::log(1.0 - all_inliers);
+	return static_cast<int>(std::min<double>(max_iterations, std::ceil(n)));
+}
+
+} // namespace
+
+MotionTracker::MotionTracker(const Params& params) : params_(params) {
+	params_.round_size = std::max(1, params_.round_size);
+}
+
+MotionTracker::FeaturesPtr MotionTracker::exchange(uint32_t source, const FeaturesPtr& features) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto& frames = history_[source];
+
+	// First frame with a sequence not below ours; the one before it is the reference
+	auto position = std::lower_bound(frames.begin(), frames.end(), features->sequence,
+		[](const FeaturesPtr& f, uint64_t sequence) { return f->sequence < sequence; });
+	FeaturesPtr reference = position == frames.begin() ? nullptr : *(position - 1);
+
+	frames.insert(position, features);
+	while (frames.size() > HISTORY_FRAMES) {
+		frames.pop_front();
+	}
+	return reference;
+}
+
+MotionEstimate MotionTracker::track(uint32_t source, uint64_t sequence,
+									const KeypointSet& keypoints,
+									const cv::Mat& descriptors) {
+	static Counter& estimated = Metrics::global().counter("extractor.motion_estimated");
+	static Counter& lost = Metrics::global().counter("extractor.motion_lost");
+
+	MotionEstimate estimate;
+	estimate.source = source;
+	estimate.sequence = sequence;
+
+	auto features = std::make_shared<Features>();
+	features->sequence = sequence;
+	features->points.reserve(keypoints.size());
+	for (size_t i = 0; i < keypoints.size(); ++i) {
+		features->points.emplace_back(keypoints.x()[i], keypoints.y()[i]);
+	}
+	features->descriptors = descriptors;
+	FeaturesPtr reference = exchange(source, features);
+	if (!reference) {
+		return estimate; // first frame of the source
+	}
+	estimate.reference_sequence = reference->sequence;
+
+	if (descriptors.empty() || reference->descriptors.empty()
+		|| descriptors.type() != reference->descriptors.type()
+		|| descriptors.cols != reference->descriptors.cols) {
+		lost.add();
+		return estimate;
+	}
+
+	// Workers already run one frame per core: match on this thread
+	BruteForceMatcher::Params matcher_params;
+	matcher_params.norm = descriptors.type() == CV_8U ? BruteForceMatcher::Norm::Hamming
+													  : BruteForceMatcher::Norm::L2;
+	matcher_params.threads = 1;
+	BruteForceMatcher matcher(matcher_params);
+	std::vector<cv::DMatch> matches = matcher.ratio_match(descriptors, reference->descriptors,
+														  params_.ratio);
+	estimate.matches = static_cast<uint32_t>(matches.size());
+
+	const int sample_size = params_.model == MotionEstimate::Affine ? 3 : 4;
+	if (matches.size() < std::max<size_t>(sample_size, params_.min_inliers)) {
+		lost.add();
+		return estimate;
+	}
+
+	// Hartley normalization keeps the normal equations well conditioned;
+	// fitting and scoring happen in normalized coordinates
+	std::vector<cv::Point2f> src_points, dst_points;
+	src_points.reserve(matches.size());
+	dst_points.reserve(matches.size());
+	for (const auto& m : matches) {
+		src_points.push_back(reference->points[m.trainIdx]);
+		dst_points.push_back(features->points[m.queryIdx]);
+	}
+	Normalization src_norm = normalization(src_points);
+	Normalization dst_norm = normalization(dst_points);
+	std::vector<Correspondence> correspondences(matches.size());
+	for (size_t i = 0; i < matches.size(); ++i) {
+		correspondences[i] = {(src_points[i].x - src_norm.cx) * src_norm.scale,
+							  (src_points[i].y - src_norm.cy) * src_norm.scale,
+							  (dst_points[i].x - dst_norm.cx) * dst_norm.scale,
+							  (dst_points[i].y - dst_norm.cy) * dst_norm.scale};
+	}
+	const double threshold = params_.threshold * dst_norm.scale;
+	const double threshold2 = threshold * threshold;
+
+	// RANSAC in rounds: samples are drawn up front (seeded per frame, so
+	// results do not depend on thread timing), then fitted and scored in parallel
+	std::mt19937 rng(static_cast<uint32_t>(sequence * 2654435761u) ^ source);
+	std::uniform_int_distribution<size_t> pick(0, correspondences.size() - 1);
+	Matrix3 best{};
+	size_t best_inliers = 0;
+	int needed = params_.max_iterations;
+	int done = 0;
+
+	std::vector<size_t> samples;
+	std::vector<Matrix3> models;
+	std::vector<size_t> scores;
+	while (done < std::min(needed, params_.max_iterations)) {
+		int round = std::min(params_.round_size, std::min(needed, params_.max_iterations) - done);
+		samples.resize(static_cast<size_t>(round) * sample_size);
+		for (int h = 0; h < round; ++h) {
+			size_t* sample = &samples[static_cast<size_t>(h) * sample_size];
+			for (int j = 0; j < sample_size; ++j) {
+				do {
+					sample[j] = pick(rng);
+				} while (std::find(sample, sample + j, sample[j]) != sample + j);
+			}
+		}
+		models.assign(round, Matrix3{});
+		scores.assign(round, 0);
+
+		cv::parallel_for_(cv::Range(0, round), [&](const cv::Range& range) {
+			const Correspondence* points[4];
+			for (int h = range.start; h < range.end; ++h) {
+				const size_t* sample = &samples[static_cast<size_t>(h) * sample_size];
+				for (int j = 0; j < sample_size; ++j) {
+					points[j] = &correspondences[sample[j]];
+				}
+				if (fit(params_.model, points, sample_size, models[h])) {
+					scores[h] = count_inliers(models[h], correspondences, threshold2);
+				}
+			}
+		});
+
+		done += round;
+		for (int h = 0; h < round; ++h) {
+			if (scores[h] > best_inliers) {
+				best_inliers = scores[h];
+				best = models[h];
+			}
+		}
+		if (best_inliers > 0) {
+			needed = needed_iterations(static_cast<double>(best_inliers) / correspondences.size(),
+									   sample_size, params_.confidence, params_.max_iterations);
+		}
+	}
+
+	// Refit on all inliers of the best hypothesis; keep it if it scores no worse
+	if (best_inliers >= static_cast<size_t>(sample_size)) {
+		std::vector<const Correspondence*> inliers;
+		inliers.reserve(best_inliers);
+		for (const auto& c : correspondences) {
+			if (transfer_error(best, c) <= threshold2) {
+				inliers.push_back(&c);
+			}
+		}
+		Matrix3 refined;
+		if (fit(params_.model, inliers.data(), inliers.size(), refined)) {
+			size_t refined_inliers = count_inliers(refined, correspondences, threshold2);
+			if (refined_inliers >= best_inliers) {
+				best = refined;
+				best_inliers = refined_inliers;
+			}
+		}
+	}
+
+	estimate.inliers = static_cast<uint32_t>(best_inliers);
+	if (best_inliers < params_.min_inliers) {
+		lost.add();
+		return estimate;
+	}
+
+	// Back to pixels: matrix = T_dst^-1 * best * T_src
+	const double s = src_norm.scale, d = dst_norm.scale;
+	const Matrix3 t_src = {s, 0, -s * src_norm.cx, 0, s, -s * src_norm.cy, 0, 0, 1};
+	const Matrix3 t_dst_inv = {1 / d, 0, dst_norm.cx, 0, 1 / d, dst_norm.cy, 0, 0, 1};
+	Matrix3 tmp{}, pixel{};
+	for (int r = 0; r < 3; ++r) {
+		for (int c = 0; c < 3; ++c) {
+			for (int k = 0; k < 3; ++k) {
+				tmp[r * 3 + c] += best[r * 3 + k] * t_src[k * 3 + c];
+			}
+		}
+	}
+	for (int r = 0; r < 3; ++r) {
+		for (int c = 0; c < 3; ++c) {
+			for (int k = 0; k < 3; ++k) {
+				pixel[r * 3 + c] += t_dst_inv[r * 3 + k] * tmp[k * 3 + c];
+			}
+		}
+	}
+	for (int i = 0; i < 9; ++i) {
+		estimate.matrix[i] = pixel[i] / pixel[8];
+	}
+	estimate.model = params_.model;
+	estimated.add();
+	return estimate;
+}
@@ -0,0 +1,67 @@
+#ifndef EXTRACTOR_MOTION_HPP
+#define EXTRACTOR_MOTION_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "KeypointSet.hpp"
+#include "Serialization.hpp" // MotionEstimate
+
+/**
+ * @brief Frame-to-frame motion stage of the extractor (--motion).
+ *
+ * Each frame is matched (BruteForceMatcher, ratio test) against the latest
+ * earlier frame of the same source, and an affine or homography model is
+ * fitted to the matches with RANSAC.
+ *
+ * Workers finish frames out of order, so a few recent frames per source
+ * are kept and the reference is the newest one with a lower sequence
+ * number; MotionEstimate::reference_sequence says which one was used.
+ *
+ * RANSAC hypotheses are drawn in rounds; each round's hypotheses are fitted
+ * and scored in parallel (cv::parallel_for_), and the number of rounds
+ * adapts to the best inlier ratio found so far.
+ *
+ * track() is thread-safe and called from every worker.
+ */
+class MotionTracker {
+public:
+	struct Params {
+		MotionEstimate::Model model = MotionEstimate::Homography;
+		float ratio = 0.8f;            // Lowe's ratio test threshold
+		double threshold = 3.0;        // inlier reprojection error, pixels
+		double confidence = 0.995;     // stop once an all-inlier sample is this likely
+		int max_iterations = 2000;     // RANSAC hypotheses
+		int round_size = 64;           // hypotheses scored in parallel per round
+		size_t min_inliers = 12;       // below this no model is reported
+	};
+
+	explicit MotionTracker(const Params& params);
+
+	MotionEstimate track(uint32_t source, uint64_t sequence,
+						 const KeypointSet& keypoints,
+						 const cv::Mat& descriptors);
+
+private:
+	struct Features {
+		uint64_t sequence;
+		std::vector<cv::Point2f> points;
+		cv::Mat descriptors;
+	};
+	using FeaturesPtr = std::shared_ptr<const Features>;
+
+	// Reference for `features` (may be null); records `features` as history
+	FeaturesPtr exchange(uint32_t source, const FeaturesPtr& features);
+
+	Params params_;
+	std::mutex mutex_;
+	std::unordered_map<uint32_t, std::deque<FeaturesPtr>> history_; // by sequence
+};
+
+#endif // EXTRACTOR_MOTION_HPP
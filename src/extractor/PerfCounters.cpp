@@ -0,0 +1,140 @@
+#include "PerfCounters.hpp"
+#include <cerrno>
+#include <cstring> // strerror
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+const uint64_t EVENT_CONFIGS[] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int open_event(uint64_t config, int group_fd) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = group_fd < 0 ? 1 : 0; // the leader starts the whole group
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+					 | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// This thread, on whatever CPU it runs
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+	fds_[0] = open_event(EVENT_CONFIGS[0], -1);
+	if (fds_[0] < 0) {
+		error_ = std::string("perf_event_open failed: ") + std::strerror(errno)
+			   + " (no hardware counters, or kernel.perf_event_paranoid above 2)";
+		return;
+	}
+	slot_[0] = opened_++;
+	for (int i = 1; i < EVENTS; ++i) {
+		fds_[i] = open_event(EVENT_CONFIGS[i], fds_[0]);
+		if (fds_[i] >= 0) {
+			slot_[i] = opened_++;
+		}
+	}
+	ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::~PerfCounters() {
+	for (int fd : fds_) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+PerfSample PerfCounters::read() const {
+	PerfSample sample;
+	if (!enabled()) {
+		return sample;
+	}
+
+	// nr, time_enabled, time_running, then one value per opened event
+	uint64_t buffer[3 + EVENTS] = {};
+	if (::read(fds_[0], buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened_) * sizeof(uint64_t))) {
+		return sample;
+	}
+	auto value = [&](int event) -> uint64_t {
+		return slot_[event] < 0 ? 0 : buffer[3 + slot_[event]];
+	};
+	sample.cycles = value(0);
+	sample.instructions = value(1);
+	sample.cache_misses = value(2);
+	sample.branch_misses = value(3);
+	sample.enabled_ns = buffer[1];
+	sample.running_ns = buffer[2];
+	return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() : error_("Hardware performance counters need Linux (perf_event_open).") {}
+
+PerfCounters::~PerfCounters() {}
+
+PerfSample PerfCounters::read() const {
+	return {};
+}
+
+#endif
+
+PerfSample PerfSample::operator-(const PerfSample& earlier) const {
+	// A failed read() returns zeros; clamp rather than wrap around
+	auto minus = [](uint64_t later, uint64_t before) { return later > before ? later - before : 0; };
+	PerfSample difference;
+	difference.cycles = minus(cycles, earlier.cycles);
+	difference.instructions = minus(instructions, earlier.instructions);
+	difference.cache_misses = minus(cache_misses, earlier.cache_misses);
+	difference.branch_misses = minus(branch_misses, earlier.branch_misses);
+	difference.enabled_ns = minus(enabled_ns, earlier.enabled_ns);
+	difference.running_ns = minus(running_ns, earlier.running_ns);
+	return difference;
+}
+
+PerfSample PerfSample::scaled() const {
+	if (running_ns == 0 || running_ns >= enabled_ns) {
+		return *this;
+	}
+	double factor = static_cast<double>(enabled_ns) / static_cast<double>(running_ns);
+	auto scale = [factor](uint64_t count) { return static_cast<uint64_t>(static_cast<double>(count) * factor); };
+	PerfSample result = *this;
+	result.cycles = scale(cycles);
+	result.instructions = scale(instructions);
+	result.cache_misses = scale(cache_misses);
+	result.branch_misses = scale(branch_misses);
+	return result;
+}
+
+PerfStage::PerfStage(const std::string& stage)
+	: cycles_(Metrics::global().counter("extractor.perf." + stage + ".cycles")),
+	  instructions_(Metrics::global().counter("extractor.perf." + stage + ".instructions")),
+	  cache_misses_(Metrics::global().counter("extractor.perf." + stage + ".cache_misses")),
+	  branch_misses_(Metrics::global().counter("extractor.perf." + stage + ".branch_misses")) {}
+
+void PerfStage::add(const PerfSample& difference) {
+	PerfSample sample = difference.scaled();
+	cycles_.add(sample.cycles);
+	instructions_.add(sample.instructions);
+	cache_misses_.add(sample.cache_misses);
+	branch_misses_.add(sample.branch_misses);
+}
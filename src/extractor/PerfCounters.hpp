@@ -0,0 +1,92 @@
+#ifndef EXTRACTOR_PERF_COUNTERS_HPP
+#define EXTRACTOR_PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "Metrics.hpp"
+
+/**
+ * @brief Raw hardware counter totals of one thread, with the time the
+ * group was enabled and actually counting (they differ when the kernel
+ * multiplexes the PMU).
+ */
+struct PerfSample {
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t cache_misses = 0;  // last-level cache misses
+	uint64_t branch_misses = 0;
+	uint64_t enabled_ns = 0;
+	uint64_t running_ns = 0;
+
+	// Counts (and times) between `earlier` and this one; never negative
+	PerfSample operator-(const PerfSample& earlier) const;
+
+	// Estimated counts over the whole enabled time, from the counted share
+	// of it; only meaningful for a difference of two samples, as the share
+	// changes from one stretch to the next
+	PerfSample scaled() const;
+};
+
+/**
+ * @brief Hardware performance counters of the calling thread, through
+ * perf_event_open (feature_extractor --perf-counters).
+ *
+ * Opens cycles, instructions, cache misses and branch misses as one group,
+ * so all four count over exactly the same instructions, in user space only
+ * (allowed up to kernel.perf_event_paranoid = 2). When the PMU has fewer
+ * free counters than that and the kernel multiplexes the group, scale the
+ * difference of two read()s (PerfSample::scaled()). Events the CPU
+ * (or hypervisor) does not offer, other than cycles, read as 0.
+ *
+ * Counts only the thread that created it: work OpenCV hands to its own
+ * pool threads (cv::parallel_for_) is not included.
+ *
+ * Linux only; elsewhere enabled() is always false.
+ */
+class PerfCounters {
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// The counters are running; otherwise read() returns zeros
+	bool enabled() const { return fds_[0] >= 0; }
+
+	// Why the counters could not be opened, if they could not
+	const std::string& error() const { return error_; }
+
+	// Raw totals since the counters were opened
+	PerfSample read() const;
+
+private:
+	static const int EVENTS = 4;
+
+	int fds_[EVENTS] = {-1, -1, -1, -1}; // [0] is the group leader (cycles)
+	int slot_[EVENTS] = {-1, -1, -1, -1}; // position in the group read, -1 if not opened
+	int opened_ = 0;
+	std::string error_;
+};
+
+/**
+ * @brief Scaled counter totals of one pipeline stage on the metrics line, e.g.
+ * extractor.perf.detect.cycles; their rates give instructions per cycle
+ * and misses per instruction of the stage.
+ */
+class PerfStage {
+public:
+	explicit PerfStage(const std::string& stage);
+
+	// Adds the counts between two samples, scaled for multiplexing
+	void add(const PerfSample& difference);
+
+private:
+	Counter& cycles_;
+	Counter& instructions_;
+	Counter& cache_misses_;
+	Counter& branch_misses_;
+};
+
+#endif // EXTRACTOR_PERF_COUNTERS_HPP
@@ -0,0 +1,328 @@
+#include "Pipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#include "opencv2/opencv.hpp"
+
+#include "Serialization.hpp"
+#include "ImageCodec.hpp"
+#include "Metrics.hpp"
+#include "AllocProfile.hpp"
+
+cv::Ptr<cv::Feature2D> create_detector(const std::string& name) {
+	if (name == "sift") {
+		return cv::SIFT::create();
+	}
+	if (name == "orb") {
+		return cv::ORB::create();
+	}
+	if (name == "akaze") {
+		return cv::AKAZE::create();
+	}
+	if (name == "brisk") {
+		return cv::BRISK::create();
+	}
+	throw std::invalid_argument("Unknown detector '" + name + "' (expected sift, orb, akaze or brisk)");
+}
+
+namespace {
+
+size_t mat_bytes(const cv::Mat& mat) {
+	return mat.total() * mat.elemSize();
+}
+
+// Per-stage instrumentation of FrameProcessor::process: hardware counters
+// (--perf-counters) and allocations (--alloc-profile)
+struct StageMetrics {
+	explicit StageMetrics(const std::string& stage)
+		: perf(stage), allocations("extractor.alloc." + stage) {}
+
+	PerfStage perf;
+	alloc_profile::Stage allocations;
+};
+
+} // namespace
+
+size_t task_bytes(const ImageTask& task) {
+	size_t bytes = task.image.msg.size();
+	for (const auto& level : task.decoded) {
+		bytes += mat_bytes(level);
+	}
+	return bytes;
+}
+
+size_t task_bytes(const ProcessedTask& result) {
+	size_t bytes = result.filename.size() + result.image.msg.size()
+				 + result.keypoints_buffer.size();
+	for (const auto& tagged : result.tagged_parts) {
+		bytes += tagged.tag.size() + tagged.payload.size();
+	}
+	return bytes;
+}
+
+FrameProcessor::FrameProcessor(const ProcessingConfig& config)
+	: config_(config), quality_meter_(config.quality) {
+	if (config_.detectors.empty()) {
+		throw std::invalid_argument("At least one detector is needed.");
+	}
+	if (config_.levels.empty()) {
+		throw std::invalid_argument("At least one pyramid level is needed.");
+	}
+	// One instance per (level, detector): jobs run concurrently
+	for (int level : config_.levels) {
+		for (const auto& name : config_.detectors) {
+			std::string tag = level == config_.levels[0] ? name : name + "@" + std::to_string(level);
+			detectors_.push_back(Detector{tag, level, create_detector(name), {}, {}, {}, {}});
+		}
+	}
+	for (const auto& preprocess : config_.preprocess) {
+		preprocessors_.push_back(preprocess.enabled() ? std::make_unique<Preprocessor>(preprocess)
+													  : nullptr);
+	}
+	max_level_ = *std::max_element(config_.levels.begin(), config_.levels.end());
+	pyramid_.resize(static_cast<size_t>(max_level_) + 1);
+	if (config_.memory) {
+		buffers_ = MemoryCharge(*config_.memory,
+								Metrics::global().gauge("extractor.worker_buffer_bytes"));
+	}
+	if (config_.perf_counters) {
+		perf_ = std::make_unique<PerfCounters>();
+		if (!perf_->enabled()) {
+			throw std::runtime_error(perf_->error());
+		}
+	}
+}
+
+bool FrameProcessor::process(ImageTask& task, ProcessedTask& result, size_t& keypoint_count) {
+	static Counter& low_quality = Metrics::global().counter("extractor.low_quality_frames");
+	static Counter& detected = Metrics::global().counter("extractor.frames_detected");
+	static Counter& detect_us = Metrics::global().counter("extractor.detect_us");
+	static Counter& detect_us_saved = Metrics::global().counter("extractor.detect_us_saved");
+	static Gauge& processing_bytes = Metrics::global().gauge("extractor.processing_bytes");
+	static Gauge& result_bytes = Metrics::global().gauge("extractor.result_queue_bytes");
+	static Counter& profiled_frames = Metrics::global().counter("extractor.alloc.frames");
+	static StageMetrics decode_stage("decode");
+	static StageMetrics pyramid_stage("pyramid");
+	static StageMetrics quality_stage("quality");
+	static StageMetrics detect_stage("detect");
+	static StageMetrics motion_stage("motion");
+	static StageMetrics serialize_stage("serialize");
+
+	task.memory.move_to(processing_bytes);
+
+	// Charges the hardware counts and allocations since the previous stage
+	// to `stage`. Allocations only count on frames that start with the
+	// profiler on, so the stage totals divide by extractor.alloc.frames
+	PerfSample perf_last = perf_ ? perf_->read() : PerfSample();
+	bool profile_allocations = alloc_profile::enabled();
+	alloc_profile::Stats allocations_last;
+	if (profile_allocations) {
+		profiled_frames.add();
+		allocations_last = alloc_profile::thread_stats();
+	}
+	auto stage_done = [&](StageMetrics& stage) {
+		if (perf_) {
+			PerfSample now = perf_->read();
+			stage.perf.add(now - perf_last);
+			perf_last = now;
+		}
+		if (profile_allocations) {
+			alloc_profile::Stats now = alloc_profile::thread_stats();
+			stage.allocations.add(now - allocations_last);
+			allocations_last = now;
+		}
+	};
+
+	// Decode image straight from the received message, unless the receiver
+	// did while it arrived. Decoded, gray and pyramid buffers are members
+	// so that frames of the same size reuse their allocations
+	if (!task.decoded.empty()) {
+		gray_ = std::move(task.decoded[0]);
+		image_.release(); // no color frame this time; don't keep the last one
+	} else {
+		if (!decode_image(task.image.data(), task.image.size, cv::IMREAD_COLOR, image_)) {
+			return false;
+		}
+		// Convert to grayscale (standard for SIFT)
+		cv::cvtColor(image_, gray_, cv::COLOR_BGR2GRAY);
+	}
+	stage_done(decode_stage);
+
+	// Preprocess the gray frame as configured for the source, then halve it
+	// down to the deepest requested level (keeping levels the receiver
+	// already built, which it only does without preprocessing)
+	int built = 0;
+	if (task.source < preprocessors_.size() && preprocessors_[task.source]) {
+		pyramid_[0] = preprocessors_[task.source]->apply(gray_);
+	} else {
+		pyramid_[0] = gray_;
+		for (; built < max_level_ && built + 1 < static_cast<int>(task.decoded.size()); ++built) {
+			pyramid_[built + 1] = std::move(task.decoded[built + 1]);
+		}
+	}
+	for (int level = built + 1; level <= max_level_; ++level) {
+		cv::pyrDown(pyramid_[level - 1], pyramid_[level]);
+	}
+
+	// The decoded images now live in (and stay with) the buffers above
+	size_t buffer_bytes = mat_bytes(image_) + mat_bytes(gray_);
+	for (int level = 0; level <= max_level_; ++level) {
+		// Level 0 is gray_ itself, or a crop view into it, unless preprocessed
+		// into a buffer of its own
+		if (level > 0 || pyramid_[0].u != gray_.u) {
+			buffer_bytes += mat_bytes(pyramid_[static_cast<size_t>(level)]);
+		}
+	}
+	buffers_.resize(buffer_bytes);
+	task.memory.resize(task.image.msg.size());
+	stage_done(pyramid_stage);
+
+	// Quality gate on a small copy of the gray frame, before the detectors
+	FrameQuality quality;
+	bool run_detectors = true;
+	if (config_.quality.mode != QualityGate::Mode::Off) {
+		quality = quality_meter_.measure(pyramid_[0]);
+		if (!quality.passed) {
+			low_quality.add();
+			run_detectors = config_.quality.mode != QualityGate::Mode::Skip;
+		}
+		stage_done(quality_stage);
+	}
+
+	// Extract keypoints (and descriptors in the same pass if requested),
+	// then keep the strongest --max-keypoints; motion only needs the first
+	// detector's descriptors
+	auto detect = [&](size_t i) {
+		Detector& detector = detectors_[i];
+		const cv::Mat& gray = pyramid_[detector.level];
+		detector.found.clear();
+		detector.descriptors.release(); // the motion tracker may still hold the last ones
+		if (config_.descriptors || (i == 0 && config_.motion)) {
+			detector.feature->detectAndCompute(gray, cv::noArray(), detector.found,
+											   detector.descriptors);
+		} else {
+			detector.feature->detect(gray, detector.found);
+		}
+
+		// From here on keypoints are handled column-wise (KeypointSet.hpp)
+		detector.keypoints.assign(detector.found);
+		if (config_.max_keypoints > 0
+			&& detector.keypoints.retain_strongest(config_.max_keypoints, &detector.kept)
+			&& !detector.descriptors.empty()) {
+			cv::Mat strongest(static_cast<int>(detector.kept.size()), detector.descriptors.cols,
+							  detector.descriptors.type());
+			for (size_t row = 0; row < detector.kept.size(); ++row) {
+				detector.descriptors.row(detector.kept[row]).copyTo(strongest.row(static_cast<int>(row)));
+			}
+			detector.descriptors = strongest;
+		}
+	};
+	if (run_detectors) {
+		auto start = std::chrono::steady_clock::now();
+		if (detectors_.size() == 1) {
+			detect(0);
+		} else {
+			cv::parallel_for_(cv::Range(0, static_cast<int>(detectors_.size())),
+				[&](const cv::Range& range) {
+					for (int i = range.start; i < range.end; ++i) {
+						detect(static_cast<size_t>(i));
+					}
+				});
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		detect_us.add(static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+		detected.add();
+	} else {
+		for (auto& detector : detectors_) {
+			detector.keypoints.clear();
+			detector.descriptors.release();
+		}
+		// Estimated from the average detection time so far
+		detect_us_saved.add(detect_us.value() / std::max<uint64_t>(1, detected.value()));
+	}
+	stage_done(detect_stage);
+	const KeypointSet& keypoints = detectors_[0].keypoints;
+	const cv::Mat& descriptors = detectors_[0].descriptors;
+	keypoint_count = keypoints.size();
+
+	MotionEstimate motion;
+	motion.source = task.source;
+	motion.sequence = task.sequence;
+	if (config_.motion && run_detectors) {
+		motion = config_.motion->track(task.source, task.sequence, keypoints, descriptors);
+		stage_done(motion_stage);
+	}
+
+	// Serialize keypoints and pack result
+	result.filename = std::move(task.filename);
+	result.image = std::move(task.image);
+	result.keypoints_buffer = serialize_keypoints(keypoints);
+	result.tagged_parts.clear();
+	if (config_.descriptors) {
+		result.tagged_parts.push_back({record::TAG_DESCRIPTORS, serialize_descriptors(descriptors)});
+	}
+	for (size_t i = 1; i < detectors_.size(); ++i) {
+		const Detector& detector = detectors_[i];
+		result.tagged_parts.push_back({record::TAG_KEYPOINTS_PREFIX + detector.name,
+									   serialize_keypoints(detector.keypoints)});
+		if (config_.descriptors) {
+			result.tagged_parts.push_back({record::TAG_DESCRIPTORS_PREFIX + detector.name,
+										   serialize_descriptors(detector.descriptors)});
+		}
+	}
+	if (config_.motion) {
+		result.tagged_parts.push_back({record::TAG_MOTION, serialize_motion(motion)});
+	}
+	if (config_.quality.mode != QualityGate::Mode::Off) {
+		result.tagged_parts.push_back({record::TAG_QUALITY, serialize_quality(quality)});
+	}
+	stage_done(serialize_stage);
+	result.memory = std::move(task.memory);
+	result.memory.resize(task_bytes(result));
+	result.memory.move_to(result_bytes);
+	return true;
+}
+
+void worker_thread(int id,
+				   ProcessingConfig config,
+				   SafeQueue<ImageTask>& work_queue,
+				   SafeQueue<ProcessedTask>& result_queue)
+{
+	static Counter& processed = Metrics::global().counter("extractor.frames_processed");
+	static Counter& decode_failures = Metrics::global().counter("extractor.decode_failures");
+
+	try {
+		FrameProcessor processor(config);
+
+		ImageTask task;
+		while (work_queue.pop(task)) {
+			// One bad frame must not take the worker down with it
+			try {
+				ProcessedTask result;
+				size_t keypoint_count = 0;
+				if (!processor.process(task, result, keypoint_count)) {
+					std::cerr << "[Worker " << id << "] Failed to decode " << task.filename << "\n";
+					decode_failures.add();
+					task.memory.reset(); // not held until the next frame arrives
+					continue;
+				}
+
+				std::cout << "[Worker " << id << "] Processed "
+						  << result.filename << " (" << keypoint_count
+						  << " keypoints)\n";
+
+				result_queue.push(std::move(result));
+				processed.add();
+			} catch (const std::exception& e) {
+				std::cerr << "[Worker " << id << "] Error: " << e.what() << "\n";
+				task.memory.reset();
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "[Worker " << id << "] Error: " << e.what() << "\n";
+	}
+}
@@ -0,0 +1,218 @@
+#ifndef EXTRACTOR_PIPELINE_HPP
+#define EXTRACTOR_PIPELINE_HPP
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opencv2/features2d.hpp"
+#include "zmq.hpp"
+
+#include "Constants.hpp"
+#include "Frame.hpp"
+#include "KeypointSet.hpp"
+#include "MemoryBudget.hpp"
+#include "Record.hpp"
+#include "EventFd.hpp"
+#include "SafeQueue.hpp"
+#include "Motion.hpp"
+#include "Quality.hpp"
+#include "Preprocess.hpp"
+#include "PerfCounters.hpp"
+
+// Shared pieces of the Feature Extractor (App 2): task types, the
+// per-frame processing, and the receiver/sender threads. main.cpp wires
+// them up either around worker threads or the coroutine pipeline.
+
+// Compressed image bytes living inside a received ZMQ message.
+// Offsets rather than pointers: small messages store their bytes inline,
+// so moving the message may move the data.
+struct ImagePayload {
+	zmq::message_t msg;
+	size_t offset = 0;
+	size_t size = 0;
+
+	const char* data() const {
+		return static_cast<const char*>(msg.data()) + offset;
+	}
+	bool is_whole_message() const {
+		return offset == 0 && size == msg.size();
+	}
+};
+
+// Work item received from generator
+struct ImageTask {
+	std::string filename;
+	ImagePayload image; // compressed image bytes
+	uint32_t source = 0;   // receiver (generator endpoint) it arrived on
+	uint64_t sequence = 0; // arrival order within the source
+	std::vector<cv::Mat> decoded; // gray pyramid decoded while its chunks arrived, if any
+	MemoryCharge memory;          // its bytes, against the memory budget
+};
+
+// Optional (tag, payload) part following the core fields (see Record.hpp)
+struct TaggedPart {
+	std::string tag;
+	std::vector<char> payload;
+};
+
+// Result item to send to logger
+struct ProcessedTask {
+	std::string filename;
+	ImagePayload image; // same compressed image
+	std::vector<char> keypoints_buffer;
+	std::vector<TaggedPart> tagged_parts;
+	MemoryCharge memory; // its bytes, against the memory budget
+};
+
+// Bytes a task holds: the received message plus any decoded images
+size_t task_bytes(const ImageTask& task);
+
+// Bytes a result holds until it is sent
+size_t task_bytes(const ProcessedTask& result);
+
+// What the workers compute for each frame
+struct ProcessingConfig {
+	std::vector<std::string> detectors = {"sift"}; // first one fills the core keypoints part
+	std::vector<int> levels = {0}; // pyramid levels (1/2^level scale) to detect on; first is the core one
+	bool descriptors = false; // also publish descriptors
+	size_t max_keypoints = 0; // per (level, detector), strongest by response kept; 0: all
+	QualityGate quality;      // blur / exposure check before detection (--quality)
+	std::vector<PreprocessConfig> preprocess; // per source (receiver id); missing: none
+	std::shared_ptr<MotionTracker> motion; // frame-to-frame motion (--motion), shared by all workers
+	std::shared_ptr<MemoryBudget> memory;  // accounting of frames and buffers; null: none
+	bool perf_counters = false; // hardware counters per stage (PerfCounters.hpp)
+};
+
+// Receiver tuning
+struct ReceiverConfig {
+	bool incremental_decode = false; // decode chunked JPEGs as they arrive (StreamingDecode.hpp)
+	int max_level = 0;               // pyramid levels to build while decoding
+	std::shared_ptr<MemoryBudget> memory; // admits received frames; null: no accounting
+	bool drop_when_full = false;     // drop, rather than wait for memory, when over budget
+};
+
+// Sender tuning
+struct BatchConfig {
+	size_t max_records = constants::BATCH_MAX_RECORDS;
+	size_t max_bytes = constants::BATCH_MAX_BYTES;
+	std::chrono::microseconds flush_timeout{constants::BATCH_FLUSH_US};
+	WireFormat wire = WireFormat::Multipart;
+};
+
+/**
+ * @brief Creates the feature detector called `name` (sift, orb, akaze, brisk).
+ * @throws std::invalid_argument for an unknown name.
+ */
+cv::Ptr<cv::Feature2D> create_detector(const std::string& name);
+
+/**
+ * @brief Decode -> grayscale -> preprocessing -> quality gate -> detectors
+ * -> capping -> serialize for one frame.
+ *
+ * Frames the receiver already decoded (ImageTask::decoded) skip the
+ * decode, and the pyramid levels that came with them.
+ *
+ * With a memory budget, the frame's charge moves from the work queue to
+ * "processing" and on to the result queue, resized to what the result
+ * holds; the decode buffers kept for the next frame are charged
+ * separately.
+ *
+ * With ProcessingConfig::perf_counters, the hardware counters of the
+ * thread that constructed it are added up per stage (decode, pyramid,
+ * quality, detect, motion, serialize) on the metrics line; so are the
+ * allocations of the same stages while alloc_profile is enabled
+ * (AllocProfile.hpp).
+ *
+ * With several detectors or pyramid levels the frame is decoded and
+ * converted once, the pyramid is built once, and the (level, detector)
+ * pairs run on it in parallel.
+ *
+ * Holds the detectors, which are not thread-safe: use one instance per
+ * thread.
+ */
+class FrameProcessor {
+public:
+	explicit FrameProcessor(const ProcessingConfig& config);
+
+	/**
+	 * @brief Processes `task` into `result`, moving the payload across.
+	 * @return false if the image could not be decoded.
+	 */
+	bool process(ImageTask& task, ProcessedTask& result, size_t& keypoint_count);
+
+private:
+	struct Detector {
+		std::string name; // tag suffix: detector, plus "@<level>" off the first level
+		int level;
+		cv::Ptr<cv::Feature2D> feature;
+		std::vector<cv::KeyPoint> found; // as the detector returns them
+		KeypointSet keypoints;           // after capping; what gets published
+		std::vector<int> kept;           // indices capping kept, for the descriptor rows
+		cv::Mat descriptors;
+	};
+
+	ProcessingConfig config_;
+	std::vector<Detector> detectors_; // first level's detectors first
+	int max_level_ = 0;
+	QualityMeter quality_meter_;
+	std::vector<std::unique_ptr<Preprocessor>> preprocessors_; // by source, null: none
+	cv::Mat image_;
+	cv::Mat gray_;
+	std::vector<cv::Mat> pyramid_; // [0] is the (preprocessed) gray frame
+	MemoryCharge buffers_;         // the image buffers above, kept between frames
+	std::unique_ptr<PerfCounters> perf_; // null unless counting per stage
+};
+
+// Worker thread: pop ImageTask -> process -> push ProcessedTask
+void worker_thread(int id,
+				   ProcessingConfig config,
+				   SafeQueue<ImageTask>& work_queue,
+				   SafeQueue<ProcessedTask>& result_queue);
+
+// Receiver thread: one SUB socket per generator endpoint -> `sink`
+void receiver_thread(int id,
+					 zmq::context_t& context,
+					 std::string endpoint,
+					 std::function<void(ImageTask&&)> sink,
+					 ReceiverConfig config);
+
+// Sender thread: result queue -> one PUB socket, woken via `results_ready`
+void sender_thread(int id,
+				   zmq::context_t& context,
+				   std::string endpoint,
+				   SafeQueue<ProcessedTask>& result_queue,
+				   EventFd& results_ready,
+				   BatchConfig config);
+
+#ifdef EXTRACTOR_COROUTINES
+/**
+ * @brief C++20 coroutine alternative to the worker threads (--pipeline=coro).
+ *
+ * A fixed pool of `num_threads` threads runs `num_coroutines` frame
+ * coroutines. Each awaits the next received frame (suspending rather than
+ * blocking a thread while none is queued), decodes, detects and serializes
+ * it on whichever pool thread resumed it, and hands the result to the
+ * sender threads.
+ */
+class CoroPipeline {
+public:
+	CoroPipeline(size_t num_threads, size_t num_coroutines,
+				 const ProcessingConfig& config,
+				 SafeQueue<ProcessedTask>& result_queue);
+	~CoroPipeline();
+
+	// Thread-safe; called from the receiver threads
+	void submit(ImageTask&& task);
+
+	size_t backlog() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl_;
+};
+#endif // EXTRACTOR_COROUTINES
+
+#endif // EXTRACTOR_PIPELINE_HPP
@@ -0,0 +1,153 @@
+#include "Preprocess.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Splits `value` on `separator`, e.g. "0:40:1280:640" on ':'
+std::vector<std::string> split(const std::string& value, char separator) {
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (true) {
+		size_t end = value.find(separator, start);
+		items.push_back(value.substr(start, end == std::string::npos ? std::string::npos : end - start));
+		if (end == std::string::npos) {
+			return items;
+		}
+		start = end + 1;
+	}
+}
+
+double to_number(const std::string& step, const std::string& value) {
+	size_t used = 0;
+	double number = 0.0;
+	try {
+		number = std::stod(value, &used);
+	} catch (const std::exception&) {
+		used = 0;
+	}
+	if (used == 0 || used != value.size()) {
+		throw std::invalid_argument("Preprocessing step '" + step + "' expects a number, got '" + value + "'");
+	}
+	return number;
+}
+
+int to_int(const std::string& step, const std::string& value) {
+	double number = to_number(step, value);
+	if (number != std::floor(number) || number < 0 || number > 1e6) {
+		throw std::invalid_argument("Preprocessing step '" + step + "' expects a size, got '" + value + "'");
+	}
+	return static_cast<int>(number);
+}
+
+} // namespace
+
+PreprocessConfig PreprocessConfig::parse(const std::string& spec) {
+	PreprocessConfig config;
+	if (spec.empty() || spec == "off") {
+		return config;
+	}
+	for (const auto& item : split(spec, ',')) {
+		size_t eq = item.find('=');
+		if (eq == std::string::npos) {
+			throw std::invalid_argument("Preprocessing step '" + item + "' needs a value (step=value)");
+		}
+		std::string step = item.substr(0, eq);
+		std::string value = item.substr(eq + 1);
+
+		if (step == "crop") {
+			auto fields = split(value, ':');
+			if (fields.size() != 4) {
+				throw std::invalid_argument("crop expects X:Y:W:H, got '" + value + "'");
+			}
+			config.crop = cv::Rect(to_int(step, fields[0]), to_int(step, fields[1]),
+								   to_int(step, fields[2]), to_int(step, fields[3]));
+			if (config.crop.width <= 0 || config.crop.height <= 0) {
+				throw std::invalid_argument("crop needs a positive width and height.");
+			}
+		} else if (step == "resize") {
+			auto fields = split(value, 'x');
+			if (fields.size() != 2) {
+				throw std::invalid_argument("resize expects WxH, got '" + value + "'");
+			}
+			config.resize = cv::Size(to_int(step, fields[0]), to_int(step, fields[1]));
+			if (config.resize.width <= 0 || config.resize.height <= 0) {
+				throw std::invalid_argument("resize needs a positive width and height.");
+			}
+		} else if (step == "denoise") {
+			config.denoise_sigma = to_number(step, value);
+			if (config.denoise_sigma < 0) {
+				throw std::invalid_argument("denoise sigma must not be negative.");
+			}
+		} else if (step == "gamma") {
+			config.gamma = to_number(step, value);
+			if (config.gamma <= 0) {
+				throw std::invalid_argument("gamma must be positive.");
+			}
+		} else if (step == "clahe") {
+			auto fields = split(value, ':');
+			if (fields.size() > 2) {
+				throw std::invalid_argument("clahe expects CLIP[:TILES], got '" + value + "'");
+			}
+			config.clahe_clip = to_number(step, fields[0]);
+			if (fields.size() == 2) {
+				config.clahe_tiles = to_int(step, fields[1]);
+			}
+			if (config.clahe_clip <= 0 || config.clahe_tiles < 1) {
+				throw std::invalid_argument("clahe needs a positive clip limit and tile count.");
+			}
+		} else {
+			throw std::invalid_argument("Unknown preprocessing step '" + step
+										+ "' (expected crop, resize, denoise, gamma or clahe)");
+		}
+	}
+	return config;
+}
+
+Preprocessor::Preprocessor(const PreprocessConfig& config) : config_(config) {
+	if (config_.gamma != 1.0) {
+		lut_.create(1, 256, CV_8U);
+		for (int i = 0; i < 256; ++i) {
+			lut_.at<uchar>(0, i) = cv::saturate_cast<uchar>(255.0 * std::pow(i / 255.0, config_.gamma));
+		}
+	}
+	if (config_.clahe_clip > 0) {
+		clahe_ = cv::createCLAHE(config_.clahe_clip, cv::Size(config_.clahe_tiles, config_.clahe_tiles));
+	}
+}
+
+cv::Mat Preprocessor::apply(const cv::Mat& gray) {
+	cv::Mat view = gray;
+
+	if (!config_.crop.empty()) {
+		cv::Rect region = config_.crop & cv::Rect(0, 0, gray.cols, gray.rows);
+		if (!region.empty()) {
+			view = gray(region);
+		}
+	}
+
+	if (!config_.resize.empty() && view.size() != config_.resize) {
+		// Area averaging when shrinking also does the anti-aliasing
+		bool shrink = config_.resize.area() < view.size().area();
+		cv::resize(view, resized_, config_.resize, 0, 0, shrink ? cv::INTER_AREA : cv::INTER_LINEAR);
+		view = resized_;
+	}
+
+	if (config_.denoise_sigma > 0) {
+		cv::GaussianBlur(view, denoised_, cv::Size(), config_.denoise_sigma);
+		view = denoised_;
+	}
+
+	if (!lut_.empty()) {
+		cv::LUT(view, lut_, mapped_);
+		view = mapped_;
+	}
+
+	if (clahe_) {
+		clahe_->apply(view, equalized_);
+		view = equalized_;
+	}
+	return view;
+}
@@ -0,0 +1,74 @@
+#ifndef EXTRACTOR_PREPROCESS_HPP
+#define EXTRACTOR_PREPROCESS_HPP
+
+#include <string>
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+/**
+ * @brief Preprocessing of the gray frame before the quality gate and the
+ * detectors (extractor --preprocess), so that sources need not be
+ * normalized before they enter the pipeline.
+ *
+ * Parsed from "step=value" items, applied in this order whatever order
+ * they are given in:
+ *
+ *   crop=X:Y:W:H       region of interest (clipped to the frame)
+ *   resize=WxH         output size
+ *   denoise=SIGMA      Gaussian smoothing
+ *   gamma=G            gray level gamma (out = 255 * (in / 255)^G)
+ *   clahe=CLIP[:TILES] contrast-limited adaptive histogram equalization
+ *
+ * e.g. "crop=0:40:1280:640,resize=640x320,clahe=2".
+ * Keypoints are reported in the coordinates of the preprocessed frame.
+ */
+struct PreprocessConfig {
+	cv::Rect crop;               // empty: whole frame
+	cv::Size resize;             // empty: keep size
+	double denoise_sigma = 0.0;  // 0: off
+	double gamma = 1.0;          // 1: off
+	double clahe_clip = 0.0;     // 0: off
+	int clahe_tiles = 8;
+
+	bool enabled() const {
+		return !crop.empty() || !resize.empty() || denoise_sigma > 0
+			|| gamma != 1.0 || clahe_clip > 0;
+	}
+
+	/**
+	 * @throws std::invalid_argument for unknown steps or bad values.
+	 */
+	static PreprocessConfig parse(const std::string& spec);
+};
+
+/**
+ * @brief Applies a PreprocessConfig, keeping its intermediate images between
+ * frames. Not thread-safe; use one per FrameProcessor.
+ *
+ * Each step costs at most one pass: the crop is a view, the gray level
+ * mapping is one 256-entry lookup table, and steps that are off are not
+ * run at all.
+ */
+class Preprocessor {
+public:
+	explicit Preprocessor(const PreprocessConfig& config);
+
+	/**
+	 * @brief Preprocessed copy of `gray` (CV_8UC1). The result may share
+	 * data with `gray` or with this object's buffers, so it is only valid
+	 * until the next call.
+	 */
+	cv::Mat apply(const cv::Mat& gray);
+
+private:
+	PreprocessConfig config_;
+	cv::Mat lut_;
+	cv::Ptr<cv::CLAHE> clahe_;
+	cv::Mat resized_;
+	cv::Mat denoised_;
+	cv::Mat mapped_;
+	cv::Mat equalized_;
+};
+
+#endif // EXTRACTOR_PREPROCESS_HPP
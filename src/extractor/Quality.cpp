@@ -0,0 +1,56 @@
+#include "Quality.hpp"
+
+#include <algorithm>
+
+#include "opencv2/imgproc.hpp"
+
+namespace {
+
+// Gray levels counted as nearly black / nearly white
+const int DARK_LEVEL = 16;
+const int BRIGHT_LEVEL = 240;
+
+} // namespace
+
+FrameQuality QualityMeter::measure(const cv::Mat& gray) {
+	// Blur and exposure survive downsampling, and the sample keeps the
+	// cost independent of the frame size
+	const cv::Mat* sample = &gray;
+	if (gray.cols > gate_.sample_width) {
+		int rows = std::max(1, gray.rows * gate_.sample_width / gray.cols);
+		cv::resize(gray, sample_, cv::Size(gate_.sample_width, rows), 0, 0, cv::INTER_AREA);
+		sample = &sample_;
+	}
+
+	FrameQuality quality;
+
+	cv::Laplacian(*sample, laplacian_, CV_16S);
+	cv::Scalar mean, stddev;
+	cv::meanStdDev(laplacian_, mean, stddev);
+	quality.sharpness = static_cast<float>(stddev[0] * stddev[0]);
+
+	size_t histogram[256] = {};
+	for (int y = 0; y < sample->rows; ++y) {
+		const uchar* row = sample->ptr<uchar>(y);
+		for (int x = 0; x < sample->cols; ++x) {
+			++histogram[row[x]];
+		}
+	}
+	double total = static_cast<double>(sample->total());
+	double sum = 0;
+	size_t dark = 0, bright = 0;
+	for (int level = 0; level < 256; ++level) {
+		sum += static_cast<double>(level) * histogram[level];
+		dark += level < DARK_LEVEL ? histogram[level] : 0;
+		bright += level >= BRIGHT_LEVEL ? histogram[level] : 0;
+	}
+	quality.brightness = static_cast<float>(sum / total);
+	quality.dark_fraction = static_cast<float>(dark / total);
+	quality.bright_fraction = static_cast<float>(bright / total);
+
+	quality.passed = quality.sharpness >= gate_.min_sharpness
+		&& quality.brightness >= gate_.min_brightness
+		&& quality.brightness <= gate_.max_brightness
+		&& quality.dark_fraction + quality.bright_fraction <= gate_.max_clipped;
+	return quality;
+}
@@ -0,0 +1,47 @@
+#ifndef EXTRACTOR_QUALITY_HPP
+#define EXTRACTOR_QUALITY_HPP
+
+#include "opencv2/core.hpp"
+
+#include "Constants.hpp"
+#include "Serialization.hpp" // FrameQuality
+
+/**
+ * @brief Quality gate of the extractor (--quality): thresholds and what to
+ * do with frames that miss them.
+ *
+ * - Flag: detect as usual, and publish the measures with the record.
+ * - Skip: publish the record without running the detectors (empty
+ *   keypoints), saving their time on blurry or badly exposed frames.
+ */
+struct QualityGate {
+	enum class Mode { Off, Flag, Skip };
+
+	Mode mode = Mode::Off;
+	double min_sharpness = constants::QUALITY_MIN_SHARPNESS;
+	double min_brightness = constants::QUALITY_MIN_BRIGHTNESS;
+	double max_brightness = constants::QUALITY_MAX_BRIGHTNESS;
+	double max_clipped = constants::QUALITY_MAX_CLIPPED;
+	int sample_width = constants::QUALITY_SAMPLE_WIDTH;
+};
+
+/**
+ * @brief Measures sharpness (variance of the Laplacian) and exposure (gray
+ * level histogram) on a downsampled copy of the gray frame.
+ *
+ * Keeps its scratch images between frames; not thread-safe, use one per
+ * FrameProcessor.
+ */
+class QualityMeter {
+public:
+	explicit QualityMeter(const QualityGate& gate) : gate_(gate) {}
+
+	FrameQuality measure(const cv::Mat& gray);
+
+private:
+	QualityGate gate_;
+	cv::Mat sample_;
+	cv::Mat laplacian_;
+};
+
+#endif // EXTRACTOR_QUALITY_HPP
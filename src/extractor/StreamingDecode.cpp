@@ -0,0 +1,328 @@
+#include "StreamingDecode.hpp"
+
+#include <algorithm>
+
+#include "opencv2/imgproc.hpp"
+
+#ifdef EXTRACTOR_LIBJPEG
+
+#include <csetjmp>
+#include <cstdio> // jpeglib.h needs FILE
+#include <jpeglib.h>
+#include <jerror.h>
+
+namespace {
+
+// Level rows computable from `available` rows of a level `height` rows
+// high: output row k of pyrDown reads input rows 2k-2 .. 2k+2
+int halved_rows_ready(int available, int height) {
+	if (available >= height) {
+		return (height + 1) / 2;
+	}
+	return std::max(0, (available - 1) / 2);
+}
+
+// Extends `dst` = pyrDown(`src`) from `done` rows to as many rows as the
+// `available` rows of `src` allow; returns the rows of `dst` now ready.
+// Each band is pyrDown on a slice with two extra input rows at the top,
+// whose first output row (and last, unless the slice ends at the bottom
+// of `src`) sees the slice border and is dropped.
+int extend_level(const cv::Mat& src, int available, cv::Mat& dst, int done) {
+	int ready = halved_rows_ready(available, src.rows);
+	if (ready <= done) {
+		return done;
+	}
+	int start = std::max(0, 2 * done - 2);
+	int end = available >= src.rows ? src.rows : std::min(src.rows, 2 * ready + 1);
+	cv::Mat band;
+	cv::pyrDown(src.rowRange(start, end), band);
+	int first = done - start / 2;
+	band.rowRange(first, first + ready - done).copyTo(dst.rowRange(done, ready));
+	return ready;
+}
+
+// Scanlines read per jpeg_read_scanlines() call
+const int BAND_ROWS = 16;
+
+struct ErrorManager {
+	jpeg_error_mgr pub;
+	std::jmp_buf jump;
+};
+
+void error_exit(j_common_ptr cinfo) {
+	std::longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+}
+
+// Corrupt-data warnings; the frame still decodes, as with cv::imdecode
+void output_message(j_common_ptr) {}
+
+// Suspending source over the received prefix of the file
+struct SourceManager {
+	jpeg_source_mgr pub;
+	bool complete = false; // the prefix is the whole file
+	size_t skip = 0;       // bytes libjpeg skipped past the end of the prefix
+};
+
+const JOCTET FAKE_EOI[2] = {0xFF, JPEG_EOI};
+
+void init_source(j_decompress_ptr) {}
+
+boolean fill_input_buffer(j_decompress_ptr cinfo) {
+	SourceManager* source = reinterpret_cast<SourceManager*>(cinfo->src);
+	if (!source->complete) {
+		return FALSE; // suspend until more bytes arrive
+	}
+	// Truncated file: end it like libjpeg's stdio source does
+	WARNMS(cinfo, JWRN_JPEG_EOF);
+	source->pub.next_input_byte = FAKE_EOI;
+	source->pub.bytes_in_buffer = sizeof(FAKE_EOI);
+	return TRUE;
+}
+
+void skip_input_data(j_decompress_ptr cinfo, long num_bytes) {
+	SourceManager* source = reinterpret_cast<SourceManager*>(cinfo->src);
+	if (num_bytes <= 0) {
+		return;
+	}
+	size_t n = static_cast<size_t>(num_bytes);
+	if (n <= source->pub.bytes_in_buffer) {
+		source->pub.next_input_byte += n;
+		source->pub.bytes_in_buffer -= n;
+	} else {
+		// Finish the skip once the bytes arrive
+		source->skip += n - source->pub.bytes_in_buffer;
+		source->pub.next_input_byte += source->pub.bytes_in_buffer;
+		source->pub.bytes_in_buffer = 0;
+	}
+}
+
+void term_source(j_decompress_ptr) {}
+
+} // namespace
+
+struct StreamingJpegDecoder::Impl {
+	enum class Stage { Header, Start, Scanlines, Done, Failed };
+
+	jpeg_decompress_struct cinfo;
+	ErrorManager error;
+	SourceManager source;
+	Stage stage = Stage::Header;
+	size_t fed = 0; // prefix size given to libjpeg last time
+
+	int max_level;
+	cv::Mat band;                  // color scanlines before the gray conversion
+	std::vector<cv::Mat> pyramid;  // [0] gray frame
+	std::vector<int> rows;         // rows ready per level
+
+	explicit Impl(int levels) : max_level(levels) {
+		cinfo.err = jpeg_std_error(&error.pub);
+		error.pub.error_exit = error_exit;
+		error.pub.output_message = output_message;
+		jpeg_create_decompress(&cinfo);
+
+		source.pub.init_source = init_source;
+		source.pub.fill_input_buffer = fill_input_buffer;
+		source.pub.skip_input_data = skip_input_data;
+		source.pub.resync_to_restart = jpeg_resync_to_restart;
+		source.pub.term_source = term_source;
+		source.pub.next_input_byte = nullptr;
+		source.pub.bytes_in_buffer = 0;
+		cinfo.src = &source.pub;
+	}
+
+	~Impl() {
+		jpeg_destroy_decompress(&cinfo);
+	}
+
+	// Runs libjpeg as far as the input allows. Errors longjmp back into
+	// feed(), so nothing here may own resources across a libjpeg call.
+	void decode() {
+		if (stage == Stage::Header) {
+			if (jpeg_read_header(&cinfo, TRUE) == JPEG_SUSPENDED) {
+				return;
+			}
+			if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+				stage = Stage::Failed;
+				return;
+			}
+			if (cinfo.num_components == 1) {
+				cinfo.out_color_space = JCS_GRAYSCALE;
+			} else {
+#ifdef JCS_EXTENSIONS
+				cinfo.out_color_space = JCS_EXT_BGR;
+#else
+				cinfo.out_color_space = JCS_RGB;
+#endif
+			}
+			stage = Stage::Start;
+		}
+
+		if (stage == Stage::Start) {
+			if (!jpeg_start_decompress(&cinfo)) {
+				return;
+			}
+			int width = static_cast<int>(cinfo.output_width);
+			int height = static_cast<int>(cinfo.output_height);
+			pyramid.assign(static_cast<size_t>(max_level) + 1, cv::Mat());
+			rows.assign(pyramid.size(), 0);
+			pyramid[0].create(height, width, CV_8UC1);
+			for (size_t level = 1; level < pyramid.size(); ++level) {
+				const cv::Mat& above = pyramid[level - 1];
+				pyramid[level].create((above.rows + 1) / 2, (above.cols + 1) / 2, CV_8UC1);
+			}
+			if (cinfo.output_components != 1) {
+				band.create(BAND_ROWS, width, CV_8UC3);
+			}
+			stage = Stage::Scanlines;
+		}
+
+		cv::Mat& gray = pyramid[0];
+		while (cinfo.output_scanline < cinfo.output_height) {
+			int first = static_cast<int>(cinfo.output_scanline);
+			int count = std::min(BAND_ROWS, gray.rows - first);
+			JSAMPROW lines[BAND_ROWS];
+			for (int i = 0; i < count; ++i) {
+				lines[i] = band.empty() ? gray.ptr<JSAMPLE>(first + i) : band.ptr<JSAMPLE>(i);
+			}
+			JDIMENSION read = jpeg_read_scanlines(&cinfo, lines, static_cast<JDIMENSION>(count));
+			if (read == 0) {
+				return;
+			}
+			if (!band.empty()) {
+#ifdef JCS_EXTENSIONS
+				cv::cvtColor(band.rowRange(0, static_cast<int>(read)),
+							 gray.rowRange(first, first + static_cast<int>(read)), cv::COLOR_BGR2GRAY);
+#else
+				cv::cvtColor(band.rowRange(0, static_cast<int>(read)),
+							 gray.rowRange(first, first + static_cast<int>(read)), cv::COLOR_RGB2GRAY);
+#endif
+			}
+		}
+		// Trailing markers are of no interest
+		jpeg_abort_decompress(&cinfo);
+		stage = Stage::Done;
+	}
+
+	void extend_pyramid() {
+		if (pyramid.empty()) {
+			return;
+		}
+		rows[0] = static_cast<int>(cinfo.output_scanline);
+		if (stage == Stage::Done) {
+			rows[0] = pyramid[0].rows;
+		}
+		for (size_t level = 1; level < pyramid.size(); ++level) {
+			rows[level] = extend_level(pyramid[level - 1], rows[level - 1], pyramid[level], rows[level]);
+		}
+	}
+};
+
+StreamingJpegDecoder::StreamingJpegDecoder(int max_level)
+	: impl_(std::make_unique<Impl>(std::max(0, max_level))) {}
+
+StreamingJpegDecoder::~StreamingJpegDecoder() = default;
+
+bool StreamingJpegDecoder::available() {
+	return true;
+}
+
+bool StreamingJpegDecoder::feed(const char* data, size_t size, bool complete) {
+	Impl& s = *impl_;
+	if (s.stage == Impl::Stage::Failed) {
+		return false;
+	}
+	if (s.stage == Impl::Stage::Done) {
+		return true;
+	}
+
+	// Point libjpeg past what it consumed of the previous prefix, plus any
+	// skip it could not finish then
+	size_t next = s.fed - s.source.pub.bytes_in_buffer + s.source.skip;
+	s.source.skip = next > size ? next - size : 0;
+	next = std::min(next, size);
+	s.source.pub.next_input_byte = reinterpret_cast<const JOCTET*>(data) + next;
+	s.source.pub.bytes_in_buffer = size - next;
+	s.source.complete = complete;
+	s.fed = size;
+
+	if (setjmp(s.error.jump)) {
+		jpeg_abort_decompress(&s.cinfo);
+		s.stage = Impl::Stage::Failed;
+		return false;
+	}
+	s.decode();
+	if (s.stage == Impl::Stage::Failed) {
+		jpeg_abort_decompress(&s.cinfo);
+		return false;
+	}
+	s.extend_pyramid();
+	if (complete && s.stage != Impl::Stage::Done) {
+		s.stage = Impl::Stage::Failed;
+		return false;
+	}
+	return true;
+}
+
+bool StreamingJpegDecoder::done() const {
+	const Impl& s = *impl_;
+	return s.stage == Impl::Stage::Done && !s.pyramid.empty()
+		&& s.rows.back() == s.pyramid.back().rows;
+}
+
+int StreamingJpegDecoder::rows_decoded() const {
+	return impl_->rows.empty() ? 0 : impl_->rows[0];
+}
+
+size_t StreamingJpegDecoder::buffer_bytes() const {
+	size_t bytes = impl_->band.total() * impl_->band.elemSize();
+	for (const auto& level : impl_->pyramid) {
+		bytes += level.total() * level.elemSize();
+	}
+	return bytes;
+}
+
+std::vector<cv::Mat> StreamingJpegDecoder::take_pyramid() {
+	std::vector<cv::Mat> pyramid = std::move(impl_->pyramid);
+	impl_->pyramid.clear();
+	impl_->rows.clear();
+	return pyramid;
+}
+
+#else // !EXTRACTOR_LIBJPEG
+
+struct StreamingJpegDecoder::Impl {};
+
+StreamingJpegDecoder::StreamingJpegDecoder(int) {}
+
+StreamingJpegDecoder::~StreamingJpegDecoder() = default;
+
+bool StreamingJpegDecoder::available() {
+	return false;
+}
+
+bool StreamingJpegDecoder::feed(const char*, size_t, bool) {
+	return false;
+}
+
+bool StreamingJpegDecoder::done() const {
+	return false;
+}
+
+int StreamingJpegDecoder::rows_decoded() const {
+	return 0;
+}
+
+size_t StreamingJpegDecoder::buffer_bytes() const {
+	return 0;
+}
+
+std::vector<cv::Mat> StreamingJpegDecoder::take_pyramid() {
+	return {};
+}
+
+#endif // EXTRACTOR_LIBJPEG
+
+bool StreamingJpegDecoder::is_jpeg(const char* data, size_t size) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	return size >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF;
+}
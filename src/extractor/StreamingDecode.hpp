@@ -0,0 +1,72 @@
+#ifndef EXTRACTOR_STREAMING_DECODE_HPP
+#define EXTRACTOR_STREAMING_DECODE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+/**
+ * @brief Decodes a JPEG while its bytes are still arriving, for images
+ * sent in chunks (see Chunk.hpp, feature_extractor --incremental-decode).
+ *
+ * Each feed() passes the received prefix of the file so far; libjpeg runs
+ * with a suspending data source, decodes every scanline the prefix allows
+ * and returns when it runs out of bytes. The rows are converted to gray
+ * (as cvtColor(BGR2GRAY) on the decoded frame) and, band by band, halved
+ * into pyramid levels 1..max_level as soon as the rows each output row
+ * depends on are there, giving the same rows as cv::pyrDown on the whole
+ * level. By the time the last chunk arrives only its own rows are left
+ * to decode, and the detectors can start right away.
+ *
+ * Progressive JPEGs produce no rows until the whole file is in, so they
+ * gain nothing but still decode. CMYK JPEGs, and decoding errors, make
+ * feed() return false; the frame is then decoded whole as usual.
+ *
+ * Needs libjpeg (EXTRACTOR_LIBJPEG); see available().
+ */
+class StreamingJpegDecoder {
+public:
+	explicit StreamingJpegDecoder(int max_level = 0);
+	~StreamingJpegDecoder();
+
+	StreamingJpegDecoder(const StreamingJpegDecoder&) = delete;
+	StreamingJpegDecoder& operator=(const StreamingJpegDecoder&) = delete;
+
+	// True if this build can decode incrementally
+	static bool available();
+
+	// True if `data` starts like a JPEG file (needs at least 3 bytes)
+	static bool is_jpeg(const char* data, size_t size);
+
+	/**
+	 * @brief Decodes what the first `size` bytes of the file allow.
+	 *
+	 * `data` may move between calls (the prefix must not change) and
+	 * `size` must not shrink. Pass `complete` with the whole file.
+	 * @return false if the image cannot be decoded this way.
+	 */
+	bool feed(const char* data, size_t size, bool complete);
+
+	// All rows of all levels are decoded
+	bool done() const;
+
+	// Rows of level 0 decoded so far
+	int rows_decoded() const;
+
+	// Bytes of the images it holds (pyramid and scanline band)
+	size_t buffer_bytes() const;
+
+	/**
+	 * @brief The gray frame and its halvings, [0] full size; moved out, so
+	 * only call once done().
+	 */
+	std::vector<cv::Mat> take_pyramid();
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl_;
+};
+
+#endif // EXTRACTOR_STREAMING_DECODE_HPP
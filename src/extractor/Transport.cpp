@@ -0,0 +1,490 @@
+#include "Pipeline.hpp"
+
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+
+#include "Batch.hpp"
+#include "Chunk.hpp"
+#include "Constants.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "StreamingDecode.hpp"
+
+namespace {
+
+RecordView record_parts(const ProcessedTask& result) {
+	RecordView parts = {
+		PartView{result.filename.data(), result.filename.size()},
+		PartView{result.image.data(), result.image.size},
+		PartView{result.keypoints_buffer.data(), result.keypoints_buffer.size()}
+	};
+	for (const auto& tagged : result.tagged_parts) {
+		parts.push_back(PartView{tagged.tag.data(), tagged.tag.size()});
+		parts.push_back(PartView{tagged.payload.data(), tagged.payload.size()});
+	}
+	return parts;
+}
+
+// Publishes one result as the classic 3-part message
+void send_multipart(zmq::socket_t& publisher, ProcessedTask& result) {
+	// Part 1: filename
+	zmq::message_t name_msg(result.filename.begin(), result.filename.end());
+
+	// Part 3: keypoints buffer
+	zmq::message_t kps_msg(result.keypoints_buffer.data(),
+						   result.keypoints_buffer.size());
+
+	publisher.send(name_msg, zmq::send_flags::sndmore);
+
+	// Part 2: image buffer, handed back to ZMQ without a copy when we
+	// received it as its own part
+	if (result.image.is_whole_message()) {
+		publisher.send(result.image.msg, zmq::send_flags::sndmore);
+	} else {
+		zmq::message_t img_msg(result.image.data(), result.image.size);
+		publisher.send(img_msg, zmq::send_flags::sndmore);
+	}
+
+	if (result.tagged_parts.empty()) {
+		publisher.send(kps_msg,  zmq::send_flags::none);
+		return;
+	}
+	publisher.send(kps_msg,  zmq::send_flags::sndmore);
+
+	// Parts 4+: optional (tag, payload) pairs
+	for (size_t i = 0; i < result.tagged_parts.size(); ++i) {
+		const TaggedPart& tagged = result.tagged_parts[i];
+		zmq::message_t tag_msg(tagged.tag.begin(), tagged.tag.end());
+		zmq::message_t payload_msg(tagged.payload.data(), tagged.payload.size());
+		publisher.send(tag_msg, zmq::send_flags::sndmore);
+		publisher.send(payload_msg, i + 1 < result.tagged_parts.size()
+									? zmq::send_flags::sndmore : zmq::send_flags::none);
+	}
+}
+
+// Publishes one result as a single contiguous frame
+void send_frame(zmq::socket_t& publisher, const ProcessedTask& result) {
+	RecordView parts = record_parts(result);
+	zmq::message_t frame_msg(framed_size(parts));
+	encode_frame_into(parts, frame_msg.data());
+	publisher.send(frame_msg, zmq::send_flags::none);
+}
+
+size_t record_bytes(const ProcessedTask& result) {
+	size_t bytes = result.filename.size() + result.image.size
+				 + result.keypoints_buffer.size();
+	for (const auto& tagged : result.tagged_parts) {
+		bytes += tagged.tag.size() + tagged.payload.size();
+	}
+	return bytes;
+}
+
+// Charges a frame of `bytes` to the memory budget, waiting for room only
+// if `may_wait` (and the config says to wait); false if it was refused
+bool acquire_memory(const ReceiverConfig& config, size_t bytes, bool may_wait) {
+	static Counter& waits = Metrics::global().counter("extractor.memory_waits");
+	static Counter& dropped = Metrics::global().counter("extractor.frames_dropped_memory");
+
+	if (config.drop_when_full || !may_wait) {
+		if (!config.memory->try_acquire(bytes)) {
+			dropped.add();
+			return false;
+		}
+	} else if (!config.memory->acquire(bytes)) {
+		waits.add(); // the receiver stalled; the generator's socket buffers meanwhile
+	}
+	return true;
+}
+
+// A chunked image in assembly: its charge (the image buffer, plus the
+// decoder's images with incremental decode) and its JPEG decoder
+struct ChunkTransfer {
+	MemoryCharge memory;
+	size_t image_bytes = 0;
+	std::unique_ptr<StreamingJpegDecoder> decoder;
+};
+
+// Chunked images in assembly on one receiver
+struct ChunkReceiver {
+	using Clock = std::chrono::steady_clock;
+
+	ChunkAssembler assembler;
+	ReceiverConfig config;
+	std::unordered_map<uint64_t, ChunkTransfer> transfers; // what `assembler` has in flight
+	std::unordered_map<uint64_t, Clock::time_point> refused; // over budget: skip their chunks
+
+	explicit ChunkReceiver(const ReceiverConfig& receiver_config)
+		: assembler(constants::CHUNK_MAX_TRANSFERS, constants::CHUNK_MAX_IMAGE_BYTES,
+					std::chrono::milliseconds(constants::CHUNK_TIMEOUT_MS)),
+		  config(receiver_config) {}
+
+	// Gives up timed-out transfers, returning their memory; for when no
+	// chunks arrive to do it
+	void expire() {
+		static Counter& transfers_dropped = Metrics::global().counter("extractor.chunk_transfers_dropped");
+
+		uint64_t dropped_before = assembler.dropped();
+		assembler.expire();
+		transfers_dropped.add(assembler.dropped() - dropped_before);
+		prune();
+	}
+
+	// Drops the state of transfers the assembler gave up on, and
+	// forgets refusals once their chunks have stopped coming
+	void prune() {
+		for (auto it = transfers.begin(); it != transfers.end();) {
+			if (assembler.has(it->first)) {
+				++it;
+			} else {
+				it = transfers.erase(it);
+			}
+		}
+		Clock::time_point stale = Clock::now() - std::chrono::milliseconds(constants::CHUNK_TIMEOUT_MS);
+		for (auto it = refused.begin(); it != refused.end();) {
+			if (it->second < stale) {
+				it = refused.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+};
+
+// Charges a received frame to the memory budget, waiting for room or
+// dropping it when over budget; false if it was dropped. Chunked frames
+// were charged when their first chunk came in. As for new transfers, only
+// waits while no image is in assembly here: only this thread can complete
+// or expire those and free their memory
+bool admit(ChunkReceiver& chunks, ImageTask& task) {
+	static Gauge& queued_bytes = Metrics::global().gauge("extractor.work_queue_bytes");
+
+	const ReceiverConfig& config = chunks.config;
+	if (!config.memory || !task.memory.empty()) {
+		return true;
+	}
+	size_t bytes = task_bytes(task);
+	if (!acquire_memory(config, bytes, chunks.transfers.empty())) {
+		return false;
+	}
+	task.memory = MemoryCharge(*config.memory, queued_bytes, bytes);
+	return true;
+}
+
+// Admits a new chunked image to the memory budget before its buffer is
+// allocated; false if it was refused. Only waits for room when no other
+// image is in assembly here: those can only be completed (and their
+// memory freed) by this very thread
+bool admit_transfer(ChunkReceiver& chunks, const ChunkView& chunk) {
+	static Gauge& chunk_bytes = Metrics::global().gauge("extractor.chunk_bytes");
+
+	ChunkTransfer transfer;
+	transfer.image_bytes = static_cast<size_t>(chunk.total_size);
+	if (chunks.config.memory && chunk.total_size <= constants::CHUNK_MAX_IMAGE_BYTES) {
+		if (!acquire_memory(chunks.config, transfer.image_bytes, chunks.transfers.empty())) {
+			chunks.refused[chunk.transfer_id] = ChunkReceiver::Clock::now();
+			return false;
+		}
+		transfer.memory = MemoryCharge(*chunks.config.memory, chunk_bytes, transfer.image_bytes);
+	}
+	chunks.transfers[chunk.transfer_id] = std::move(transfer);
+	return true;
+}
+
+// Decodes what has arrived of a chunked JPEG; on completion hands the
+// decoded pyramid to `task` if all went well
+void decode_chunked(ChunkReceiver& chunks, uint64_t transfer_id, ChunkTransfer& transfer,
+					bool complete, ImageTask& task) {
+	static Counter& incremental = Metrics::global().counter("extractor.incremental_decodes");
+	static Counter& fallbacks = Metrics::global().counter("extractor.incremental_decode_fallbacks");
+
+	const char* data = nullptr;
+	uint64_t contiguous = 0;
+	if (complete) {
+		data = task.image.data();
+		contiguous = task.image.size;
+	} else if (!chunks.assembler.prefix(transfer_id, data, contiguous)) {
+		return;
+	}
+
+	if (!transfer.decoder) {
+		if (!StreamingJpegDecoder::is_jpeg(data, contiguous)) {
+			return; // not a JPEG, or its first chunk is still missing
+		}
+		transfer.decoder = std::make_unique<StreamingJpegDecoder>(chunks.config.max_level);
+	}
+
+	bool ok = transfer.decoder->feed(data, contiguous, complete);
+	if (!complete) {
+		transfer.memory.resize(transfer.image_bytes + transfer.decoder->buffer_bytes());
+		return;
+	}
+	if (ok && transfer.decoder->done()) {
+		task.decoded = transfer.decoder->take_pyramid();
+		incremental.add();
+	} else {
+		fallbacks.add(); // the worker decodes the whole image instead
+	}
+	transfer.decoder.reset();
+}
+
+// Copies a chunk into its image; true (with `task` filled in) once the
+// image is complete
+bool add_chunk(ChunkReceiver& chunks, const zmq::message_t& chunk_msg,
+			   int id, ImageTask& task) {
+	static Counter& chunks_in = Metrics::global().counter("extractor.chunks_in");
+	static Counter& chunked_frames = Metrics::global().counter("extractor.chunked_frames");
+	static Counter& transfers_dropped = Metrics::global().counter("extractor.chunk_transfers_dropped");
+	static Gauge& queued_bytes = Metrics::global().gauge("extractor.work_queue_bytes");
+
+	chunks_in.add();
+	uint64_t dropped_before = chunks.assembler.dropped();
+	bool complete = false;
+	try {
+		ChunkView chunk = decode_chunk(chunk_msg.data(), chunk_msg.size());
+		chunks.assembler.expire(); // before deciding whether the chunk starts a transfer
+		if (!chunks.assembler.has(chunk.transfer_id)) {
+			if (chunks.refused.count(chunk.transfer_id) != 0 || !admit_transfer(chunks, chunk)) {
+				chunks.prune();
+				return false;
+			}
+		}
+		complete = chunks.assembler.add(chunk, task.filename, task.image.msg);
+
+		auto transfer = chunks.transfers.find(chunk.transfer_id);
+		if (transfer != chunks.transfers.end()) {
+			if (complete) {
+				task.image.offset = 0;
+				task.image.size = task.image.msg.size();
+			}
+			if (chunks.config.incremental_decode) {
+				decode_chunked(chunks, chunk.transfer_id, transfer->second, complete, task);
+			}
+			if (complete) {
+				// The frame keeps the charge, now for the image and its pyramid
+				task.memory = std::move(transfer->second.memory);
+				task.memory.resize(task_bytes(task));
+				task.memory.move_to(queued_bytes);
+				chunks.transfers.erase(transfer);
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "[Receiver " << id << "] Warning: bad chunk: " << e.what() << "\n";
+	}
+
+	uint64_t dropped = chunks.assembler.dropped() - dropped_before;
+	if (dropped > 0) {
+		transfers_dropped.add(dropped);
+	}
+	chunks.prune();
+	if (!complete) {
+		return false;
+	}
+	chunked_frames.add();
+	return true;
+}
+
+// Turns a received generator message (whose first part is `first_msg`)
+// into `task`; returns false if it was malformed and should be skipped, or
+// was a chunk of an image that is not complete yet
+bool parse_task(zmq::socket_t& subscriber, zmq::message_t& first_msg,
+				ChunkReceiver& chunks, int id, ImageTask& task) {
+	if (!subscriber.get(zmq::sockopt::rcvmore)) {
+		if (is_chunk(first_msg.data(), first_msg.size())) {
+			return add_chunk(chunks, first_msg, id, task);
+		}
+		if (!is_frame(first_msg.data(), first_msg.size())) {
+			std::cerr << "[Receiver " << id << "] Warning: expected 2 parts, got 1. Skipping.\n";
+			return false;
+		}
+
+		// Parse the frame in place; the message itself becomes the payload
+		RecordView parts;
+		try {
+			parts = decode_frame(first_msg.data(), first_msg.size());
+		} catch (const std::exception& e) {
+			std::cerr << "[Receiver " << id << "] Warning: bad frame: " << e.what() << "\n";
+			return false;
+		}
+		if (parts.size() != 2) {
+			std::cerr << "[Receiver " << id << "] Warning: expected 2 parts in frame, got "
+					  << parts.size() << ". Skipping.\n";
+			return false;
+		}
+
+		task.filename.assign(parts[0].data, parts[0].size);
+		task.image.offset = parts[1].data - static_cast<const char*>(first_msg.data());
+		task.image.size = parts[1].size;
+		task.image.msg = std::move(first_msg);
+		return true;
+	}
+
+	// Receive Part 2: Image buffer (the rest of a multipart message is
+	// always available once its first part is)
+	zmq::message_t img_msg;
+	auto recv_img = subscriber.recv(img_msg);
+	if (!recv_img.has_value()) { return false; }
+
+	// Check that this is the last part
+	if (subscriber.get(zmq::sockopt::rcvmore)) {
+		std::cerr << "[Receiver " << id << "] Warning: received >2 parts. Flushing extras.\n";
+		zmq::message_t temp;
+		while (subscriber.get(zmq::sockopt::rcvmore)) {
+			subscriber.recv(temp);
+		}
+		return false;
+	}
+
+	task.filename = first_msg.to_string();
+	task.image.offset = 0;
+	task.image.size = img_msg.size();
+	task.image.msg = std::move(img_msg);
+	return true;
+}
+
+} // namespace
+
+void sender_thread(int id,
+				   zmq::context_t& context,
+				   std::string endpoint,
+				   SafeQueue<ProcessedTask>& result_queue,
+				   EventFd& results_ready,
+				   BatchConfig config)
+{
+	static Counter& records_sent = Metrics::global().counter("extractor.records_sent");
+	static Counter& batches_sent = Metrics::global().counter("extractor.batches_sent");
+
+	// Sender thread: pop ProcessedTask -> send via ZMQ PUB	
+	zmq::socket_t publisher(context, zmq::socket_type::pub);
+	try {
+		publisher.bind(endpoint);
+		std::cout << "[Sender " << id << "] Extractor publishing on "
+				  << endpoint << std::endl;
+	} catch (const zmq::error_t& e) {
+		std::cerr << "[Sender " << id << "] Error binding ZMQ publisher: "
+				  << e.what() << std::endl;
+		return;
+	}
+
+	try {
+		EventLoop loop;
+		BatchWriter batch;
+		EventLoop::TimerId flush_timer = 0; // 0: no flush pending
+
+		auto flush = [&] {
+			if (flush_timer != 0) {
+				loop.cancel_timer(flush_timer);
+				flush_timer = 0;
+			}
+			if (batch.empty()) {
+				return;
+			}
+			records_sent.add(batch.record_count());
+			batches_sent.add();
+
+			std::vector<char> packed = batch.finish();
+			zmq::message_t batch_msg(packed.data(), packed.size());
+			publisher.send(batch_msg, zmq::send_flags::none);
+		};
+
+		// Woken on every push to the result queue; any sender may win the race
+		// for a given result, the others just find the queue empty.
+		loop.add_fd(results_ready.fd(), [&] {
+			results_ready.drain();
+
+			ProcessedTask result;
+			while (result_queue.try_pop(result)) {
+				// No backlog (or a frame too big to be worth batching):
+				// keep latency minimal and send it on its own.
+				if (batch.empty()
+					&& (config.max_records <= 1 || result_queue.size() == 0
+						|| record_bytes(result) >= config.max_bytes)) {
+					if (config.wire == WireFormat::Frame) {
+						send_frame(publisher, result);
+					} else {
+						send_multipart(publisher, result);
+					}
+					records_sent.add();
+					continue;
+				}
+
+				// Backlog: coalesce until the batch is full or the flush timer fires
+				batch.add(record_parts(result));
+				if (batch.record_count() >= config.max_records
+					|| batch.byte_size() >= config.max_bytes) {
+					flush();
+				} else if (flush_timer == 0) {
+					flush_timer = loop.add_timer(config.flush_timeout, [&] {
+						flush_timer = 0;
+						flush();
+					});
+				}
+			}
+		});
+
+		loop.run();
+	} catch (const zmq::error_t& e) {
+		std::cerr << "[Sender " << id << "] ZMQ error: " << e.what() << std::endl;
+	} catch (const std::exception& e) {
+		std::cerr << "[Sender " << id << "] Error: " << e.what() << std::endl;
+	}
+}
+
+void receiver_thread(int id,
+					 zmq::context_t& context,
+					 std::string endpoint,
+					 std::function<void(ImageTask&&)> sink,
+					 ReceiverConfig config)
+{
+	static Counter& frames_in = Metrics::global().counter("extractor.frames_in");
+
+	zmq::socket_t subscriber(context, zmq::socket_type::sub);
+	try {
+		subscriber.connect(endpoint);
+		subscriber.set(zmq::sockopt::subscribe, ""); 
+		std::cout << "[Receiver " << id << "] Subscribing to "
+				  << endpoint << std::endl;
+	} catch (const zmq::error_t& e) {
+		std::cerr << "[Receiver " << id << "] Error connecting ZMQ subscriber: "
+				  << e.what() << std::endl;
+		return;
+	}
+
+	try {
+		// Arrival order on this socket; frames of a source keep it even
+		// when workers finish them out of order
+		uint64_t sequence = 0;
+
+		// Images arriving in chunks, reassembled (and maybe decoded) here so
+		// workers only ever see whole images
+		ChunkReceiver chunks(config);
+
+		EventLoop loop;
+		// Transfers whose last chunks were lost hold memory until expired
+		loop.add_periodic(std::chrono::milliseconds(constants::CHUNK_TIMEOUT_MS / 4), [&] {
+			chunks.expire();
+		});
+		loop.add_socket(subscriber, [&] {
+			// Drain everything that is queued, then go back to polling
+			while (true) {
+				// Receive Part 1: Filename, or a whole frame
+				zmq::message_t first_msg;
+				if (!subscriber.recv(first_msg, zmq::recv_flags::dontwait)) {
+					break;
+				}
+
+				ImageTask task;
+				if (parse_task(subscriber, first_msg, chunks, id, task) && admit(chunks, task)) {
+					task.source = static_cast<uint32_t>(id);
+					task.sequence = sequence++;
+					sink(std::move(task));
+					frames_in.add();
+				}
+			}
+		});
+		loop.run();
+	} catch (const zmq::error_t& e) {
+		std::cerr << "[Receiver " << id << "] ZMQ error: " << e.what() << std::endl;
+	}
+}
+
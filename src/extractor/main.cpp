@@ -1,222 +1,414 @@
 /**
  * App 2: Feature Extractor
  *
- * - Main thread:
- *   - Subscribes to the Image Generator's ZMQ PUB socket.
- *   - Receives multi-part messages (filename, image_buffer).
- *   - Wraps them as ImageTask and pushes into a SafeQueue<ImageTask>.
+ * - Receiver threads (one per --connect endpoint):
+ *   - Subscribe to an Image Generator's ZMQ PUB socket.
+ *   - Receive multi-part messages (filename, image_buffer), or the same
+ *     two fields as one contiguous frame (see Frame.hpp).
+ *   - Wrap them as ImageTask, keeping the received ZMQ message as the
+ *     image storage (no copy), and push into a SafeQueue<ImageTask>.
+ *   - Reassemble images the generator sent in chunks (see Chunk.hpp) and,
+ *     with --incremental-decode, decode JPEGs among them as the chunks
+ *     arrive (see StreamingDecode.hpp).
  *
- * - Worker threads:
+ * - Worker threads (or, with --pipeline=coro, frame coroutines on a fixed
+ *   thread pool, see CoroPipeline):
  *   - Pop ImageTask from the work queue.
  *   - Decode the image with OpenCV.
- *   - Run SIFT to extract keypoints.
+ *   - Preprocess the gray frame as configured for its source (--preprocess).
+ *   - With --quality, measure sharpness and exposure on a downsampled copy
+ *     and flag, or skip detection on, frames below the thresholds.
+ *   - Run SIFT (or the --detectors list, in parallel on the one decoded
+ *     frame, and on each --levels pyramid level) to extract keypoints, and
+ *     keep the strongest --max-keypoints of them (see KeypointSet.hpp).
+ *   - With --motion, match against the previous frame of the same source
+ *     and estimate the motion between them with RANSAC (see Motion.hpp).
  *   - Serialize keypoints into a binary buffer.
  *   - Wrap as ProcessedTask and push into a SafeQueue<ProcessedTask>.
  *
- * - Sender thread:
- *   - Owns a ZMQ PUB socket bound at constants::EXTRACTOR_ENDPOINT.
- *   - Pops ProcessedTask and publishes multipart message:
+ * - Sender threads (one per --publish endpoint):
+ *   - Own a ZMQ PUB socket, bound at constants::EXTRACTOR_ENDPOINT by default.
+ *   - Pop ProcessedTask from the shared result queue (so each result goes
+ *     out on exactly one socket) and publish multipart message:
  *	   [0] filename
  *	   [1] image_buffer (same compressed buffer from generator)
  *	   [2] keypoints_buffer
+ *	   [3..] optional (tag, payload) pairs, e.g. descriptors or motion (see Record.hpp)
+ *     or, with --wire=frame, the same three fields as one contiguous frame.
+ *   - When results back up in the queue, coalesces them into a single-part
+ *     batch message (see Batch.hpp), flushed on record count, byte size or
+ *     a microsecond flush timer.
+ *
+ * - Main thread:
+ *   - Prints a "[Metrics]" line periodically.
+ *
+ * Receivers and senders each run an EventLoop (EventLoop.hpp); senders are
+ * woken through an EventFd on every result push, so neither blocks in recv
+ * or on the queue and timers need no extra threads.
+ *
+ * The pieces live in Pipeline.hpp; this file parses options and wires them up.
+ *
+ * Options:
+ *   --pipeline=threads|coro worker threads or C++20 coroutines (default threads)
+ *   --workers=N             worker / pool threads (default: hardware concurrency)
+ *   --coro-in-flight=N      frame coroutines with --pipeline=coro (default 2 x workers)
+ *   --detectors=D[,D...]    sift, orb, akaze, brisk; the first fills the keypoints
+ *                           part, the others add tagged parts (default sift)
+ *   --levels=L[,L...]       pyramid levels (scale 1/2^L) to detect on, built
+ *                           once per frame; the first fills the keypoints part (default 0)
+ *   --descriptors           also publish descriptors (needed by feature_matcher)
+ *   --max-keypoints=N       keep only the N strongest keypoints (by response) of
+ *                           each detector and level, 0 keeps all (default 0)
+ *   --preprocess=STEPS      crop, resize, denoise, gamma, clahe on the gray frame
+ *                           before detection, e.g. resize=640x480,clahe=2 (see Preprocess.hpp)
+ *   --preprocess-N=STEPS    the same for the N-th --connect endpoint only (0-based)
+ *   --quality=off|flag|skip sharpness / exposure gate before detection; skip
+ *                           publishes low-quality frames without keypoints (default off)
+ *   --min-sharpness=V       min variance of the Laplacian (default 100)
+ *   --min-brightness=V      min mean gray level (default 30)
+ *   --max-brightness=V      max mean gray level (default 225)
+ *   --max-clipped=F         max share of nearly black or white pixels (default 0.5)
+ *   --motion=off|affine|homography  frame-to-frame motion per source (default off)
+ *   --motion-ratio=R        ratio test for motion matches (default 0.8)
+ *   --ransac-threshold=PX   inlier reprojection error in pixels (default 3)
+ *   --ransac-iterations=N   max RANSAC hypotheses per frame (default 2000)
+ *   --ransac-confidence=P   stop RANSAC early at this confidence (default 0.995)
+ *   --huge-pages=off|transparent|explicit  back image buffers of 1 MiB and more
+ *                           (including SIFT's scratch) with pooled huge pages (default off,
+ *                           see HugePages.hpp); the metrics line counts page faults
+ *   --perf-counters         count cycles, instructions, cache and branch misses of
+ *                           every stage on the metrics line (see PerfCounters.hpp)
+ *   --alloc-profile         count operator new calls, bytes and frees of every stage
+ *                           per frame from the start; SIGUSR1 toggles it at any time
+ *                           (see AllocProfile.hpp)
+ *   --connect=EP[,EP...]    generator endpoints, one receiver thread each
+ *   --incremental-decode    decode chunked JPEGs, and build their pyramid, while
+ *                           the chunks arrive (needs a build with libjpeg)
+ *   --memory-budget=BYTES   max bytes held by frames in flight, from receipt to
+ *                           publish; 0 only accounts them (default 0, see MemoryBudget.hpp)
+ *   --memory-full=wait|drop once over budget, receivers wait (and the generator's
+ *                           socket buffers fill) or drop new frames (default wait)
+ *   --publish=EP[,EP...]    endpoints to bind, one sender thread each
+ *   --batch-max-records=N   records per batch, 1 disables batching (default 64)
+ *   --batch-max-bytes=N     flush once a batch reaches N bytes (default 1 MiB)
+ *   --batch-flush-us=N      max time spent filling a batch (default 500)
+ *   --wire=multipart|frame  per-record output format (default multipart)
+ *   --metrics-interval-ms=N period of the metrics line, 0 disables (default 5000)
  */
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <thread>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <csignal>
 
-#include "opencv2/opencv.hpp"
-#include "opencv2/features2d.hpp"
 #include "zmq.hpp"
 
 #include "Constants.hpp"
-#include "Serialization.hpp"
 #include "SafeQueue.hpp"
+#include "Options.hpp"
+#include "Frame.hpp"
+#include "EventLoop.hpp"
+#include "EventFd.hpp"
+#include "Metrics.hpp"
+#include "MemoryBudget.hpp"
+
+#include "Pipeline.hpp"
+#include "StreamingDecode.hpp"
+#include "HugePages.hpp"
+#include "PerfCounters.hpp"
+#include "AllocProfile.hpp"
+
+extern "C" void toggle_alloc_profile(int) {
+	alloc_profile::toggle();
+}
 
-// Work item received from generator
-struct ImageTask {
-	std::string filename;
-	std::vector<uchar> img_buffer; // compressed image bytes
-};
-
-// Result item to send to logger
-struct ProcessedTask {
-	std::string filename;
-	std::vector<uchar> img_buffer;	 // same compressed image
-	std::vector<char> keypoints_buffer;
-};
-
-// Worker thread: pop ImageTask -> process -> push ProcessedTask
-void worker_thread(int id,
-				   SafeQueue<ImageTask>& work_queue,
-				   SafeQueue<ProcessedTask>& result_queue)
-{
+int main(int argc, char* argv[]) {
+	BatchConfig batch_config;
+	ProcessingConfig processing;
+	std::vector<std::string> connect_to;
+	std::vector<std::string> publish_on;
+	long long metrics_ms = 0;
+	std::string pipeline;
+	long long num_workers = 0;
+	long long coro_in_flight = 0;
+	bool incremental_decode = false;
+	bool drop_when_full = false;
+	HugePageAllocator::Mode huge_pages = HugePageAllocator::Mode::Off;
 	try {
-		cv::Ptr<cv::SIFT> sift = cv::SIFT::create();
-
-		ImageTask task;
-		while (work_queue.pop(task)) {
-			// Decode image
-			cv::Mat image = cv::imdecode(task.img_buffer, cv::IMREAD_COLOR);
-			if (image.empty()) {
-				std::cerr << "[Worker " << id << "] Failed to decode " << task.filename << "\n";
-				continue;
-			}
+		Options options(argc, argv);
+		long long max_records = options.get_int("batch-max-records",
+			static_cast<long long>(batch_config.max_records));
+		long long max_bytes = options.get_int("batch-max-bytes",
+			static_cast<long long>(batch_config.max_bytes));
+		long long flush_us = options.get_int("batch-flush-us",
+			batch_config.flush_timeout.count());
+		if (max_records < 1 || max_bytes < 1 || flush_us < 0) {
+			throw std::invalid_argument("Batch limits must be positive.");
+		}
+		batch_config.max_records = static_cast<size_t>(max_records);
+		batch_config.max_bytes = static_cast<size_t>(max_bytes);
+		batch_config.flush_timeout = std::chrono::microseconds(flush_us);
+		batch_config.wire = parse_wire_format(options.get("wire", "multipart"));
+
+		connect_to = options.get_list("connect", {constants::GENERATOR_CONNECT_TO});
+		publish_on = options.get_list("publish", {constants::EXTRACTOR_ENDPOINT});
+		if (connect_to.empty() || publish_on.empty()) {
+			throw std::invalid_argument("--connect and --publish need at least one endpoint.");
+		}
 
-			// Convert to grayscale (standard for SIFT)
-			cv::Mat gray;
-			cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+		metrics_ms = options.get_int("metrics-interval-ms", constants::METRICS_INTERVAL_MS);
 
-			// Extract keypoints
-			std::vector<cv::KeyPoint> keypoints;
-			sift->detect(gray, keypoints);
+		incremental_decode = options.get_bool("incremental-decode", false);
+		if (incremental_decode && !StreamingJpegDecoder::available()) {
+			throw std::invalid_argument("--incremental-decode needs a build with libjpeg (EXTRACTOR_LIBJPEG)");
+		}
+
+		long long memory_budget = options.get_int("memory-budget", 0);
+		if (memory_budget < 0) {
+			throw std::invalid_argument("--memory-budget must not be negative.");
+		}
+		std::string memory_full = options.get("memory-full", "wait");
+		if (memory_full != "wait" && memory_full != "drop") {
+			throw std::invalid_argument("Unknown --memory-full '" + memory_full + "' (expected wait or drop)");
+		}
+		drop_when_full = memory_full == "drop";
+		processing.memory = std::make_shared<MemoryBudget>(static_cast<size_t>(memory_budget),
+			Metrics::global().gauge("extractor.memory_bytes"));
 
-			// Serialize keypoints
-			std::vector<char> kps_buffer = serialize_keypoints(keypoints);
+		huge_pages = HugePageAllocator::parse_mode(options.get("huge-pages", "off"));
 
-			// Pack result
-			ProcessedTask result;
-			result.filename = std::move(task.filename);
-			result.img_buffer = std::move(task.img_buffer);
-			result.keypoints_buffer = std::move(kps_buffer);
+		processing.perf_counters = options.get_bool("perf-counters", false);
+		if (processing.perf_counters) {
+			PerfCounters probe; // fail here rather than in every worker
+			if (!probe.enabled()) {
+				throw std::invalid_argument("--perf-counters: " + probe.error());
+			}
+		}
 
-			result_queue.push(std::move(result));
+		alloc_profile::set_enabled(options.get_bool("alloc-profile", false));
+		std::signal(SIGUSR1, toggle_alloc_profile);
 
-			std::cout << "[Worker " << id << "] Processed "
-					  << result.filename << " (" << keypoints.size()
-					  << " keypoints)\n";
+		long long hw = std::thread::hardware_concurrency();
+		if (hw == 0) hw = 2; // fallback
+		num_workers = options.get_int("workers", hw);
+		coro_in_flight = options.get_int("coro-in-flight", 2 * num_workers);
+		if (num_workers < 1 || coro_in_flight < 1) {
+			throw std::invalid_argument("--workers and --coro-in-flight must be positive.");
 		}
-	} catch (const std::exception& e) {
-		std::cerr << "[Worker " << id << "] Error: " << e.what() << "\n";
-	}
-}
 
-void sender_thread(zmq::context_t& context,
-				   SafeQueue<ProcessedTask>& result_queue)
-{
-	// Sender thread: pop ProcessedTask -> send via ZMQ PUB	
-	zmq::socket_t publisher(context, zmq::socket_type::pub);
-	try {
-		publisher.bind(constants::EXTRACTOR_ENDPOINT);
-		std::cout << "[Sender] Extractor publishing on "
-				  << constants::EXTRACTOR_ENDPOINT << std::endl;
-	} catch (const zmq::error_t& e) {
-		std::cerr << "[Sender] Error binding ZMQ publisher: "
-				  << e.what() << std::endl;
-		return;
-	}
+		processing.descriptors = options.get_bool("descriptors", false);
+		long long max_keypoints = options.get_int("max-keypoints", 0);
+		if (max_keypoints < 0) {
+			throw std::invalid_argument("--max-keypoints must not be negative.");
+		}
+		processing.max_keypoints = static_cast<size_t>(max_keypoints);
+		processing.detectors = options.get_list("detectors", {"sift"});
+		if (processing.detectors.empty()) {
+			throw std::invalid_argument("--detectors needs at least one detector.");
+		}
+		for (size_t i = 0; i < processing.detectors.size(); ++i) {
+			create_detector(processing.detectors[i]); // rejects unknown names up front
+			if (std::find(processing.detectors.begin(), processing.detectors.begin() + i,
+						  processing.detectors[i]) != processing.detectors.begin() + i) {
+				throw std::invalid_argument("Detector '" + processing.detectors[i] + "' listed twice.");
+			}
+		}
+		processing.levels.clear();
+		for (long long level : options.get_int_list("levels", {0})) {
+			if (level < 0 || level > constants::MAX_PYRAMID_LEVEL) {
+				throw std::invalid_argument("--levels must be between 0 and "
+											+ std::to_string(constants::MAX_PYRAMID_LEVEL) + ".");
+			}
+			if (std::find(processing.levels.begin(), processing.levels.end(), level) != processing.levels.end()) {
+				throw std::invalid_argument("Pyramid level " + std::to_string(level) + " listed twice.");
+			}
+			processing.levels.push_back(static_cast<int>(level));
+		}
+		if (processing.levels.empty()) {
+			throw std::invalid_argument("--levels needs at least one level.");
+		}
 
-	try {
-		ProcessedTask result;
-		while (result_queue.pop(result)) {
-			// Build multipart message to logger
-			// Part 1: filename
-			zmq::message_t name_msg(result.filename.begin(), result.filename.end());
-
-			// Part 2: image buffer
-			zmq::message_t img_msg(result.img_buffer.data(),
-								   result.img_buffer.size());
-
-			// Part 3: keypoints buffer
-			zmq::message_t kps_msg(result.keypoints_buffer.data(),
-								   result.keypoints_buffer.size());
-
-			publisher.send(name_msg, zmq::send_flags::sndmore);
-			publisher.send(img_msg,  zmq::send_flags::sndmore);
-			publisher.send(kps_msg,  zmq::send_flags::none);
-		}
-	} catch (const zmq::error_t& e) {
-		std::cerr << "[Sender] ZMQ error: " << e.what() << std::endl;
-	} catch (const std::exception& e) {
-		std::cerr << "[Sender] Error: " << e.what() << std::endl;
-	}
-}
+		// --preprocess for every source, --preprocess-N for the N-th --connect endpoint
+		PreprocessConfig preprocess = PreprocessConfig::parse(options.get("preprocess", ""));
+		processing.preprocess.assign(connect_to.size(), preprocess);
+		const std::string per_source = "preprocess-";
+		for (const std::string& key : options.keys()) {
+			if (key.compare(0, per_source.size(), per_source) != 0) {
+				continue;
+			}
+			std::string index = key.substr(per_source.size());
+			size_t source = connect_to.size();
+			if (!index.empty() && index.size() < 10 && index.find_first_not_of("0123456789") == std::string::npos) {
+				source = std::stoul(index);
+			}
+			if (source >= connect_to.size()) {
+				throw std::invalid_argument("--" + key + " names no --connect endpoint (there are "
+											+ std::to_string(connect_to.size()) + ", numbered from 0).");
+			}
+			processing.preprocess[source] = PreprocessConfig::parse(options.get(key, ""));
+		}
 
-int main(int argc, char* argv[]) {
-	// ZMQ context for the whole extractor process
-	zmq::context_t context(1);
+		std::string quality = options.get("quality", "off");
+		if (quality == "flag") {
+			processing.quality.mode = QualityGate::Mode::Flag;
+		} else if (quality == "skip") {
+			processing.quality.mode = QualityGate::Mode::Skip;
+		} else if (quality != "off") {
+			throw std::invalid_argument("Unknown --quality '" + quality + "' (expected off, flag or skip)");
+		}
+		processing.quality.min_sharpness = options.get_double("min-sharpness", processing.quality.min_sharpness);
+		processing.quality.min_brightness = options.get_double("min-brightness", processing.quality.min_brightness);
+		processing.quality.max_brightness = options.get_double("max-brightness", processing.quality.max_brightness);
+		processing.quality.max_clipped = options.get_double("max-clipped", processing.quality.max_clipped);
+
+		std::string motion = options.get("motion", "off");
+		if (motion != "off") {
+			MotionTracker::Params motion_params;
+			if (motion == "affine") {
+				motion_params.model = MotionEstimate::Affine;
+			} else if (motion == "homography") {
+				motion_params.model = MotionEstimate::Homography;
+			} else {
+				throw std::invalid_argument("Unknown --motion '" + motion + "' (expected off, affine or homography)");
+			}
+			motion_params.ratio = static_cast<float>(options.get_double("motion-ratio", motion_params.ratio));
+			motion_params.threshold = options.get_double("ransac-threshold", motion_params.threshold);
+			motion_params.confidence = options.get_double("ransac-confidence", motion_params.confidence);
+			long long iterations = options.get_int("ransac-iterations", motion_params.max_iterations);
+			if (motion_params.threshold <= 0 || iterations < 1
+				|| motion_params.confidence <= 0 || motion_params.confidence >= 1) {
+				throw std::invalid_argument("--ransac-threshold and --ransac-iterations must be positive, "
+											"--ransac-confidence in (0, 1).");
+			}
+			motion_params.max_iterations = static_cast<int>(iterations);
+			processing.motion = std::make_shared<MotionTracker>(motion_params);
+		}
 
-	// Socket to receive from image generator (App 1)
-	zmq::socket_t subscriber(context, zmq::socket_type::sub);
-	try {
-		subscriber.connect(constants::GENERATOR_CONNECT_TO);
-		subscriber.set(zmq::sockopt::subscribe, ""); 
-		std::cout << "[Extractor] Subscribing to "
-				  << constants::GENERATOR_CONNECT_TO << std::endl;
-	} catch (const zmq::error_t& e) {
-		std::cerr << "[Extractor] Error connecting ZMQ subscriber: "
-				  << e.what() << std::endl;
+		pipeline = options.get("pipeline", "threads");
+		if (pipeline != "threads" && pipeline != "coro") {
+			throw std::invalid_argument("Unknown --pipeline '" + pipeline + "' (expected threads or coro)");
+		}
+#ifndef EXTRACTOR_COROUTINES
+		if (pipeline == "coro") {
+			throw std::invalid_argument("--pipeline=coro needs a build with EXTRACTOR_COROUTINES=ON");
+		}
+#endif
+	} catch (const std::exception& e) {
+		std::cerr << "[Extractor] " << e.what() << std::endl;
 		return -1;
 	}
 
-	// Shared queues
+	// ZMQ context for the whole extractor process; one I/O thread per
+	// socket pair is plenty, the bottleneck used to be the single
+	// receiving/sending application thread
+	zmq::context_t context(static_cast<int>(std::max(connect_to.size(), publish_on.size())));
+
+	// Before any worker allocates its buffers
+	HugePageAllocator::install(huge_pages);
+
+	// Shared queues; senders sleep in their event loops until a result is pushed
 	SafeQueue<ImageTask>	work_queue;
 	SafeQueue<ProcessedTask> result_queue;
-
-	// Start worker threads
-	unsigned int num_workers = std::thread::hardware_concurrency();
-	if (num_workers == 0) num_workers = 2; // fallback
+	EventFd results_ready;
+	result_queue.set_on_push([&results_ready] { results_ready.notify(); });
 
 	std::cout << "[Extractor] Launching " << num_workers
-			  << " worker threads...\n";
+			  << (pipeline == "coro" ? " pool threads, " : " worker threads, ")
+			  << connect_to.size() << " receivers and "
+			  << publish_on.size() << " senders...\n";
+
+	// What the receivers do with each frame
+	std::function<void(ImageTask&&)> sink;
+	std::function<size_t()> backlog;
 
 	std::vector<std::thread> workers;
-	workers.reserve(num_workers);
-	for (unsigned int i = 0; i < num_workers; ++i) {
-		workers.emplace_back(worker_thread,
-							 static_cast<int>(i),
-							 std::ref(work_queue),
-							 std::ref(result_queue));
+#ifdef EXTRACTOR_COROUTINES
+	std::unique_ptr<CoroPipeline> coro;
+	if (pipeline == "coro") {
+		coro = std::make_unique<CoroPipeline>(static_cast<size_t>(num_workers),
+											  static_cast<size_t>(coro_in_flight),
+											  processing, result_queue);
+		sink = [&coro](ImageTask&& task) { coro->submit(std::move(task)); };
+		backlog = [&coro] { return coro->backlog(); };
 	}
-
-	// Start sender thread (owns PUB socket)
-	std::thread sender(sender_thread, std::ref(context), std::ref(result_queue));
-
-	// Main loop: receive from generator & push tasks
-	while (true) {
-		zmq::message_t name_msg;
-		zmq::message_t img_msg;
-		
-		// Receive Part 1: Filename
-		auto recv_name = subscriber.recv(name_msg);
-		if (!recv_name.has_value()) { continue; }
-
-		if (!subscriber.get(zmq::sockopt::rcvmore)) {
-			std::cerr << "[Extractor] Warning: expected 2 parts, got 1. Skipping.\n";
-			continue;
-		}
-		
-		// Receive Part 2: Image buffer
-		auto recv_img = subscriber.recv(img_msg);
-		if (!recv_img.has_value()) { continue; }
-
-		// Check that this is the last part
-		if (subscriber.get(zmq::sockopt::rcvmore)) {
-			std::cerr << "[Extractor] Warning: received >2 parts. Flushing extras.\n";
-			zmq::message_t temp;
-			while (subscriber.get(zmq::sockopt::rcvmore)) {
-				subscriber.recv(temp);
-			}
-			continue;
+#endif
+	if (!sink) {
+		// Start worker threads
+		workers.reserve(static_cast<size_t>(num_workers));
+		for (long long i = 0; i < num_workers; ++i) {
+			workers.emplace_back(worker_thread,
+								 static_cast<int>(i),
+								 processing,
+								 std::ref(work_queue),
+								 std::ref(result_queue));
 		}
+		sink = [&work_queue](ImageTask&& task) { work_queue.push(std::move(task)); };
+		backlog = [&work_queue] { return work_queue.size(); };
+	}
 
-		ImageTask task;
-		task.filename = name_msg.to_string();
+	// Start sender threads (each owns a PUB socket; results go to
+	// whichever sender pops them first)
+	std::vector<std::thread> senders;
+	for (size_t i = 0; i < publish_on.size(); ++i) {
+		senders.emplace_back(sender_thread, static_cast<int>(i), std::ref(context),
+							 publish_on[i], std::ref(result_queue),
+							 std::ref(results_ready), batch_config);
+	}
 
-		task.img_buffer.assign(
-			static_cast<uchar*>(img_msg.data()),
-			static_cast<uchar*>(img_msg.data()) + img_msg.size()
-		);
+	// Start receiver threads (one SUB socket per generator). Receivers
+	// decoding incrementally build the pyramid too, unless the source's
+	// frames get preprocessed first
+	std::vector<std::thread> receivers;
+	for (size_t i = 0; i < connect_to.size(); ++i) {
+		ReceiverConfig receiver_config;
+		receiver_config.incremental_decode = incremental_decode;
+		receiver_config.memory = processing.memory;
+		receiver_config.drop_when_full = drop_when_full;
+		if (!processing.preprocess[i].enabled()) {
+			receiver_config.max_level = *std::max_element(processing.levels.begin(),
+														  processing.levels.end());
+		}
+		receivers.emplace_back(receiver_thread, static_cast<int>(i), std::ref(context),
+							   connect_to[i], sink, receiver_config);
+	}
 
-		work_queue.push(std::move(task));
+	// Main thread: periodic metrics
+	EventLoop loop;
+	if (metrics_ms > 0) {
+		Gauge& work_depth = Metrics::global().gauge("extractor.work_queue");
+		Gauge& result_depth = Metrics::global().gauge("extractor.result_queue");
+		Counter& minor_faults = Metrics::global().counter("extractor.minor_faults");
+		Counter& major_faults = Metrics::global().counter("extractor.major_faults");
+		PageFaults faults = page_faults(); // count from here on, not the start-up
+		loop.add_periodic(std::chrono::milliseconds(metrics_ms), [&] {
+			work_depth.set(static_cast<int64_t>(backlog()));
+			result_depth.set(static_cast<int64_t>(result_queue.size()));
+			PageFaults now = page_faults();
+			minor_faults.add(now.minor - faults.minor);
+			major_faults.add(now.major - faults.major);
+			faults = now;
+			std::cout << "[Metrics] " << Metrics::global().report() << std::endl;
+			if (alloc_profile::enabled()) {
+				std::cout << "[Allocations] " << alloc_profile::size_histogram() << std::endl;
+			}
+		});
 	}
+	loop.run();
 
-	sender.join();
+	for (auto& r : receivers) {
+		if (r.joinable()) r.join();
+	}
+	for (auto& s : senders) {
+		if (s.joinable()) s.join();
+	}
 	for (auto& w : workers) {
 		if (w.joinable()) w.join();
 	}
 
 	return 0;
 }
-
@@ -2,8 +2,21 @@
  * App 1: Image Generator (simulating a high-speed camera streaming data to the backend system)
  * - Reads image files from the '../images/' directory.
  * - Dynamically rescans the directory on each loop iteration (to handle file addition and removal).
- * - Encodes the image into a compressed buffer (e.g., JPEG bytes).
- * - Publishes a two-part message (filename, image_buffer) to a ZMQ PUB socket.
+ * - Encodes the image into a compressed buffer (e.g., JPEG bytes). With
+ *   --codec=qoi|webp|jxl|jpeg|png (or "fastest", QOI) each file is instead
+ *   transcoded once to that codec and the bytes are reused on every loop,
+ *   until the file changes (see ImageCodec.hpp).
+ * - Publishes a two-part message (filename, image_buffer) to a ZMQ PUB socket,
+ *   or with --wire=frame the same two fields as one contiguous frame (see Frame.hpp).
+ *   With --chunk-bytes=N, images larger than N bytes are instead sent as a
+ *   series of N-byte chunk messages (see Chunk.hpp), a few per event loop
+ *   turn, so frames due meanwhile go out between them.
+ * - Paces frames with EventLoop timers and prints a "[Metrics]" line periodically.
+ *
+ * Usage: image_generator [image_dir] [--wire=multipart|frame] [--bind=EP]
+ *                        [--codec=keep|jpeg|png|webp|jxl|qoi|fastest]
+ *                        [--codec-quality=0-100] [--chunk-bytes=N]
+ *                        [--metrics-interval-ms=N]
  */
 
 #include <iostream>
@@ -13,15 +26,55 @@
 #include <filesystem>
 #include <algorithm>
 #include <chrono>
-#include <thread>
+#include <functional>
+#include <map>
+#include <deque>
+#include <random>
 #include <stdexcept>
 
 #include "opencv2/opencv.hpp"
 #include "zmq.hpp"
 #include "Constants.hpp"
+#include "Options.hpp"
+#include "Frame.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "ImageCodec.hpp"
+#include "Chunk.hpp"
 
 namespace fs = std::filesystem;
 
+// How images are turned into the bytes that get published
+struct EncodeConfig {
+	ImageCodec codec = ImageCodec::Keep; // Keep: re-encode in the file's own format every time
+	int quality = 95;                    // lossy codecs
+};
+
+// Large images are split into chunks of at most `chunk_bytes` (0: never)
+// and sent a few chunks per event loop turn, so that other frames go out
+// between them
+struct ChunkConfig {
+	struct Transfer {
+		uint64_t id;
+		std::string filename;
+		std::vector<uchar> bytes;
+		size_t offset = 0; // next chunk
+	};
+
+	size_t chunk_bytes = 0;
+	uint64_t next_transfer = 0;   // seeded at start-up, see main()
+	std::deque<Transfer> pending; // images with chunks left to send, round-robin
+};
+
+// Images transcoded to EncodeConfig::codec, by path
+struct TranscodeCache {
+	struct Entry {
+		fs::file_time_type modified;
+		std::vector<uchar> bytes;
+	};
+	std::map<std::string, Entry> entries;
+};
+
 // Helper function to find images dynamically ---
 std::vector<std::string> find_available_images(const fs::path& dir_path) {
 	std::vector<std::string> image_paths;
@@ -38,7 +91,7 @@ std::vector<std::string> find_available_images(const fs::path& dir_path) {
 			std::string extension = entry.path().extension().string();
 			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
 
-			if (extension == ".jpg" || extension == ".jpeg" || extension == ".png") {
+			if (image_codec_for_extension(extension) != ImageCodec::Keep) {
 				// Store the full path for reading later
 				image_paths.push_back(path_str);
 			}
@@ -47,12 +100,171 @@ std::vector<std::string> find_available_images(const fs::path& dir_path) {
 	return image_paths;
 }
 
+// Reads and decodes an image file (any codec decode_image() knows)
+cv::Mat read_image(const std::string& full_path) {
+	std::ifstream file(full_path, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	cv::Mat image;
+	if (!file.bad() && !bytes.empty()) {
+		decode_image(bytes.data(), bytes.size(), cv::IMREAD_COLOR, image);
+	}
+	return image;
+}
+
+// Bytes to publish for `full_path`; false if the file could not be read
+bool encode_file(const std::string& full_path, const EncodeConfig& config,
+				 TranscodeCache& cache, std::vector<uchar>& img_buffer) {
+	static Counter& transcoded = Metrics::global().counter("generator.files_transcoded");
+
+	std::error_code ec;
+	fs::file_time_type modified = fs::last_write_time(full_path, ec);
+	if (config.codec != ImageCodec::Keep && !ec) {
+		auto cached = cache.entries.find(full_path);
+		if (cached != cache.entries.end() && cached->second.modified == modified) {
+			img_buffer = cached->second.bytes;
+			return true;
+		}
+	}
+
+	// Read image from disk
+	cv::Mat image = read_image(full_path);
+	if (image.empty()) {
+		return false;
+	}
+
+	// Encode image to memory buffer
+	if (config.codec == ImageCodec::Keep) {
+		std::string extension = fs::path(full_path).extension().string();
+		return encode_image(image_codec_for_extension(extension), image, img_buffer, config.quality);
+	}
+	if (!encode_image(config.codec, image, img_buffer, config.quality)) {
+		return false;
+	}
+	if (!ec) {
+		cache.entries[full_path] = TranscodeCache::Entry{modified, img_buffer};
+	}
+	transcoded.add();
+	return true;
+}
+
+// Sends up to `max_chunks` chunk messages of the pending images, one per
+// image in turn. Each chunk is its own ZMQ message, so no stage ever holds
+// a message of the whole image size. Returns true if chunks are left.
+bool send_chunks(zmq::socket_t& publisher, ChunkConfig& chunking, size_t max_chunks) {
+	static Counter& chunks_sent = Metrics::global().counter("generator.chunks_sent");
+
+	for (size_t sent = 0; sent < max_chunks && !chunking.pending.empty(); ++sent) {
+		ChunkConfig::Transfer transfer = std::move(chunking.pending.front());
+		chunking.pending.pop_front();
+
+		size_t size = std::min(chunking.chunk_bytes, transfer.bytes.size() - transfer.offset);
+		zmq::message_t chunk_msg(chunked_size(transfer.filename, size));
+		encode_chunk_into(transfer.id, transfer.bytes.size(), transfer.offset, transfer.filename,
+						  reinterpret_cast<const char*>(transfer.bytes.data()) + transfer.offset,
+						  size, chunk_msg.data());
+		publisher.send(chunk_msg, zmq::send_flags::none);
+		chunks_sent.add();
+
+		transfer.offset += size;
+		if (transfer.offset < transfer.bytes.size()) {
+			chunking.pending.push_back(std::move(transfer));
+		}
+	}
+	return !chunking.pending.empty();
+}
+
+// Reads, encodes and publishes one image; returns false if it could not be read
+bool publish_image(zmq::socket_t& publisher, const std::string& full_path,
+				   WireFormat wire, int frame_count,
+				   const EncodeConfig& encode, TranscodeCache& cache,
+				   ChunkConfig& chunking) {
+	static Counter& frames_sent = Metrics::global().counter("generator.frames_sent");
+	static Counter& bytes_sent = Metrics::global().counter("generator.bytes_sent");
+
+	std::vector<uchar> img_buffer;
+	if (!encode_file(full_path, encode, cache, img_buffer)) {
+		std::cerr << "Warning: Could not read image " << full_path 
+		<< ". Skipping and removing from current path scan." << std::endl;
+		// If a file is suddenly corrupted/deleted during a loop, we skip it.
+		cache.entries.erase(full_path);
+		return false;
+	}
+
+	// Create ZMQ message parts
+	std::string filename_only = fs::path(full_path).filename().string();
+
+	size_t image_size = img_buffer.size();
+	if (chunking.chunk_bytes > 0 && image_size > chunking.chunk_bytes) {
+		// Queued; the event loop sends the chunks (see send_chunks)
+		chunking.pending.push_back({chunking.next_transfer++, filename_only, std::move(img_buffer)});
+	} else if (wire == WireFormat::Frame) {
+		// Single frame: [filename][image_buffer]
+		RecordView parts = {
+			PartView{filename_only.data(), filename_only.size()},
+			PartView{reinterpret_cast<const char*>(img_buffer.data()), img_buffer.size()}
+		};
+		zmq::message_t frame_msg(framed_size(parts));
+		encode_frame_into(parts, frame_msg.data());
+		publisher.send(frame_msg, zmq::send_flags::none);
+	} else {
+		// Part 1: Filename
+		zmq::message_t name_msg(filename_only.begin(), filename_only.end());
+
+		// Part 2: Image buffer
+		zmq::message_t img_msg(img_buffer.data(), img_buffer.size());
+
+		// Publish multi-part message
+		publisher.send(name_msg, zmq::send_flags::sndmore);
+		publisher.send(img_msg, zmq::send_flags::none);
+	}
+
+	frames_sent.add();
+	bytes_sent.add(image_size);
+
+	std::cout << "Sent image: " << filename_only << " (Frame " << frame_count 
+	<< ", " << (image_size / 1024) << " KB)" << std::endl;
+	return true;
+}
+
 int main(int argc, char* argv[]) {
 
+	Options options(argc, argv);
 	fs::path demo_dir;
+	std::string endpoint = options.get("bind", constants::GENERATOR_ENDPOINT);
+
+	WireFormat wire;
+	long long metrics_ms = 0;
+	EncodeConfig encode;
+	ChunkConfig chunking;
+	try {
+		wire = parse_wire_format(options.get("wire", "multipart"));
+		metrics_ms = options.get_int("metrics-interval-ms", constants::METRICS_INTERVAL_MS);
+		encode.codec = parse_image_codec(options.get("codec", "keep"));
+		long long quality = options.get_int("codec-quality", encode.quality);
+		if (quality < 0 || quality > 100) {
+			throw std::invalid_argument("--codec-quality must be between 0 and 100.");
+		}
+		encode.quality = static_cast<int>(quality);
+		long long chunk_bytes = options.get_int("chunk-bytes", 0);
+		if (chunk_bytes < 0) {
+			throw std::invalid_argument("--chunk-bytes must not be negative.");
+		}
+		chunking.chunk_bytes = static_cast<size_t>(chunk_bytes);
+		// Distinct from the IDs of a previous run, which subscribers may
+		// still be assembling
+		chunking.next_transfer = (static_cast<uint64_t>(std::random_device()()) << 32)
+			^ static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+		if (!image_codec_available(encode.codec)) {
+			throw std::invalid_argument(std::string("This OpenCV build cannot encode and decode ")
+										+ image_codec_name(encode.codec) + ".");
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Fatal Error: " << e.what() << std::endl;
+		return -1;
+	}
 
-	if (argc >= 2) {
-		demo_dir = fs::path(argv[1]);
+	if (!options.positional().empty()) {
+		demo_dir = fs::path(options.positional()[0]);
 	} else {
 		// default image directory path
 		demo_dir = fs::current_path() / "../images";
@@ -74,75 +286,98 @@ int main(int argc, char* argv[]) {
 	zmq::socket_t publisher(context, zmq::socket_type::pub);
 	
 	try {
-		publisher.bind(constants::GENERATOR_ENDPOINT);
-		std::cout << "Generator started, publishing on " << constants::GENERATOR_ENDPOINT << std::endl;
+		publisher.bind(endpoint);
+		std::cout << "Generator started, publishing on " << endpoint << std::endl;
 	} catch (const zmq::error_t& e) {
 		std::cerr << "Error binding ZMQ publisher: " << e.what() << std::endl;
 		return -1;
 	}
 
-	// Loop over contents of the image directory forever (as per instructions) 
+	// Loop over contents of the image directory forever (as per instructions),
+	// driven by timers on an event loop instead of sleeps
+	EventLoop loop;
 	int frame_count = 0;
-	while (true) {
+	std::vector<std::string> image_paths;
+	size_t next_image = 0;
+	TranscodeCache cache;
+
+	std::function<void()> scan_directory;
+	std::function<void()> send_next;
+	std::function<void()> pump_chunks;
+	bool pumping = false;
+
+	// A few chunks per turn of the loop, so frames due in the meantime go
+	// out between them
+	pump_chunks = [&] {
+		pumping = send_chunks(publisher, chunking, constants::CHUNKS_PER_TURN);
+		if (pumping) {
+			loop.add_timer(std::chrono::microseconds::zero(), pump_chunks);
+		}
+	};
+
+	scan_directory = [&] {
 		// Update the directory contents list every time (to handle image addition or removal)
-		std::vector<std::string> image_paths;
 		try {
 			image_paths = find_available_images(demo_dir);
 		} catch (const std::runtime_error& e) {
 			std::cerr << "Scan Error: " << e.what() << std::endl;
-			// Sleep and try again in the next loop iteration
-			std::this_thread::sleep_for(std::chrono::seconds(1));
-			continue;
+			// Try again a bit later
+			loop.add_timer(std::chrono::seconds(1), scan_directory);
+			return;
 		}
-		
+
 		if (image_paths.empty()) {
 			std::cout << "Waiting for images to appear in directory..." << std::endl;
-			// Sleep briefly to avoid busy waiting
-			std::this_thread::sleep_for(std::chrono::seconds(1));
-			continue; // Start the loop over to re-check
+			// Re-check after a short wait to avoid busy waiting
+			loop.add_timer(std::chrono::seconds(1), scan_directory);
+			return;
 		}
 
-		// Process the current list of images
-		for (const std::string& full_path : image_paths) {
-			frame_count++;
-			
-			// Read image from disk
-			cv::Mat image = cv::imread(full_path, cv::IMREAD_COLOR);
-			
-			if (image.empty()) {
-				std::cerr << "Warning: Could not read image " << full_path 
-				<< ". Skipping and removing from current path scan." << std::endl;
-				// If a file is suddenly corrupted/deleted during a loop, we skip it.
-				continue; 
+		// Forget transcoded bytes of files that are gone
+		for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+			if (std::find(image_paths.begin(), image_paths.end(), it->first) == image_paths.end()) {
+				it = cache.entries.erase(it);
+			} else {
+				++it;
 			}
+		}
 
-			// Encode image to memory buffer
-			std::vector<uchar> img_buffer;
-			std::string extension = fs::path(full_path).extension().string(); 
-			cv::imencode(extension, image, img_buffer);
-
-			// Create ZMQ message parts
-			std::string filename_only = fs::path(full_path).filename().string();
-			
-			// Part 1: Filename
-			zmq::message_t name_msg(filename_only.begin(), filename_only.end());
+		next_image = 0;
+		send_next();
+	};
 
-			// Part 2: Image buffer
-			zmq::message_t img_msg(img_buffer.data(), img_buffer.size());
+	send_next = [&] {
+		// Process the current list of images; unreadable files are skipped
+		// without waiting
+		while (next_image < image_paths.size()) {
+			frame_count++;
+			if (publish_image(publisher, image_paths[next_image++], wire, frame_count, encode, cache, chunking)) {
+				if (!pumping && !chunking.pending.empty()) {
+					pumping = true;
+					loop.add_timer(std::chrono::microseconds::zero(), pump_chunks);
+				}
+				// Optionally wait to simulate a slower frame rate (e.g., 50ms = 20 FPS)
+				loop.add_timer(std::chrono::milliseconds(50), send_next);
+				return;
+			}
+		}
 
-			// Publish multi-part message
-			publisher.send(name_msg, zmq::send_flags::sndmore);
-			publisher.send(img_msg, zmq::send_flags::none);
+		// After sending the full batch, we pause slightly before re-scanning and starting the next batch.
+		loop.add_timer(std::chrono::milliseconds(500), scan_directory);
+	};
 
-			std::cout << "Sent image: " << filename_only << " (Frame " << frame_count 
-			<< ", " << (img_buffer.size() / 1024) << " KB)" << std::endl;
+	if (metrics_ms > 0) {
+		loop.add_periodic(std::chrono::milliseconds(metrics_ms), [] {
+			std::cout << "[Metrics] " << Metrics::global().report() << std::endl;
+		});
+	}
 
-			// Optionally sleep to simulate a slower frame rate (e.g., 50ms = 20 FPS)
-			std::this_thread::sleep_for(std::chrono::milliseconds(50));
-		}
-		
-		// After sending the full batch, we pause slightly before re-scanning and starting the next batch.
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	scan_directory();
+	try {
+		loop.run();
+	} catch (const zmq::error_t& e) {
+		std::cerr << "ZMQ error: " << e.what() << std::endl;
+		return -1;
 	}
 
 	return 0;
@@ -1,18 +1,65 @@
 /**
  * App 3: Data Logger
- * - Subscribes to the Feature Extractor's ZMQ PUB socket.
- * - Receives multi-part messages (filename, image_buffer, keypoints_buffer).
- * - Stores them into SQLite as BLOBs.
+ * - Subscribes to the Feature Extractor's ZMQ PUB socket(s); --connect=EP[,EP...]
+ *   connects one SUB socket to several extractor senders or instances.
+ * - Receives multi-part messages (filename, image_buffer, keypoints_buffer,
+ *   optional tagged parts, see Record.hpp).
+ * - Also accepts single-part messages: a contiguous frame holding the same
+ *   fields (see Frame.hpp), or a batch carrying several records (see
+ *   Batch.hpp), stored inside one transaction.
+ * - Payloads are bound straight from the received ZMQ messages.
+ * - Runs an EventLoop (EventLoop.hpp) that drains the socket and prints a
+ *   "[Metrics]" line every --metrics-interval-ms (0 disables).
+ * - Stores them into SQLite as BLOBs; tagged parts (e.g. descriptors) go
+ *   to the record_parts table.
+ * - Descriptors are also appended to a flat, memory-mappable store
+ *   (DescriptorStore.hpp) at --descriptor-store=PATH (default
+ *   processed_data.desc, empty disables) for consumers that load them all.
+ * - With --pq-codebook=PATH (see codebook_trainer --train=pq) descriptors
+ *   are also product-quantized to 8-16 byte codes and appended to a store
+ *   of codes at --pq-store=PATH (default processed_data.pq); pass an empty
+ *   --descriptor-store to keep only the compressed form.
+ * - With --dedup=dhash|phash, frames whose perceptual hash is within
+ *   --dedup-distance bits of an already stored frame are stored as a
+ *   reference to it (duplicates table, no image, keypoints or tagged
+ *   parts); hashes are indexed in memory (PerceptualHash.hpp) and kept in
+ *   the image_hashes table across restarts.
  */
 
 #include <iostream>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <memory>
 
 #include "zmq.hpp"
 #include "sqlite3.h"
 #include "Constants.hpp"
 #include "Serialization.hpp" 
+#include "Record.hpp"
+#include "Options.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "DescriptorStore.hpp"
+#include "ProductQuantizer.hpp"
+#include "PerceptualHash.hpp"
+#include "ImageCodec.hpp"
+
+#include "opencv2/imgcodecs.hpp"
+
+// Open database plus the prepared statements used per record
+struct Database {
+	sqlite3* db = nullptr;
+	sqlite3_stmt* insert_image = nullptr;
+	sqlite3_stmt* insert_part = nullptr;
+	std::unique_ptr<DescriptorStoreWriter> descriptor_store; // optional
+	std::unique_ptr<ProductQuantizer> pq;                    // optional, with pq_store
+	std::unique_ptr<DescriptorStoreWriter> pq_store;
+	std::unique_ptr<HashIndex> dedup;                        // optional near-duplicate index
+	HashKind dedup_hash = HashKind::DHash;
+	sqlite3_stmt* insert_hash = nullptr;
+	sqlite3_stmt* insert_duplicate = nullptr;
+};
 
 // Helper function to initialize the database
 void setup_database(sqlite3** db) {
@@ -31,6 +78,22 @@ void setup_database(sqlite3** db) {
 		image_blob BLOB,
 		keypoints_blob BLOB
 	);
+	CREATE TABLE IF NOT EXISTS record_parts (
+		image_id INTEGER NOT NULL REFERENCES processed_images(id),
+		tag TEXT NOT NULL,
+		blob BLOB
+	);
+	CREATE INDEX IF NOT EXISTS record_parts_image ON record_parts(image_id);
+	CREATE TABLE IF NOT EXISTS image_hashes (
+		image_id INTEGER PRIMARY KEY REFERENCES processed_images(id),
+		kind TEXT NOT NULL,
+		hash INTEGER NOT NULL
+	);
+	CREATE TABLE IF NOT EXISTS duplicates (
+		image_id INTEGER PRIMARY KEY REFERENCES processed_images(id),
+		original_id INTEGER NOT NULL REFERENCES processed_images(id),
+		distance INTEGER NOT NULL
+	);
 	)";
 
 	char* err_msg = nullptr;
@@ -40,126 +103,392 @@ void setup_database(sqlite3** db) {
 	}
 }
 
-int main(int argc, char* argv[]) {
-	// SQLite Setup
-	sqlite3* db = nullptr;
-	setup_database(&db);
-	if (!db) {
-		return -1;
+// Prepares `sql` into `stmt`; returns false (and reports) on error
+bool prepare(sqlite3* db, const char* sql, sqlite3_stmt** stmt) {
+	if (sqlite3_prepare_v2(db, sql, -1, stmt, 0) != SQLITE_OK) {
+		std::cerr << "Error preparing statement: "
+				  << sqlite3_errmsg(db) << std::endl;
+		return false;
 	}
+	return true;
+}
+
+void close_database(Database& database) {
+	sqlite3_finalize(database.insert_image);
+	sqlite3_finalize(database.insert_part);
+	sqlite3_finalize(database.insert_hash);
+	sqlite3_finalize(database.insert_duplicate);
+	sqlite3_close(database.db);
+	database.descriptor_store.reset();
+	database.pq_store.reset();
+}
 
-	// Prepare the INSERT statement
+// Loads the hashes of previously stored frames into the dedup index
+bool load_hashes(Database& database) {
 	sqlite3_stmt* stmt = nullptr;
-	const char* insert_sql = 
-		"INSERT INTO processed_images (filename, image_blob, keypoints_blob) "
-		"VALUES (?, ?, ?);";
-	if (sqlite3_prepare_v2(db, insert_sql, -1, &stmt, 0) != SQLITE_OK) {
-		std::cerr << "Error preparing statement: "
-				  << sqlite3_errmsg(db) << std::endl;
-		sqlite3_close(db);
-		return -1;
+	if (!prepare(database.db, "SELECT image_id, hash FROM image_hashes WHERE kind = ? ORDER BY image_id;", &stmt)) {
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, hash_kind_name(database.dedup_hash), -1, SQLITE_STATIC);
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		database.dedup->add(static_cast<uint64_t>(sqlite3_column_int64(stmt, 1)),
+							sqlite3_column_int64(stmt, 0));
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) {
+		std::cerr << "Error loading image hashes: " << sqlite3_errmsg(database.db) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Perceptual hash of a compressed image; false if it cannot be decoded.
+// The hash only needs a thumbnail, so JPEGs are decoded at 1/4 scale.
+bool hash_image(const PartView& img, HashKind kind, uint64_t& hash) {
+	cv::Mat gray;
+	if (!decode_image(img.data, img.size, cv::IMREAD_REDUCED_GRAYSCALE_4, gray)) {
+		return false;
 	}
+	hash = perceptual_hash(gray, kind);
+	return true;
+}
 
-	// ZMQ Setup
-	zmq::context_t context(1);
-	zmq::socket_t subscriber(context, zmq::socket_type::sub);
+// Records `image_id` as a near-duplicate of `original`
+bool store_duplicate(Database& database, sqlite3_int64 image_id, const HashIndex::Match& original) {
+	sqlite3_stmt* stmt = database.insert_duplicate;
+	sqlite3_reset(stmt);
+	sqlite3_bind_int64(stmt, 1, image_id);
+	sqlite3_bind_int64(stmt, 2, original.id);
+	sqlite3_bind_int(stmt, 3, original.distance);
+	if (sqlite3_step(stmt) != SQLITE_DONE) {
+		std::cerr << "Error inserting duplicate: " << sqlite3_errmsg(database.db) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Stores a new frame's hash and makes it findable by later frames
+bool store_hash(Database& database, sqlite3_int64 image_id, uint64_t hash) {
+	sqlite3_stmt* stmt = database.insert_hash;
+	sqlite3_reset(stmt);
+	sqlite3_bind_int64(stmt, 1, image_id);
+	sqlite3_bind_text(stmt, 2, hash_kind_name(database.dedup_hash), -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(hash));
+	if (sqlite3_step(stmt) != SQLITE_DONE) {
+		std::cerr << "Error inserting image hash: " << sqlite3_errmsg(database.db) << std::endl;
+		return false;
+	}
+	database.dedup->add(hash, image_id);
+	return true;
+}
+
+// Stores the optional tagged parts of a record under `image_id`
+bool store_tagged_parts(Database& database, sqlite3_int64 image_id, const RecordView& parts) {
+	sqlite3_stmt* stmt = database.insert_part;
+	for (size_t i = record::CORE_PARTS; i + 1 < parts.size(); i += 2) {
+		sqlite3_reset(stmt);
+		sqlite3_bind_int64(stmt, 1, image_id);
+		sqlite3_bind_text(stmt, 2, parts[i].data, static_cast<int>(parts[i].size), SQLITE_STATIC);
+		sqlite3_bind_blob(stmt, 3, parts[i + 1].data, static_cast<int>(parts[i + 1].size), SQLITE_STATIC);
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			std::cerr << "Error inserting record part: "
+					  << sqlite3_errmsg(database.db) << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Appends the record's descriptors, if any, to the flat store and/or, as
+// PQ codes, to the code store
+void store_descriptors(Database& database, sqlite3_int64 image_id,
+					   const std::string& filename, const RecordView& parts) {
+	const PartView* desc_part = record::find_part(parts, record::TAG_DESCRIPTORS);
+	if ((!database.descriptor_store && !database.pq_store) || !desc_part) {
+		return;
+	}
 	try {
-		subscriber.connect(constants::EXTRACTOR_CONNECT_TO);
-		subscriber.set(zmq::sockopt::subscribe, ""); // Subscribe to all
-		std::cout << "Logger started, subscribing to "
-				  << constants::EXTRACTOR_CONNECT_TO << std::endl;
-	} catch (const zmq::error_t& e) {
-		std::cerr << "Error connecting ZMQ subscriber: "
-				  << e.what() << std::endl;
-		sqlite3_finalize(stmt);
-		sqlite3_close(db);
-		return -1;
+		cv::Mat descriptors = deserialize_descriptors(desc_part->data, desc_part->size);
+		if (database.descriptor_store) {
+			database.descriptor_store->append(image_id, filename, descriptors);
+		}
+		if (database.pq_store) {
+			database.pq_store->append(image_id, filename, database.pq->encode(descriptors));
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Error appending to descriptor store: " << e.what() << std::endl;
 	}
+}
+
+// Stores one extractor record; returns false on error
+bool store_record(Database& database, const RecordView& parts) {
+	static Counter& logged = Metrics::global().counter("logger.records_logged");
+	static Counter& failed = Metrics::global().counter("logger.insert_errors");
+	static Counter& duplicates = Metrics::global().counter("logger.duplicates");
+	static Counter& bytes_saved = Metrics::global().counter("logger.duplicate_bytes_saved");
 
-	while (true) {
-		zmq::message_t name_msg;
-		zmq::message_t img_msg;
-		zmq::message_t kps_msg;
+	if (!record::is_valid(parts)) {
+		std::cerr << "Warning: record with " << parts.size()
+				  << " parts, expected 3 plus tagged pairs." << std::endl;
+		failed.add();
+		return false;
+	}
 
-		// Part 1: Filename
-		auto recv_name = subscriber.recv(name_msg);
-		if (!recv_name.has_value()) { continue; }
+	const PartView& img = parts[record::IMAGE];
+	const PartView& kps = parts[record::KEYPOINTS];
+	std::string filename = record::filename(parts);
 
-		if (!subscriber.get(zmq::sockopt::rcvmore)) {
-			std::cerr << "Warning: expected 3 parts, got 1." << std::endl;
-			continue;
+	// A near-duplicate of a stored frame is kept only as a reference to it
+	uint64_t hash = 0;
+	bool hashed = false;
+	HashIndex::Match original;
+	bool duplicate = false;
+	if (database.dedup) {
+		try {
+			hashed = hash_image(img, database.dedup_hash, hash);
+		} catch (const std::exception& e) {
+			std::cerr << "Error hashing " << filename << ": " << e.what() << std::endl;
 		}
+		duplicate = hashed && database.dedup->find(hash, original);
+	}
 
-		// Part 2: Image buffer
-		auto recv_img = subscriber.recv(img_msg);
-		if (!recv_img.has_value()) { continue; }
+	// Bind data to prepared stmt
+	sqlite3_stmt* stmt = database.insert_image;
+	sqlite3_reset(stmt);
+
+	if (sqlite3_bind_text(stmt, 1, filename.c_str(), -1,
+						  SQLITE_TRANSIENT) != SQLITE_OK) {
+		std::cerr << "SQLite bind error (filename)." << std::endl;
+		return false;
+	}
 
-		if (!subscriber.get(zmq::sockopt::rcvmore)) {
-			std::cerr << "Warning: expected 3 parts, got 2." << std::endl;
-			continue;
+	if (duplicate) {
+		sqlite3_bind_null(stmt, 2);
+		sqlite3_bind_null(stmt, 3);
+	} else {
+		// The views outlive sqlite3_step(), so SQLite need not copy them
+		if (sqlite3_bind_blob(stmt, 2, img.data, img.size,
+							  SQLITE_STATIC) != SQLITE_OK) {
+			std::cerr << "SQLite bind error (image_blob)." << std::endl;
+			return false;
 		}
 
-		// Part 3: Keypoints
-		auto recv_kps = subscriber.recv(kps_msg);
-		if (!recv_kps.has_value()) { continue; }
-
-		if (subscriber.get(zmq::sockopt::rcvmore)) {
-			std::cerr << "Warning: received >3 parts. Flushing extras." << std::endl;
-			zmq::message_t temp;
-			while (subscriber.get(zmq::sockopt::rcvmore)) {
-				subscriber.recv(temp);
-			}
-			continue;
+		if (sqlite3_bind_blob(stmt, 3, kps.data, kps.size,
+							  SQLITE_STATIC) != SQLITE_OK) {
+			std::cerr << "SQLite bind error (keypoints_blob)." << std::endl;
+			return false;
 		}
+	}
 
-		std::string filename = name_msg.to_string();
+	int rc = sqlite3_step(stmt);
+	if (rc != SQLITE_DONE) {
+		std::cerr << "Error inserting data: "
+				  << sqlite3_errmsg(database.db) << std::endl;
+		failed.add();
+		return false;
+	}
+	sqlite3_int64 image_id = sqlite3_last_insert_rowid(database.db);
 
-		// Bind data to prepared stmt
-		sqlite3_reset(stmt);
+	if (duplicate) {
+		if (!store_duplicate(database, image_id, original)) {
+			failed.add();
+			return false;
+		}
+		duplicates.add();
+		bytes_saved.add(img.size + kps.size);
+		logged.add();
+		std::cout << "Logged duplicate: " << filename << " (of image " << original.id
+				  << ", distance " << original.distance << ")" << std::endl;
+		return true;
+	}
 
-		if (sqlite3_bind_text(stmt, 1, filename.c_str(), -1,
-							  SQLITE_TRANSIENT) != SQLITE_OK) {
-			std::cerr << "SQLite bind error (filename)." << std::endl;
-			continue;
+	if (!store_tagged_parts(database, image_id, parts)) {
+		failed.add();
+		return false;
+	}
+	store_descriptors(database, image_id, filename, parts);
+	if (hashed && !store_hash(database, image_id, hash)) {
+		failed.add();
+		return false;
+	}
+	logged.add();
+
+	std::vector<char> kps_vec(kps.data, kps.data + kps.size);
+	size_t keypoint_count = 0;
+	try {
+		keypoint_count = deserialize_keypoints(kps_vec).size();
+	} catch (...) {
+		// ignore
+	}
+
+	std::cout << "Logged image: " << filename
+			  << " (" << (img.size / 1024)
+			  << " KB, " << keypoint_count
+			  << " keypoints)" << std::endl;
+	return true;
+}
+
+// Handles one message whose first part is `first_msg`. Batches are stored
+// inside one transaction.
+void handle_message(zmq::socket_t& subscriber, zmq::message_t&& first_msg,
+					Database& database) {
+	static Counter& batches = Metrics::global().counter("logger.batches");
+
+	ReceivedRecords received;
+	try {
+		received = read_records(subscriber, std::move(first_msg));
+	} catch (const std::exception& e) {
+		std::cerr << "Warning: dropping malformed message: " << e.what() << std::endl;
+		return;
+	}
+
+	if (!received.batched) {
+		store_record(database, received.records.front());
+		return;
+	}
+
+	batches.add();
+	// Hashes the batch adds to the dedup index are dropped again if it is
+	// rolled back, so the index only ever names committed images
+	size_t indexed = database.dedup ? database.dedup->size() : 0;
+	sqlite3_exec(database.db, "BEGIN;", 0, 0, 0);
+	for (const auto& parts : received.records) {
+		store_record(database, parts);
+	}
+	if (sqlite3_exec(database.db, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+		std::cerr << "Error committing batch: "
+				  << sqlite3_errmsg(database.db) << std::endl;
+		sqlite3_exec(database.db, "ROLLBACK;", 0, 0, 0);
+		if (database.dedup) {
+			database.dedup->truncate(indexed);
 		}
+	}
+}
 
-		if (sqlite3_bind_blob(stmt, 2, img_msg.data(), img_msg.size(),
-							  SQLITE_TRANSIENT) != SQLITE_OK) {
-			std::cerr << "SQLite bind error (image_blob)." << std::endl;
-			continue;
+int main(int argc, char* argv[]) {
+	Options options(argc, argv);
+	std::vector<std::string> connect_to =
+		options.get_list("connect", {constants::EXTRACTOR_CONNECT_TO});
+
+	std::string store_path = options.get("descriptor-store", constants::DESCRIPTOR_STORE_PATH);
+	std::string codebook_path = options.get("pq-codebook", "");
+	std::string pq_store_path = options.get("pq-store", constants::PQ_STORE_PATH);
+
+	long long metrics_ms = constants::METRICS_INTERVAL_MS;
+	std::unique_ptr<HashIndex> dedup;
+	HashKind dedup_hash = HashKind::DHash;
+	try {
+		metrics_ms = options.get_int("metrics-interval-ms", metrics_ms);
+
+		std::string dedup_name = options.get("dedup", "off");
+		if (dedup_name != "off") {
+			dedup_hash = parse_hash_kind(dedup_name);
+			dedup = std::make_unique<HashIndex>(static_cast<int>(
+				options.get_int("dedup-distance", constants::DEDUP_MAX_DISTANCE)));
 		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -1;
+	}
 
-		if (sqlite3_bind_blob(stmt, 3, kps_msg.data(), kps_msg.size(),
-							  SQLITE_TRANSIENT) != SQLITE_OK) {
-			std::cerr << "SQLite bind error (keypoints_blob)." << std::endl;
-			continue;
+	// SQLite Setup
+	Database database;
+	setup_database(&database.db);
+	if (!database.db) {
+		return -1;
+	}
+
+	if (!store_path.empty()) {
+		try {
+			database.descriptor_store = std::make_unique<DescriptorStoreWriter>(store_path);
+		} catch (const std::exception& e) {
+			std::cerr << "Error opening descriptor store: " << e.what() << std::endl;
+			close_database(database);
+			return -1;
 		}
+	}
 
-		int rc = sqlite3_step(stmt);
-		if (rc != SQLITE_DONE) {
-			std::cerr << "Error inserting data: "
-					  << sqlite3_errmsg(db) << std::endl;
-		} else {
-			std::vector<char> kps_vec(
-				static_cast<char*>(kps_msg.data()),
-				static_cast<char*>(kps_msg.data()) + kps_msg.size()
-			);
-			size_t keypoint_count = 0;
-			try {
-				keypoint_count = deserialize_keypoints(kps_vec).size();
-			} catch (...) {
-				// ignore
-			}
-
-			std::cout << "Logged image: " << filename
-					  << " (" << (img_msg.size() / 1024)
-					  << " KB, " << keypoint_count
-					  << " keypoints)" << std::endl;
+	if (!codebook_path.empty()) {
+		try {
+			database.pq = std::make_unique<ProductQuantizer>(ProductQuantizer::load(codebook_path));
+			database.pq_store = std::make_unique<DescriptorStoreWriter>(pq_store_path);
+		} catch (const std::exception& e) {
+			std::cerr << "Error opening PQ code store: " << e.what() << std::endl;
+			close_database(database);
+			return -1;
 		}
 	}
 
-	sqlite3_finalize(stmt);
-	sqlite3_close(db);
+	// Prepare the INSERT statements
+	const char* insert_image_sql = 
+		"INSERT INTO processed_images (filename, image_blob, keypoints_blob) "
+		"VALUES (?, ?, ?);";
+	const char* insert_part_sql =
+		"INSERT INTO record_parts (image_id, tag, blob) VALUES (?, ?, ?);";
+	const char* insert_hash_sql =
+		"INSERT INTO image_hashes (image_id, kind, hash) VALUES (?, ?, ?);";
+	const char* insert_duplicate_sql =
+		"INSERT INTO duplicates (image_id, original_id, distance) VALUES (?, ?, ?);";
+	if (!prepare(database.db, insert_image_sql, &database.insert_image)
+		|| !prepare(database.db, insert_part_sql, &database.insert_part)
+		|| !prepare(database.db, insert_hash_sql, &database.insert_hash)
+		|| !prepare(database.db, insert_duplicate_sql, &database.insert_duplicate)) {
+		close_database(database);
+		return -1;
+	}
+
+	if (dedup) {
+		database.dedup = std::move(dedup);
+		database.dedup_hash = dedup_hash;
+		if (!load_hashes(database)) {
+			close_database(database);
+			return -1;
+		}
+		std::cout << "Near-duplicate detection: " << hash_kind_name(dedup_hash)
+				  << ", distance <= " << database.dedup->max_distance() << ", "
+				  << database.dedup->size() << " stored hashes" << std::endl;
+	}
+
+	// ZMQ Setup
+	zmq::context_t context(1);
+	zmq::socket_t subscriber(context, zmq::socket_type::sub);
+	try {
+		for (const auto& endpoint : connect_to) {
+			subscriber.connect(endpoint);
+			std::cout << "Logger started, subscribing to "
+					  << endpoint << std::endl;
+		}
+		subscriber.set(zmq::sockopt::subscribe, ""); // Subscribe to all
+	} catch (const zmq::error_t& e) {
+		std::cerr << "Error connecting ZMQ subscriber: "
+				  << e.what() << std::endl;
+		close_database(database);
+		return -1;
+	}
+
+	// Event loop: drain the subscriber whenever it is readable, and print
+	// metrics on a timer
+	EventLoop loop;
+	loop.add_socket(subscriber, [&] {
+		zmq::message_t first_msg;
+		while (subscriber.recv(first_msg, zmq::recv_flags::dontwait)) {
+			handle_message(subscriber, std::move(first_msg), database);
+		}
+	});
+
+	if (metrics_ms > 0) {
+		loop.add_periodic(std::chrono::milliseconds(metrics_ms), [] {
+			std::cout << "[Metrics] " << Metrics::global().report() << std::endl;
+		});
+	}
+
+	try {
+		loop.run();
+	} catch (const zmq::error_t& e) {
+		std::cerr << "ZMQ error: " << e.what() << std::endl;
+	}
+
+	close_database(database);
 	return 0;
 }
-
@@ -0,0 +1,87 @@
+#include "ImageIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+BowImageIndex::BowImageIndex(std::shared_ptr<const VocabularyTree> vocabulary)
+	: vocabulary_(std::move(vocabulary)),
+	  postings_(vocabulary_->word_count()) {}
+
+std::vector<std::pair<uint32_t, float>> BowImageIndex::weigh(const cv::Mat& descriptors) const {
+	std::vector<uint32_t> words = vocabulary_->quantize(descriptors);
+	std::sort(words.begin(), words.end());
+
+	// Run-length count the sorted words into (word, tf * idf)
+	std::vector<std::pair<uint32_t, float>> weights;
+	float total = 0.0f;
+	for (size_t i = 0; i < words.size();) {
+		size_t j = i;
+		while (j < words.size() && words[j] == words[i]) {
+			++j;
+		}
+		float weight = static_cast<float>(j - i) * vocabulary_->idf(words[i]);
+		if (weight > 0.0f) {
+			weights.emplace_back(words[i], weight);
+			total += weight;
+		}
+		i = j;
+	}
+
+	for (auto& entry : weights) {
+		entry.second /= total;
+	}
+	return weights;
+}
+
+void BowImageIndex::add(uint32_t image_id, const cv::Mat& descriptors) {
+	if (descriptors.empty()) {
+		return;
+	}
+
+	for (const auto& entry : weigh(descriptors)) {
+		postings_[entry.first].push_back(Posting{image_id, entry.second});
+	}
+	descriptor_count_ += static_cast<size_t>(descriptors.rows);
+	image_bound_ = std::max(image_bound_, image_id + 1);
+}
+
+std::vector<ImageScore> BowImageIndex::query(const cv::Mat& descriptors, size_t top_k) {
+	if (descriptors.empty()) {
+		return {};
+	}
+
+	if (scores_.size() < image_bound_) {
+		scores_.resize(image_bound_, 0.0f);
+		shared_words_.resize(image_bound_, 0);
+	}
+
+	// Walk the posting lists of the query words only
+	std::vector<uint32_t> touched;
+	for (const auto& entry : weigh(descriptors)) {
+		for (const auto& posting : postings_[entry.first]) {
+			if (shared_words_[posting.image_id]++ == 0) {
+				touched.push_back(posting.image_id);
+			}
+			scores_[posting.image_id] += std::min(entry.second, posting.weight);
+		}
+	}
+
+	std::vector<ImageScore> ranked;
+	ranked.reserve(touched.size());
+	for (uint32_t image_id : touched) {
+		ranked.push_back(ImageScore{image_id, shared_words_[image_id], scores_[image_id]});
+		scores_[image_id] = 0.0f;
+		shared_words_[image_id] = 0;
+	}
+
+	size_t keep = std::min(top_k, ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(),
+		[](const ImageScore& a, const ImageScore& b) { return a.score > b.score; });
+	ranked.resize(keep);
+	return ranked;
+}
+
+size_t BowImageIndex::descriptor_count() const {
+	return descriptor_count_;
+}
@@ -0,0 +1,229 @@
+#include "ImageIndex.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+
+#include "BruteForceMatcher.hpp"
+
+namespace {
+
+// Best and second-best (squared L2 distance, image id) seen for a query row
+using Candidates = std::array<std::pair<float, uint32_t>, 2>;
+
+void offer(Candidates& best, float distance, uint32_t image_id) {
+	if (distance < best[0].first) {
+		best[1] = best[0];
+		best[0] = {distance, image_id};
+	} else if (distance < best[1].first) {
+		best[1] = {distance, image_id};
+	}
+}
+
+// Size class of a segment: segments in the same tier are merged together
+size_t tier_of(size_t rows, size_t base_rows, size_t fanout) {
+	size_t tier = 0;
+	for (size_t limit = base_rows * fanout; rows >= limit; limit *= fanout) {
+		++tier;
+	}
+	return tier;
+}
+
+} // namespace
+
+FlannImageIndex::FlannImageIndex(const Params& params) : params_(params) {}
+
+FlannImageIndex::~FlannImageIndex() {
+	if (merge_thread_.joinable()) {
+		merge_thread_.join();
+	}
+}
+
+FlannImageIndex::SegmentPtr FlannImageIndex::build_segment(cv::Mat descriptors,
+														   std::vector<uint32_t> image_of_row,
+														   int trees) {
+	auto segment = std::make_shared<Segment>();
+	segment->descriptors = std::move(descriptors);
+	segment->image_of_row = std::move(image_of_row);
+	// FLANN keeps a pointer to the descriptors, which the segment owns
+	segment->index = std::make_unique<cv::flann::Index>(
+		segment->descriptors, cv::flann::KDTreeIndexParams(trees));
+	return segment;
+}
+
+void FlannImageIndex::add(uint32_t image_id, const cv::Mat& descriptors) {
+	adopt_merge();
+	if (descriptors.empty()) {
+		return;
+	}
+
+	cv::Mat rows;
+	if (descriptors.type() == CV_32F) {
+		rows = descriptors;
+	} else {
+		descriptors.convertTo(rows, CV_32F);
+	}
+
+	pending_.push_back(rows);
+	pending_images_.insert(pending_images_.end(), static_cast<size_t>(rows.rows), image_id);
+	descriptor_count_ += static_cast<size_t>(rows.rows);
+
+	if (static_cast<size_t>(pending_.rows) >= params_.segment_rows) {
+		seal_pending();
+	}
+}
+
+void FlannImageIndex::seal_pending() {
+	segments_.push_back(build_segment(std::move(pending_), std::move(pending_images_),
+									  params_.trees));
+	pending_ = cv::Mat();
+	pending_images_.clear();
+	maybe_start_merge();
+}
+
+void FlannImageIndex::maybe_start_merge() {
+	if (merge_thread_.joinable()) {
+		return; // one merge at a time; adopt_merge() starts the next
+	}
+
+	// Find the smallest tier holding `merge_fanout` segments
+	std::unordered_map<size_t, std::vector<SegmentPtr>> tiers;
+	for (const auto& segment : segments_) {
+		size_t tier = tier_of(static_cast<size_t>(segment->descriptors.rows),
+							  params_.segment_rows, params_.merge_fanout);
+		tiers[tier].push_back(segment);
+	}
+
+	const std::vector<SegmentPtr>* chosen = nullptr;
+	size_t chosen_tier = 0;
+	for (const auto& entry : tiers) {
+		if (entry.second.size() >= params_.merge_fanout
+			&& (!chosen || entry.first < chosen_tier)) {
+			chosen = &entry.second;
+			chosen_tier = entry.first;
+		}
+	}
+	if (!chosen) {
+		return;
+	}
+
+	merging_ = *chosen;
+	std::vector<SegmentPtr> inputs = merging_;
+	int trees = params_.trees;
+
+	merge_thread_ = std::thread([this, inputs, trees] {
+		cv::Mat descriptors;
+		std::vector<uint32_t> image_of_row;
+		for (const auto& segment : inputs) {
+			descriptors.push_back(segment->descriptors);
+			image_of_row.insert(image_of_row.end(), segment->image_of_row.begin(),
+								segment->image_of_row.end());
+		}
+		SegmentPtr merged = build_segment(std::move(descriptors), std::move(image_of_row), trees);
+
+		std::lock_guard<std::mutex> lock(merge_mutex_);
+		merged_ = std::move(merged);
+	});
+}
+
+void FlannImageIndex::adopt_merge() {
+	SegmentPtr merged;
+	{
+		std::lock_guard<std::mutex> lock(merge_mutex_);
+		merged = std::move(merged_);
+		merged_.reset();
+	}
+	if (!merged) {
+		return;
+	}
+	merge_thread_.join();
+
+	segments_.erase(std::remove_if(segments_.begin(), segments_.end(),
+		[this](const SegmentPtr& segment) {
+			return std::find(merging_.begin(), merging_.end(), segment) != merging_.end();
+		}), segments_.end());
+	segments_.push_back(std::move(merged));
+	merging_.clear();
+
+	maybe_start_merge();
+}
+
+std::vector<ImageScore> FlannImageIndex::query(const cv::Mat& descriptors, size_t top_k) {
+	adopt_merge();
+	if (descriptors.empty()) {
+		return {};
+	}
+
+	cv::Mat queries;
+	if (descriptors.type() == CV_32F) {
+		queries = descriptors;
+	} else {
+		descriptors.convertTo(queries, CV_32F);
+	}
+
+	std::vector<Candidates> best(static_cast<size_t>(queries.rows),
+								 Candidates{{{FLT_MAX, 0}, {FLT_MAX, 0}}});
+
+	// Sealed segments: approximate kNN, squared L2 distances
+	cv::flann::SearchParams search(params_.checks);
+	for (const auto& segment : segments_) {
+		int k = std::min(2, segment->descriptors.rows);
+		cv::Mat indices;
+		cv::Mat distances;
+		segment->index->knnSearch(queries, indices, distances, k, search);
+
+		for (int r = 0; r < queries.rows; ++r) {
+			for (int j = 0; j < k; ++j) {
+				int row = indices.at<int>(r, j);
+				if (row < 0) {
+					continue;
+				}
+				offer(best[r], distances.at<float>(r, j), segment->image_of_row[row]);
+			}
+		}
+	}
+
+	// Pending buffer: exact kNN (plain L2 distances, so square them)
+	if (!pending_.empty()) {
+		BruteForceMatcher matcher{BruteForceMatcher::Params{}};
+		std::vector<std::vector<cv::DMatch>> matches;
+		matcher.knn_match(queries, pending_, 2, matches);
+		for (const auto& row_matches : matches) {
+			for (const auto& m : row_matches) {
+				offer(best[m.queryIdx], m.distance * m.distance, pending_images_[m.trainIdx]);
+			}
+		}
+	}
+
+	// Ratio test on squared distances, then vote per image
+	float ratio_sq = params_.ratio * params_.ratio;
+	std::unordered_map<uint32_t, uint32_t> votes;
+	for (const auto& candidates : best) {
+		if (candidates[0].first == FLT_MAX) {
+			continue;
+		}
+		if (candidates[1].first == FLT_MAX || candidates[0].first < ratio_sq * candidates[1].first) {
+			++votes[candidates[0].second];
+		}
+	}
+
+	std::vector<ImageScore> ranked;
+	ranked.reserve(votes.size());
+	for (const auto& entry : votes) {
+		ranked.push_back(ImageScore{entry.first, entry.second,
+									static_cast<float>(entry.second) / queries.rows});
+	}
+
+	size_t keep = std::min(top_k, ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(),
+		[](const ImageScore& a, const ImageScore& b) { return a.votes > b.votes; });
+	ranked.resize(keep);
+	return ranked;
+}
+
+size_t FlannImageIndex::descriptor_count() const {
+	return descriptor_count_;
+}
@@ -0,0 +1,177 @@
+#ifndef MATCHER_IMAGE_INDEX_HPP
+#define MATCHER_IMAGE_INDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "opencv2/flann.hpp"
+
+#include "ProductQuantizer.hpp"
+#include "VocabularyTree.hpp"
+
+// Image-level retrieval over stored descriptors (App 4: Feature Matcher).
+
+/**
+ * @brief One ranked answer: an indexed image and how well it matched.
+ */
+struct ImageScore {
+	uint32_t image_id;
+	uint32_t votes;  // query descriptors / visual words shared with this image
+	float score;     // index-specific similarity, higher is better
+};
+
+/**
+ * @brief Index answering "which stored images match these descriptors".
+ *
+ * add() and query() are called from the matcher's event loop thread only;
+ * implementations may do heavy maintenance work in the background.
+ */
+class ImageIndex {
+public:
+	virtual ~ImageIndex() = default;
+
+	/**
+	 * @brief Adds the descriptors (CV_32F, one row per keypoint) of an image.
+	 */
+	virtual void add(uint32_t image_id, const cv::Mat& descriptors) = 0;
+
+	/**
+	 * @brief Ranks indexed images by similarity to the query descriptors.
+	 */
+	virtual std::vector<ImageScore> query(const cv::Mat& descriptors, size_t top_k) = 0;
+
+	virtual size_t descriptor_count() const = 0;
+};
+
+/**
+ * @brief Approximate nearest-neighbour index over raw descriptors using
+ * FLANN randomized KD-forests, with Lowe's ratio test and per-image voting.
+ *
+ * FLANN indices cannot grow, so descriptors are kept LSM-style:
+ * - new descriptors go to a small pending buffer searched by brute force;
+ * - a full buffer is sealed into an immutable KD-forest segment;
+ * - once `merge_fanout` segments of a similar size exist they are merged
+ *   into one bigger segment on a background thread, so total build work
+ *   stays O(N log N) and queries touch O(log N) segments.
+ */
+class FlannImageIndex : public ImageIndex {
+public:
+	struct Params {
+		int trees = 4;                // randomized KD-trees per segment
+		int checks = 32;              // leaves visited per search
+		float ratio = 0.8f;           // Lowe's ratio test threshold
+		size_t segment_rows = 4096;   // pending buffer size before sealing
+		size_t merge_fanout = 4;      // similar-size segments merged together
+	};
+
+	explicit FlannImageIndex(const Params& params);
+	~FlannImageIndex() override;
+
+	void add(uint32_t image_id, const cv::Mat& descriptors) override;
+	std::vector<ImageScore> query(const cv::Mat& descriptors, size_t top_k) override;
+	size_t descriptor_count() const override;
+
+private:
+	// Immutable once built, so a background merge may read it freely
+	struct Segment {
+		cv::Mat descriptors;
+		std::vector<uint32_t> image_of_row;
+		std::unique_ptr<cv::flann::Index> index;
+	};
+	using SegmentPtr = std::shared_ptr<const Segment>;
+
+	static SegmentPtr build_segment(cv::Mat descriptors, std::vector<uint32_t> image_of_row,
+									int trees);
+
+	void seal_pending();
+	void adopt_merge();
+	void maybe_start_merge();
+
+	Params params_;
+
+	// Event loop thread only
+	cv::Mat pending_;
+	std::vector<uint32_t> pending_images_;
+	std::vector<SegmentPtr> segments_;
+	size_t descriptor_count_ = 0;
+
+	// Background merge: inputs, and the result handed back under the mutex
+	std::thread merge_thread_;
+	std::vector<SegmentPtr> merging_;
+	std::mutex merge_mutex_;
+	SegmentPtr merged_;
+};
+
+/**
+ * @brief Bag-of-visual-words index: descriptors are quantized with a
+ * vocabulary tree and only per-image word weights are kept, in an inverted
+ * file (word -> images containing it).
+ *
+ * Images are L1-normalized TF-IDF vectors; the score is the histogram
+ * intersection sum(min(q_w, d_w)) = 1 - |q - d|_1 / 2, accumulated over the
+ * posting lists of the query's words only. Memory is bounded by the number
+ * of distinct words per image, independent of descriptor count.
+ */
+class BowImageIndex : public ImageIndex {
+public:
+	explicit BowImageIndex(std::shared_ptr<const VocabularyTree> vocabulary);
+
+	void add(uint32_t image_id, const cv::Mat& descriptors) override;
+	std::vector<ImageScore> query(const cv::Mat& descriptors, size_t top_k) override;
+	size_t descriptor_count() const override;
+
+private:
+	struct Posting {
+		uint32_t image_id;
+		float weight;
+	};
+
+	// L1-normalized TF-IDF weights of a descriptor set, sorted by word
+	std::vector<std::pair<uint32_t, float>> weigh(const cv::Mat& descriptors) const;
+
+	std::shared_ptr<const VocabularyTree> vocabulary_;
+	std::vector<std::vector<Posting>> postings_;   // indexed by word
+	size_t descriptor_count_ = 0;
+	uint32_t image_bound_ = 0;                     // largest image id + 1
+
+	// Query scratch space, indexed by image id
+	std::vector<float> scores_;
+	std::vector<uint32_t> shared_words_;
+};
+
+/**
+ * @brief Exhaustive index over product-quantized descriptors: 8-16 bytes
+ * per descriptor instead of 512, searched with ADC table lookups, with the
+ * same ratio test and per-image voting as FlannImageIndex.
+ *
+ * Every query scans all codes, so cost grows linearly with the collection;
+ * it trades some accuracy for a much smaller, cache-friendly footprint.
+ */
+class PqImageIndex : public ImageIndex {
+public:
+	PqImageIndex(std::shared_ptr<const ProductQuantizer> quantizer, float ratio);
+
+	void add(uint32_t image_id, const cv::Mat& descriptors) override;
+	std::vector<ImageScore> query(const cv::Mat& descriptors, size_t top_k) override;
+	size_t descriptor_count() const override;
+
+	/**
+	 * @brief Adds already encoded descriptors (CV_8U, code_size() columns),
+	 * e.g. read from the logger's code store.
+	 */
+	void add_codes(uint32_t image_id, const cv::Mat& codes);
+
+	const ProductQuantizer& quantizer() const { return *quantizer_; }
+
+private:
+	std::shared_ptr<const ProductQuantizer> quantizer_;
+	float ratio_;
+	std::vector<uint8_t> codes_;           // code_size() bytes per descriptor
+	std::vector<uint32_t> image_of_row_;
+};
+
+#endif // MATCHER_IMAGE_INDEX_HPP
@@ -0,0 +1,92 @@
+#include "ImageIndex.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+#include <unordered_map>
+
+PqImageIndex::PqImageIndex(std::shared_ptr<const ProductQuantizer> quantizer, float ratio)
+	: quantizer_(std::move(quantizer)), ratio_(ratio) {}
+
+void PqImageIndex::add(uint32_t image_id, const cv::Mat& descriptors) {
+	if (descriptors.empty()) {
+		return;
+	}
+	add_codes(image_id, quantizer_->encode(descriptors));
+}
+
+void PqImageIndex::add_codes(uint32_t image_id, const cv::Mat& codes) {
+	if (codes.empty()) {
+		return;
+	}
+	if (codes.type() != CV_8U || static_cast<size_t>(codes.cols) != quantizer_->code_size()) {
+		throw std::invalid_argument("Codes do not match the index's product quantizer.");
+	}
+
+	for (int r = 0; r < codes.rows; ++r) {
+		const uint8_t* code = codes.ptr<uint8_t>(r);
+		codes_.insert(codes_.end(), code, code + codes.cols);
+	}
+	image_of_row_.insert(image_of_row_.end(), static_cast<size_t>(codes.rows), image_id);
+}
+
+std::vector<ImageScore> PqImageIndex::query(const cv::Mat& descriptors, size_t top_k) {
+	if (descriptors.empty() || image_of_row_.empty()) {
+		return {};
+	}
+
+	cv::Mat queries;
+	if (descriptors.type() == CV_32F) {
+		queries = descriptors;
+	} else {
+		descriptors.convertTo(queries, CV_32F);
+	}
+	if (queries.cols != quantizer_->dims()) {
+		throw std::invalid_argument("Query descriptor length does not match the index.");
+	}
+
+	size_t count = image_of_row_.size();
+	std::vector<float> table(static_cast<size_t>(quantizer_->subspaces()) * ProductQuantizer::CENTROIDS);
+	std::vector<float> distances(count);
+
+	// Ratio test on squared ADC distances, then vote per image
+	float ratio_sq = ratio_ * ratio_;
+	std::unordered_map<uint32_t, uint32_t> votes;
+	for (int r = 0; r < queries.rows; ++r) {
+		quantizer_->distance_table(queries.ptr<float>(r), table.data());
+		quantizer_->scan(table.data(), codes_.data(), count, distances.data());
+
+		float best = FLT_MAX;
+		float second = FLT_MAX;
+		size_t best_row = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (distances[i] < best) {
+				second = best;
+				best = distances[i];
+				best_row = i;
+			} else if (distances[i] < second) {
+				second = distances[i];
+			}
+		}
+		if (second == FLT_MAX || best < ratio_sq * second) {
+			++votes[image_of_row_[best_row]];
+		}
+	}
+
+	std::vector<ImageScore> ranked;
+	ranked.reserve(votes.size());
+	for (const auto& entry : votes) {
+		ranked.push_back(ImageScore{entry.first, entry.second,
+									static_cast<float>(entry.second) / queries.rows});
+	}
+
+	size_t keep = std::min(top_k, ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(),
+		[](const ImageScore& a, const ImageScore& b) { return a.votes > b.votes; });
+	ranked.resize(keep);
+	return ranked;
+}
+
+size_t PqImageIndex::descriptor_count() const {
+	return image_of_row_.size();
+}
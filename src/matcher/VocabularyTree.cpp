@@ -0,0 +1,253 @@
+#include "VocabularyTree.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "DescriptorDistance.hpp"
+
+namespace {
+
+constexpr uint32_t VOCABULARY_MAGIC = 0x56534944; // "DISV" read little-endian
+constexpr uint32_t VOCABULARY_VERSION = 1;
+
+template <typename T>
+void write_pod(std::ofstream& out, const T* data, size_t count) {
+	out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * count));
+}
+
+template <typename T>
+void read_pod(std::ifstream& in, T* data, size_t count) {
+	in.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(sizeof(T) * count));
+	if (!in) {
+		throw std::runtime_error("Vocabulary file is truncated.");
+	}
+}
+
+} // namespace
+
+VocabularyTree VocabularyTree::train(const std::vector<cv::Mat>& images, const Params& params) {
+	if (params.branching < 2 || params.depth < 1) {
+		throw std::invalid_argument("Vocabulary tree needs branching >= 2 and depth >= 1.");
+	}
+
+	size_t total_rows = 0;
+	int dims = 0;
+	for (const auto& image : images) {
+		if (image.empty()) {
+			continue;
+		}
+		if (image.type() != CV_32F || (dims && image.cols != dims)) {
+			throw std::invalid_argument("Training descriptors must be CV_32F rows of equal length.");
+		}
+		dims = image.cols;
+		total_rows += static_cast<size_t>(image.rows);
+	}
+	if (total_rows == 0) {
+		throw std::invalid_argument("No training descriptors.");
+	}
+
+	// Uniform sample of the training rows; fixed seed so retraining on the
+	// same data gives the same vocabulary
+	std::mt19937 rng(12345);
+	std::bernoulli_distribution keep(std::min(1.0, static_cast<double>(params.max_samples) / total_rows));
+	cv::Mat samples;
+	for (const auto& image : images) {
+		for (int r = 0; r < image.rows; ++r) {
+			if (keep(rng)) {
+				samples.push_back(image.row(r));
+			}
+		}
+	}
+
+	VocabularyTree tree;
+	tree.nodes_.emplace_back();
+	tree.centers_ = cv::Mat::zeros(1, dims, CV_32F);
+	std::vector<int> rows(static_cast<size_t>(samples.rows));
+	for (int r = 0; r < samples.rows; ++r) {
+		rows[r] = r;
+	}
+	tree.build(0, samples, rows, 0, params);
+
+	// IDF: log(N / images containing the word)
+	std::vector<uint32_t> document_frequency(tree.word_count(), 0);
+	size_t document_count = 0;
+	for (const auto& image : images) {
+		if (image.empty()) {
+			continue;
+		}
+		++document_count;
+		std::vector<uint32_t> words = tree.quantize(image);
+		std::unordered_set<uint32_t> unique(words.begin(), words.end());
+		for (uint32_t word : unique) {
+			++document_frequency[word];
+		}
+	}
+	for (size_t w = 0; w < tree.idf_.size(); ++w) {
+		tree.idf_[w] = std::log(static_cast<float>(document_count)
+								/ std::max<uint32_t>(document_frequency[w], 1));
+	}
+	return tree;
+}
+
+void VocabularyTree::build(int32_t node, const cv::Mat& samples, std::vector<int>& rows,
+						   int level, const Params& params) {
+	if (level == params.depth || rows.size() <= static_cast<size_t>(params.branching)) {
+		nodes_[node].word = static_cast<uint32_t>(idf_.size());
+		idf_.push_back(0.0f);
+		return;
+	}
+
+	cv::Mat subset(static_cast<int>(rows.size()), samples.cols, CV_32F);
+	for (size_t i = 0; i < rows.size(); ++i) {
+		cv::Mat target = subset.row(static_cast<int>(i));
+		samples.row(rows[i]).copyTo(target);
+	}
+
+	cv::Mat labels;
+	cv::Mat centers;
+	cv::kmeans(subset, params.branching, labels,
+			   cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+								params.kmeans_iterations, 1e-4),
+			   1, cv::KMEANS_PP_CENTERS, centers);
+
+	std::vector<std::vector<int>> members(static_cast<size_t>(params.branching));
+	for (size_t i = 0; i < rows.size(); ++i) {
+		members[labels.at<int>(static_cast<int>(i))].push_back(rows[i]);
+	}
+	rows.clear();
+	rows.shrink_to_fit();
+
+	// Children are contiguous; empty clusters are dropped
+	int32_t first_child = static_cast<int32_t>(nodes_.size());
+	int32_t child_count = 0;
+	for (int c = 0; c < params.branching; ++c) {
+		if (members[c].empty()) {
+			continue;
+		}
+		nodes_.emplace_back();
+		centers_.push_back(centers.row(c));
+		std::swap(members[child_count], members[c]);
+		++child_count;
+	}
+	nodes_[node].first_child = first_child;
+	nodes_[node].child_count = child_count;
+
+	for (int32_t c = 0; c < child_count; ++c) {
+		build(first_child + c, samples, members[c], level + 1, params);
+	}
+}
+
+uint32_t VocabularyTree::quantize(const float* descriptor) const {
+	L2Kernel squared_distance = best_distance_kernels().l2_squared;
+	size_t dims = static_cast<size_t>(centers_.cols);
+	const Node* node = &nodes_[0];
+	while (node->child_count > 0) {
+		int32_t best = node->first_child;
+		float best_distance = FLT_MAX;
+		for (int32_t c = node->first_child; c < node->first_child + node->child_count; ++c) {
+			float distance = squared_distance(descriptor, centers_.ptr<float>(c), dims);
+			if (distance < best_distance) {
+				best_distance = distance;
+				best = c;
+			}
+		}
+		node = &nodes_[best];
+	}
+	return node->word;
+}
+
+std::vector<uint32_t> VocabularyTree::quantize(const cv::Mat& descriptors) const {
+	cv::Mat rows;
+	if (descriptors.type() == CV_32F) {
+		rows = descriptors;
+	} else {
+		descriptors.convertTo(rows, CV_32F);
+	}
+	if (!rows.empty() && rows.cols != centers_.cols) {
+		throw std::invalid_argument("Descriptor length does not match the vocabulary.");
+	}
+
+	std::vector<uint32_t> words(static_cast<size_t>(rows.rows));
+	for (int r = 0; r < rows.rows; ++r) {
+		words[r] = quantize(rows.ptr<float>(r));
+	}
+	return words;
+}
+
+void VocabularyTree::save(const std::string& path) const {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error("Cannot open " + path + " for writing.");
+	}
+
+	uint32_t header[5] = {VOCABULARY_MAGIC, VOCABULARY_VERSION,
+						  static_cast<uint32_t>(centers_.cols),
+						  static_cast<uint32_t>(nodes_.size()),
+						  static_cast<uint32_t>(idf_.size())};
+	write_pod(out, header, 5);
+	write_pod(out, nodes_.data(), nodes_.size());
+	for (int r = 0; r < centers_.rows; ++r) {
+		write_pod(out, centers_.ptr<float>(r), static_cast<size_t>(centers_.cols));
+	}
+	write_pod(out, idf_.data(), idf_.size());
+
+	if (!out) {
+		throw std::runtime_error("Error writing " + path + ".");
+	}
+}
+
+VocabularyTree VocabularyTree::load(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Cannot open vocabulary " + path + ".");
+	}
+
+	uint32_t header[5];
+	read_pod(in, header, 5);
+	if (header[0] != VOCABULARY_MAGIC || header[1] != VOCABULARY_VERSION) {
+		throw std::runtime_error(path + " is not a vocabulary file.");
+	}
+	uint32_t dims = header[2];
+	uint32_t node_count = header[3];
+	uint32_t word_count = header[4];
+	if (dims == 0 || node_count == 0 || word_count == 0 || word_count > node_count) {
+		throw std::runtime_error("Vocabulary " + path + " has an invalid header.");
+	}
+
+	// Check the sizes the header implies against the file before allocating
+	in.seekg(0, std::ios::end);
+	uint64_t file_bytes = static_cast<uint64_t>(in.tellg());
+	in.seekg(sizeof(header), std::ios::beg);
+	uint64_t expected = sizeof(header) + uint64_t(node_count) * sizeof(Node)
+					  + uint64_t(node_count) * dims * sizeof(float) + uint64_t(word_count) * sizeof(float);
+	if (!in || file_bytes != expected) {
+		throw std::runtime_error("Vocabulary " + path + " is truncated or has trailing data.");
+	}
+
+	VocabularyTree tree;
+	tree.nodes_.resize(node_count);
+	read_pod(in, tree.nodes_.data(), node_count);
+	tree.centers_.create(static_cast<int>(node_count), static_cast<int>(dims), CV_32F);
+	for (uint32_t r = 0; r < node_count; ++r) {
+		read_pod(in, tree.centers_.ptr<float>(static_cast<int>(r)), dims);
+	}
+	tree.idf_.resize(word_count);
+	read_pod(in, tree.idf_.data(), word_count);
+
+	// Reject trees whose links would send quantize() out of bounds
+	// (children always follow their parent, which also rules out cycles)
+	for (uint32_t i = 0; i < node_count; ++i) {
+		const Node& node = tree.nodes_[i];
+		if (node.child_count == 0 ? node.word >= word_count
+			: node.first_child <= static_cast<int64_t>(i) || node.child_count < 0
+			  || static_cast<uint64_t>(node.first_child) + node.child_count > node_count) {
+			throw std::runtime_error("Vocabulary " + path + " is corrupt.");
+		}
+	}
+	return tree;
+}
@@ -0,0 +1,72 @@
+#ifndef MATCHER_VOCABULARY_TREE_HPP
+#define MATCHER_VOCABULARY_TREE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+/**
+ * @brief Hierarchical k-means vocabulary ("vocabulary tree") that maps a
+ * descriptor to a visual word.
+ *
+ * Every inner node holds up to `branching` child centres; a descriptor is
+ * quantized by descending to the nearest child at each level, so lookup
+ * costs branching * depth distance computations for branching^depth words.
+ * The tree also carries the inverse document frequency of each word,
+ * measured on the training images.
+ */
+class VocabularyTree {
+public:
+	struct Params {
+		int branching = 10;            // children per inner node
+		int depth = 5;                 // levels below the root
+		size_t max_samples = 200000;   // descriptors fed to k-means
+		int kmeans_iterations = 10;
+	};
+
+	/**
+	 * @brief Trains a tree on the descriptors (CV_32F, one row per keypoint)
+	 * of a set of images; all images contribute to the IDF weights, a random
+	 * sample of at most `max_samples` rows to the clustering.
+	 */
+	static VocabularyTree train(const std::vector<cv::Mat>& images, const Params& params);
+
+	/**
+	 * @brief Loads a tree written by save(); throws std::runtime_error.
+	 */
+	static VocabularyTree load(const std::string& path);
+
+	void save(const std::string& path) const;
+
+	/**
+	 * @brief Visual word of one descriptor of length dims().
+	 */
+	uint32_t quantize(const float* descriptor) const;
+
+	/**
+	 * @brief Visual word of every row of `descriptors`.
+	 */
+	std::vector<uint32_t> quantize(const cv::Mat& descriptors) const;
+
+	float idf(uint32_t word) const { return idf_[word]; }
+	size_t word_count() const { return idf_.size(); }
+	int dims() const { return centers_.cols; }
+
+private:
+	struct Node {
+		int32_t first_child = -1;   // children are stored contiguously
+		int32_t child_count = 0;    // 0 for a leaf
+		uint32_t word = 0;          // valid for leaves
+	};
+
+	void build(int32_t node, const cv::Mat& samples, std::vector<int>& rows,
+			   int level, const Params& params);
+
+	std::vector<Node> nodes_;
+	cv::Mat centers_;               // one row per node, root row unused
+	std::vector<float> idf_;        // one entry per word
+};
+
+#endif // MATCHER_VOCABULARY_TREE_HPP
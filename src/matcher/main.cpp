@@ -0,0 +1,340 @@
+/**
+ * App 4: Feature Matcher (image retrieval)
+ * - Subscribes to the Feature Extractor's ZMQ PUB socket(s) and indexes the
+ *   SIFT descriptors of every new filename (run the extractor with
+ *   --descriptors). Records without descriptors are ignored.
+ * - Serves queries on a ZMQ REP socket bound at constants::MATCHER_ENDPOINT:
+ *   request  [0] compressed query image
+ *            [1] optional top_k (decimal text)
+ *   reply    "OK <n>\n" followed by n lines "<filename>\t<votes>\t<score>",
+ *            best first, or "ERROR <reason>"
+ * - --index=flann (default) matches query descriptors against all stored
+ *   descriptors (FLANN KD-forest, ratio test) and each match votes for the
+ *   image it came from. --index=bow quantizes descriptors with a trained
+ *   vocabulary tree (see codebook_trainer) and ranks images by TF-IDF
+ *   similarity through an inverted file, keeping only word weights.
+ *   --index=pq compresses descriptors to 8-16 byte product-quantization
+ *   codes and matches them exhaustively with ADC table lookups.
+ * - --descriptor-store=PATH first indexes the images of a store written by
+ *   the Data Logger (DescriptorStore.hpp); the file is memory-mapped, so
+ *   no SQLite decoding is needed on startup.
+ * - Both sockets are served from one EventLoop; index maintenance runs in
+ *   the background (see ImageIndex.hpp).
+ *
+ * Options:
+ *   --connect=EP[,EP...]      extractor endpoints (default constants::EXTRACTOR_CONNECT_TO)
+ *   --bind=EP                 query endpoint (default constants::MATCHER_ENDPOINT)
+ *   --top-k=N                 default number of results (default 10)
+ *   --max-query-features=N    SIFT features kept per query image (default 1000)
+ *   --descriptor-store=PATH   logger descriptor store to load at startup (default none)
+ *   --index=flann|bow|pq      index type (default flann)
+ *   --vocabulary=PATH         vocabulary tree for --index=bow (default vocabulary.bin)
+ *   --pq-codebook=PATH        PQ codebooks for --index=pq (default pq.bin)
+ *   --ratio=R --checks=N --trees=N   FLANN / ratio test tuning
+ *   --metrics-interval-ms=N   period of the metrics line, 0 disables (default 5000)
+ */
+
+#include <iostream>
+#include <climits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "opencv2/opencv.hpp"
+#include "opencv2/features2d.hpp"
+#include "zmq.hpp"
+
+#include "Constants.hpp"
+#include "Serialization.hpp"
+#include "Record.hpp"
+#include "Options.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "DescriptorStore.hpp"
+#include "ImageCodec.hpp"
+
+#include "ImageIndex.hpp"
+
+// Filenames of indexed images; the position is the image id
+struct ImageCatalog {
+	std::vector<std::string> filenames;
+	std::unordered_map<std::string, uint32_t> ids;
+};
+
+// Registers `filename` under the next image id
+uint32_t register_image(ImageCatalog& catalog, const std::string& filename) {
+	uint32_t image_id = static_cast<uint32_t>(catalog.filenames.size());
+	catalog.filenames.push_back(filename);
+	catalog.ids.emplace(filename, image_id);
+	return image_id;
+}
+
+// Registers `filename` and indexes its descriptors
+void add_image(ImageCatalog& catalog, ImageIndex& index, const std::string& filename,
+			   const cv::Mat& descriptors) {
+	index.add(register_image(catalog, filename), descriptors);
+}
+
+// Adds the descriptors carried by every new record of a message
+void ingest_message(zmq::socket_t& subscriber, zmq::message_t&& first_msg,
+					ImageCatalog& catalog, ImageIndex& index) {
+	static Counter& indexed = Metrics::global().counter("matcher.images_indexed");
+	static Counter& skipped = Metrics::global().counter("matcher.records_skipped");
+
+	ReceivedRecords received;
+	try {
+		received = read_records(subscriber, std::move(first_msg));
+	} catch (const std::exception& e) {
+		std::cerr << "[Matcher] Warning: dropping malformed message: " << e.what() << std::endl;
+		return;
+	}
+
+	for (const auto& parts : received.records) {
+		if (!record::is_valid(parts)) {
+			skipped.add();
+			continue;
+		}
+
+		// The generator loops over the same files; index each one once
+		std::string filename = record::filename(parts);
+		const PartView* desc_part = record::find_part(parts, record::TAG_DESCRIPTORS);
+		if (!desc_part || catalog.ids.count(filename)) {
+			skipped.add();
+			continue;
+		}
+
+		cv::Mat descriptors;
+		try {
+			descriptors = deserialize_descriptors(desc_part->data, desc_part->size);
+		} catch (const std::exception& e) {
+			std::cerr << "[Matcher] Warning: bad descriptors for " << filename
+					  << ": " << e.what() << std::endl;
+			skipped.add();
+			continue;
+		}
+
+		add_image(catalog, index, filename, descriptors);
+		indexed.add();
+
+		std::cout << "[Matcher] Indexed " << filename << " ("
+				  << descriptors.rows << " descriptors, "
+				  << index.descriptor_count() << " total)" << std::endl;
+	}
+}
+
+// Indexes every image of a logger descriptor store not seen yet. A store of
+// PQ codes (data_logger --pq-codebook) can only feed a PQ index.
+void load_store(const std::string& path, ImageCatalog& catalog, ImageIndex& index) {
+	auto start = std::chrono::steady_clock::now();
+	DescriptorStore store(path);
+
+	PqImageIndex* pq_index = dynamic_cast<PqImageIndex*>(&index);
+	bool codes = store.size() > 0 && store.type() == CV_8U;
+	if (codes && (!pq_index || static_cast<size_t>(store.cols()) != pq_index->quantizer().code_size())) {
+		throw std::runtime_error(path + " holds PQ codes; use --index=pq with the same codebook");
+	}
+
+	size_t loaded = 0;
+	for (size_t i = 0; i < store.size(); ++i) {
+		DescriptorStore::Image image = store.image(i);
+		if (catalog.ids.count(image.filename)) {
+			continue;
+		}
+		if (codes) {
+			pq_index->add_codes(register_image(catalog, image.filename), image.descriptors);
+		} else {
+			add_image(catalog, index, image.filename, image.descriptors);
+		}
+		++loaded;
+	}
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start);
+	std::cout << "[Matcher] Loaded " << loaded << " images ("
+			  << index.descriptor_count() << " descriptors) from " << path
+			  << " in " << elapsed.count() << " ms" << std::endl;
+}
+
+// Answers one REQ on `replier`
+void answer_query(zmq::socket_t& replier, cv::Ptr<cv::SIFT>& sift,
+				  const ImageCatalog& catalog, ImageIndex& index, size_t default_top_k) {
+	static Counter& queries = Metrics::global().counter("matcher.queries");
+	static Gauge& latency = Metrics::global().gauge("matcher.last_query_us");
+
+	std::vector<zmq::message_t> request;
+	do {
+		request.emplace_back();
+		if (!replier.recv(request.back(), zmq::recv_flags::dontwait)) {
+			return;
+		}
+	} while (replier.get(zmq::sockopt::rcvmore));
+
+	auto start = std::chrono::steady_clock::now();
+	std::ostringstream reply;
+
+	try {
+		size_t top_k = default_top_k;
+		if (request.size() > 1) {
+			top_k = static_cast<size_t>(std::stoul(request[1].to_string()));
+		}
+
+		cv::Mat image;
+		if (!decode_image(static_cast<const char*>(request[0].data()), request[0].size(),
+						  cv::IMREAD_GRAYSCALE, image)) {
+			throw std::runtime_error("could not decode query image");
+		}
+
+		std::vector<cv::KeyPoint> keypoints;
+		cv::Mat descriptors;
+		sift->detectAndCompute(image, cv::noArray(), keypoints, descriptors);
+
+		std::vector<ImageScore> ranked = index.query(descriptors, top_k);
+		reply << "OK " << ranked.size() << "\n";
+		for (const auto& match : ranked) {
+			reply << catalog.filenames[match.image_id] << "\t" << match.votes
+				  << "\t" << match.score << "\n";
+		}
+	} catch (const std::exception& e) {
+		reply.str("");
+		reply << "ERROR " << e.what();
+	}
+
+	std::string text = reply.str();
+	zmq::message_t reply_msg(text.begin(), text.end());
+	replier.send(reply_msg, zmq::send_flags::none);
+
+	queries.add();
+	latency.set(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count());
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> connect_to;
+	std::string bind_to;
+	size_t top_k = 10;
+	int max_query_features = 1000;
+	long long metrics_ms = 0;
+	std::string index_type;
+	std::string vocabulary_path;
+	std::string codebook_path;
+	std::string store_path;
+	FlannImageIndex::Params params;
+	try {
+		Options options(argc, argv);
+		connect_to = options.get_list("connect", {constants::EXTRACTOR_CONNECT_TO});
+		bind_to = options.get("bind", constants::MATCHER_ENDPOINT);
+		store_path = options.get("descriptor-store", "");
+		index_type = options.get("index", "flann");
+		vocabulary_path = options.get("vocabulary", "vocabulary.bin");
+		codebook_path = options.get("pq-codebook", "pq.bin");
+		long long top_k_option = options.get_int("top-k", 10);
+		long long max_features_option = options.get_int("max-query-features", 1000);
+		long long checks_option = options.get_int("checks", params.checks);
+		long long trees_option = options.get_int("trees", params.trees);
+		if (top_k_option <= 0 || max_features_option <= 0 || max_features_option > INT_MAX
+			|| checks_option <= 0 || checks_option > INT_MAX || trees_option <= 0 || trees_option > INT_MAX) {
+			throw std::invalid_argument("--top-k, --max-query-features, --checks and --trees must be positive.");
+		}
+		top_k = static_cast<size_t>(top_k_option);
+		max_query_features = static_cast<int>(max_features_option);
+		params.ratio = static_cast<float>(options.get_double("ratio", params.ratio));
+		params.checks = static_cast<int>(checks_option);
+		params.trees = static_cast<int>(trees_option);
+		metrics_ms = options.get_int("metrics-interval-ms", constants::METRICS_INTERVAL_MS);
+	} catch (const std::exception& e) {
+		std::cerr << "[Matcher] " << e.what() << std::endl;
+		return -1;
+	}
+
+	ImageCatalog catalog;
+	std::unique_ptr<ImageIndex> index;
+	if (index_type == "flann") {
+		index = std::make_unique<FlannImageIndex>(params);
+	} else if (index_type == "bow") {
+		try {
+			auto vocabulary = std::make_shared<const VocabularyTree>(
+				VocabularyTree::load(vocabulary_path));
+			std::cout << "[Matcher] Loaded " << vocabulary->word_count()
+					  << " visual words from " << vocabulary_path << std::endl;
+			index = std::make_unique<BowImageIndex>(std::move(vocabulary));
+		} catch (const std::exception& e) {
+			std::cerr << "[Matcher] " << e.what() << std::endl;
+			return -1;
+		}
+	} else if (index_type == "pq") {
+		try {
+			auto quantizer = std::make_shared<const ProductQuantizer>(
+				ProductQuantizer::load(codebook_path));
+			std::cout << "[Matcher] Loaded " << quantizer->code_size()
+					  << " byte PQ codebooks from " << codebook_path << std::endl;
+			index = std::make_unique<PqImageIndex>(std::move(quantizer), params.ratio);
+		} catch (const std::exception& e) {
+			std::cerr << "[Matcher] " << e.what() << std::endl;
+			return -1;
+		}
+	} else {
+		std::cerr << "[Matcher] Unknown --index=" << index_type
+				  << " (expected flann, bow or pq)" << std::endl;
+		return -1;
+	}
+
+	if (!store_path.empty()) {
+		try {
+			load_store(store_path, catalog, *index);
+		} catch (const std::exception& e) {
+			std::cerr << "[Matcher] Error loading descriptor store: " << e.what() << std::endl;
+			return -1;
+		}
+	}
+
+	cv::Ptr<cv::SIFT> sift = cv::SIFT::create(max_query_features);
+
+	// ZMQ Setup
+	zmq::context_t context(1);
+	zmq::socket_t subscriber(context, zmq::socket_type::sub);
+	zmq::socket_t replier(context, zmq::socket_type::rep);
+	try {
+		for (const auto& endpoint : connect_to) {
+			subscriber.connect(endpoint);
+			std::cout << "[Matcher] Subscribing to " << endpoint << std::endl;
+		}
+		subscriber.set(zmq::sockopt::subscribe, "");
+
+		replier.bind(bind_to);
+		std::cout << "[Matcher] Answering queries on " << bind_to << std::endl;
+	} catch (const zmq::error_t& e) {
+		std::cerr << "[Matcher] Error setting up ZMQ sockets: " << e.what() << std::endl;
+		return -1;
+	}
+
+	EventLoop loop;
+	loop.add_socket(subscriber, [&] {
+		zmq::message_t first_msg;
+		while (subscriber.recv(first_msg, zmq::recv_flags::dontwait)) {
+			ingest_message(subscriber, std::move(first_msg), catalog, *index);
+		}
+	});
+	loop.add_socket(replier, [&] {
+		answer_query(replier, sift, catalog, *index, top_k);
+	});
+
+	if (metrics_ms > 0) {
+		Gauge& descriptors = Metrics::global().gauge("matcher.descriptors");
+		loop.add_periodic(std::chrono::milliseconds(metrics_ms), [&] {
+			descriptors.set(static_cast<int64_t>(index->descriptor_count()));
+			std::cout << "[Metrics] " << Metrics::global().report() << std::endl;
+		});
+	}
+
+	try {
+		loop.run();
+	} catch (const zmq::error_t& e) {
+		std::cerr << "[Matcher] ZMQ error: " << e.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * Codebook trainer for the Feature Matcher's indices and the logger's
+ * compressed storage
+ * - Reads the SIFT descriptors stored by the Data Logger (run the extractor
+ *   with --descriptors): from the memory-mapped descriptor store if
+ *   --store is given, otherwise from the record_parts rows tagged
+ *   "descriptors" in the database.
+ * - --train=vocabulary: trains a hierarchical k-means vocabulary tree plus
+ *   IDF weights for ./feature_matcher --index=bow --vocabulary=PATH.
+ * - --train=pq: trains product-quantization codebooks for
+ *   ./feature_matcher --index=pq and ./data_logger --pq-codebook=PATH.
+ *
+ * Options:
+ *   --train=vocabulary|pq what to train (default vocabulary)
+ *   --store=PATH          logger descriptor store, e.g. processed_data.desc
+ *   --db=PATH             logger database (default processed_data.db)
+ *   --output=PATH         output file (default vocabulary.bin / pq.bin)
+ *   --branching=N         vocabulary: children per node (default 10)
+ *   --depth=N             vocabulary: tree levels, up to branching^depth words (default 5)
+ *   --subspaces=N         pq: code bytes per descriptor, e.g. 8 or 16 (default 16)
+ *   --max-samples=N       descriptors clustered (default 200000 / 100000)
+ *   --max-images=N        images read from the database, 0 = all (default 0)
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "sqlite3.h"
+
+#include "Serialization.hpp"
+#include "Record.hpp"
+#include "Options.hpp"
+#include "DescriptorStore.hpp"
+
+#include "ProductQuantizer.hpp"
+#include "VocabularyTree.hpp"
+
+// Loads the descriptors of up to `max_images` logged images (0 = all)
+bool load_descriptors(const std::string& db_path, long long max_images,
+					  std::vector<cv::Mat>& images) {
+	sqlite3* db = nullptr;
+	if (sqlite3_open_v2(db_path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+		std::cerr << "Error opening database: " << sqlite3_errmsg(db) << std::endl;
+		sqlite3_close(db);
+		return false;
+	}
+
+	const char* select_sql =
+		"SELECT blob FROM record_parts WHERE tag = ? ORDER BY image_id LIMIT ?;";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, select_sql, -1, &stmt, 0) != SQLITE_OK) {
+		std::cerr << "Error preparing statement: " << sqlite3_errmsg(db) << std::endl;
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, record::TAG_DESCRIPTORS.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 2, max_images > 0 ? max_images : -1);
+
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		const char* blob = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+		size_t size = static_cast<size_t>(sqlite3_column_bytes(stmt, 0));
+		try {
+			images.push_back(deserialize_descriptors(blob, size));
+		} catch (const std::exception& e) {
+			std::cerr << "Warning: skipping bad descriptors: " << e.what() << std::endl;
+		}
+	}
+
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+	return true;
+}
+
+// Views the descriptors of up to `max_images` images (0 = all) of a store;
+// the views stay valid while the store is open
+void view_store(const DescriptorStore& store, long long max_images,
+				std::vector<cv::Mat>& images) {
+	size_t count = store.size();
+	if (max_images > 0) {
+		count = std::min(count, static_cast<size_t>(max_images));
+	}
+	images.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		images.push_back(store.image(i).descriptors);
+	}
+}
+
+// Uniform sample of at most `max_samples` rows over all images
+cv::Mat sample_rows(const std::vector<cv::Mat>& images, size_t max_samples) {
+	size_t total_rows = 0;
+	for (const auto& image : images) {
+		total_rows += static_cast<size_t>(image.rows);
+	}
+
+	std::mt19937 rng(12345);
+	std::bernoulli_distribution keep(
+		total_rows ? std::min(1.0, static_cast<double>(max_samples) / total_rows) : 0.0);
+	cv::Mat samples;
+	for (const auto& image : images) {
+		for (int r = 0; r < image.rows; ++r) {
+			if (keep(rng)) {
+				samples.push_back(image.row(r));
+			}
+		}
+	}
+	return samples;
+}
+
+int main(int argc, char* argv[]) {
+	std::string kind;
+	std::string store_path;
+	std::string db_path;
+	std::string output;
+	long long max_images = 0;
+	VocabularyTree::Params vocabulary_params;
+	ProductQuantizer::Params pq_params;
+	try {
+		Options options(argc, argv);
+		kind = options.get("train", "vocabulary");
+		if (kind != "vocabulary" && kind != "pq") {
+			throw std::invalid_argument("Unknown --train=" + kind + " (expected vocabulary or pq)");
+		}
+		store_path = options.get("store", "");
+		db_path = options.get("db", "processed_data.db");
+		output = options.get("output", kind == "pq" ? "pq.bin" : "vocabulary.bin");
+		max_images = options.get_int("max-images", 0);
+		vocabulary_params.branching = static_cast<int>(
+			options.get_int("branching", vocabulary_params.branching));
+		vocabulary_params.depth = static_cast<int>(options.get_int("depth", vocabulary_params.depth));
+		pq_params.subspaces = static_cast<int>(options.get_int("subspaces", pq_params.subspaces));
+		size_t default_samples = kind == "pq" ? pq_params.max_samples : vocabulary_params.max_samples;
+		size_t max_samples = static_cast<size_t>(options.get_int("max-samples",
+			static_cast<long long>(default_samples)));
+		vocabulary_params.max_samples = max_samples;
+		pq_params.max_samples = max_samples;
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -1;
+	}
+
+	std::vector<cv::Mat> images;
+	std::unique_ptr<DescriptorStore> store;
+	if (!store_path.empty()) {
+		try {
+			store = std::make_unique<DescriptorStore>(store_path);
+		} catch (const std::exception& e) {
+			std::cerr << "Error opening descriptor store: " << e.what() << std::endl;
+			return -1;
+		}
+		view_store(*store, max_images, images);
+	} else if (!load_descriptors(db_path, max_images, images)) {
+		return -1;
+	}
+	const std::string& source = store ? store_path : db_path;
+	std::cout << "Training " << kind << " on " << images.size() << " images from "
+			  << source << std::endl;
+
+	try {
+		if (kind == "pq") {
+			ProductQuantizer pq = ProductQuantizer::train(
+				sample_rows(images, pq_params.max_samples), pq_params);
+			pq.save(output);
+			std::cout << "Wrote " << pq.subspaces() << " x " << ProductQuantizer::CENTROIDS
+					  << " centroid codebooks (" << pq.code_size() << " byte codes) to "
+					  << output << std::endl;
+		} else {
+			VocabularyTree tree = VocabularyTree::train(images, vocabulary_params);
+			tree.save(output);
+			std::cout << "Wrote " << tree.word_count() << " visual words to "
+					  << output << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Error training " << kind << ": " << e.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}